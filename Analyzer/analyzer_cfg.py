@@ -23,11 +23,43 @@ outFileTest = 'ttbarTmp.root'
 flag_reco = 1   # process reconstruction level
 flag_gen  = 1   # process generated level
 flag_mc   = 1   # 1 for mc, 0 for data
+flag_skim = 1   # run fast preselection (SkimFilter) before Analyzer (only if gen = 0, see below)
+flag_validateJEC = 0  # 1: evaluate JEC also for jets rejected before JEC by the raw pT cut and count 
+                      #    those which would pass pT > 30 GeV (validation of the assumed maximum JEC, slower)
+#
+# output ntuple settings
+flag_slim = 1   # 1: do not store branches not used in PostAnalyzer (muIso04, elIso04, elConv*, jetBTagMatchDiff*, 
+                #    generator level mcB*, mcW*, mcL*, mcNu*: only mcEventType, mcT, mcTbar are stored)
+out_compression = 'zlib'  # compression algorithm: 'zlib' (fast decompression), 'lzma' (smaller files, slow decompression), 'lz4' (fastest, needs ROOT >= 6.12)
+out_compressionLevel = 1  # compression level
+out_autoFlush = 10000     # cluster size (number of events), matches PostAnalyzer reading in blocks of 10000 events
+out_basketSize = 32000    # initial basket size (bytes), optimised by ROOT with the first cluster
+out_perFile = 1           # 1: new output file <name>_<N>.root after each input file (checkpoints for long jobs)
+out_rolloverEvents = 0    # if > 0, new output file after this number of events
+# (output files are switched at the end of luminosity sections; for each output file 
+# <name>.root, <name>.lumis.txt lists the closed input files and processed luminosity sections)
+#
+# instrumentation (stage timing, rate, bytes read, cut-flow): summary in <name>.stat.json
+# and histograms in 'stat' directory of the last output file, written at the end of job;
+# <name>.heartbeat.json is updated each out_heartbeat seconds while running (0: disabled)
+out_heartbeat = 60
+#
+# reading of input files (mainly remote, via xrootd):
+in_cacheSize = 20 * 1024 * 1024  # TTreeCache size (bytes) of PoolSource, baskets are read in large blocks (0: disabled)
+in_cacheHint = 'auto-detect'     # 'lazy-download': copy the file in chunks to local disk while reading it
+                                 # (to tempDir, see AdaptorConfig below), 'application-only', 'storage-only'
+in_readHint = 'auto-detect'      # 'read-ahead-buffered', 'direct-unbuffered'
+# (input files can be also staged to local disk before the job, see STAGEDIR in run.sh)
+#
+# file with luminosity sections to skip (lines 'lumi <run> <lumi>', as in <name>.lumis.txt records 
+# of an aborted job, for a single partially processed input file: a luminosity section can be spread 
+# over several input files), passed as optional 6th argument
+skipLumis = ''
 #
 # process passed arguments, if any
 #
 if len(sys.argv) < 4:
-  print("Usage: cmsRun analyzer_cfg.py <input list> <output file> <reco flag> <gen flag> <mc flag>")
+  print("Usage: cmsRun analyzer_cfg.py <input list> <output file> <reco flag> <gen flag> <mc flag> [<lumis to skip>]")
   inputList = inFileTest
   outFile = outFileTest
   # do not stop execution at this point, run with default arguments
@@ -38,6 +70,8 @@ else:
   flag_reco = int(sys.argv[4])
   flag_gen  = int(sys.argv[5])
   flag_mc   = int(sys.argv[6])
+  if len(sys.argv) > 7:
+    skipLumis = sys.argv[7]
 # consistency check
 if flag_gen == 1 and flag_mc == 0: 
   sys.exit("Error: gen = 1 requires mc = 1")
@@ -91,6 +125,10 @@ else:
   # many files in the list
   process.source = cms.Source("PoolSource",fileNames = cms.untracked.vstring(*inputList))
 #
+# TTreeCache for input files and storage access hints
+process.source.cacheSize = cms.untracked.uint32(in_cacheSize)
+process.AdaptorConfig = cms.Service("AdaptorConfig", cacheHint = cms.untracked.string(in_cacheHint), readHint = cms.untracked.string(in_readHint))
+#
 # JSON (good luminosity sections), only if processing data
 if flag_mc == 0:
   goodJSON = 'data/Cert_160404-180252_7TeV_ReRecoNov08_Collisions11_JSON.txt'
@@ -98,12 +136,35 @@ if flag_mc == 0:
   process.source.lumisToProcess = cms.untracked.VLuminosityBlockRange()
   process.source.lumisToProcess.extend(myLumis) 
 #
+# luminosity sections already processed (and stored) by an aborted job, if any
+if skipLumis != '':
+  doneLumis = [[int(w[1]), int(w[2])] for w in [line.split() for line in open(skipLumis)] if len(w) == 3 and w[0] == 'lumi']
+  if len(doneLumis) > 0:
+    process.source.lumisToSkip = cms.untracked.VLuminosityBlockRange()
+    process.source.lumisToSkip.extend(LumiList.LumiList(lumis = doneLumis).getCMSSWString().split(','))
+#
 # Load jet correction services for all jet algoritms
 process.load("JetMETCorrections.Configuration.JetCorrectionServicesAllAlgos_cff")
 #
 # all is ready: pass all arguments to Analyzer (C++ code in src/Analyzer.cc)
-process.demo = cms.EDAnalyzer('Analyzer', outFile = cms.string(outFile), mc = CfgTypes.int32(flag_mc), reco = CfgTypes.int32(flag_reco), gen = CfgTypes.int32(flag_gen))
-process.p = cms.Path(process.demo)
+process.demo = cms.EDAnalyzer('Analyzer', outFile = cms.string(outFile), mc = CfgTypes.int32(flag_mc), reco = CfgTypes.int32(flag_reco), gen = CfgTypes.int32(flag_gen),
+                              slim = CfgTypes.int32(flag_slim), validateJEC = CfgTypes.int32(flag_validateJEC), compression = cms.string(out_compression), compressionLevel = CfgTypes.int32(out_compressionLevel),
+                              autoFlush = CfgTypes.int32(out_autoFlush), basketSize = CfgTypes.int32(out_basketSize),
+                              perFile = CfgTypes.int32(out_perFile), rolloverEvents = CfgTypes.int32(out_rolloverEvents),
+                              heartbeat = cms.double(out_heartbeat), skim = cms.string(''))
+#
+# fast preselection (C++ code in src/SkimFilter.cc): events without analysis triggers 
+# or without pair of opposite signed leptons with pT > 20 GeV, |eta| < 2.4 are rejected
+# before Analyzer, so that the expensive lepton and jet selection is not run for them
+# (not applied if generator level is processed: such events are stored by Analyzer
+# if they are interesting at generator level only); rejected events are counted by
+# Analyzer as processed (in the log and <name>.stat.json, see processed.sh)
+if flag_skim == 1 and flag_reco == 1 and flag_gen == 0:
+  process.demo.skim = cms.string('skim')
+  process.skim = cms.EDFilter('SkimFilter', trigger = CfgTypes.int32(1), minPt = cms.double(20.0), maxEta = cms.double(2.4))
+  process.p = cms.Path(process.skim * process.demo)
+else:
+  process.p = cms.Path(process.demo)
 #
 ########################################################################
 #
@@ -1,14 +1,33 @@
 #!/bin/bash
+#
+# Summary of the output directory <dir>: ./processed.sh <dir>
+# Processed (including events rejected by SkimFilter) and selected events 
+# for each complete output file and their totals, from the output records 
+# (<output>.lumis.txt, see WriteOutputRecord() in src/Analyzer.cc): these 
+# are also counted for outputs of failed jobs which are kept, and not for 
+# removed incomplete outputs, so the total is the number of processed events 
+# needed for the MC weights. Then the wall time per processing stage and the 
+# time not spent in Analyzer stages (reading input, framework) of successful 
+# jobs, from job summaries (<output>.stat.json written by Analyzer at the 
+# end of job, see src/AnalyzerStat.h).
+#
 
 dir=$1
-sum1=0
-sum2=0
-for file in `ls $dir/log*`
-do
-  n1=`grep Processed $file | tail -n1 | awk '{print $2}'`
-  n2=`grep Processed $file | tail -n1 | awk '{print $5}'`
-  sum1=$[$n1+$sum1]
-  sum2=$[$n2+$sum2]
-  echo n=$n1 [${n2}]
-done
-echo sum=$sum1 [$sum2]
+awk '
+  $1 == "events" {sum1 += $2; sum2 += $3; printf("n=%d [%d]\n", $2, $3)}
+  END {printf("sum=%d [%d]\n", sum1, sum2)}' `ls $dir/*.lumis.txt 2>/dev/null` /dev/null
+awk -F'[:,{}]' '
+  FNR == 1 {nfiles++}
+  /^  "events":/ {sum1 += $2}
+  /^  "wallTime":/ {wall += $2}
+  /^  "bytesRead":/ {bytes += $2}
+  /^  "stages":/ {inStages = 1; next}
+  inStages && /^  }/ {inStages = 0}
+  inStages {gsub(/[ "]/, "", $1); stage[$1] += $6; stages += $6; if(!($1 in order)) {order[$1] = ++nstages; names[nstages] = $1}}
+  END {
+    if(nfiles == 0) exit
+    printf("jobs: %d, wall time: %.0f s, %.1f events/s per job, %.1f MB read\n", nfiles, wall, (wall > 0) ? sum1 / wall : 0, bytes / 1e6)
+    for(i = 1; i <= nstages; i++)
+      printf("  %-10s %10.1f s (%5.1f%%)\n", names[i], stage[names[i]], (wall > 0) ? 100 * stage[names[i]] / wall : 0)
+    printf("  %-10s %10.1f s (%5.1f%%)\n", "other", wall - stages, (wall > 0) ? 100 * (wall - stages) / wall : 0)
+  }' `ls $dir/*.stat.json 2>/dev/null` /dev/null
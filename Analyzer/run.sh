@@ -2,18 +2,23 @@
 #
 # This is the main script to run cmsRun jobs, both for data and MC
 # First configuration part comes (set 'INPUTLIST', 'OUTPUTDIR', 
-# 'reco', 'gen', 'mc', 'NP', 'outrootsuffix'), then call to cmsRun, 
-# which process analyzer_cfg.py file (find there further description 
-# if needed). To run this script, execute the command:
+# 'reco', 'gen', 'mc', 'NP', 'NBATCH', 'NRETRY', 'outrootsuffix'), then 
+# input files are queued and workers (runWorker.sh) are started, which 
+# call cmsRun to process analyzer_cfg.py file (find there further 
+# description if needed). To run this script, execute the command:
 # ./run.sh. You need to run this script once per each data and MC sample 
 # (see below INPUTLIST variable).
 #
 # You may run this script in the terminal and close the terminal, 
 # the jobs will keep working (nohup). If you need to kill all running 
-# jobs, execute the command 'killall -9 cmsRun'. To monitor running 
-# jobs you could use './running.sh <dir>' and './processed.sh <dir>', 
+# jobs, execute the command 'killall -9 runWorker.sh cmsRun'. To monitor 
+# running jobs you could use './running.sh <dir>' and './processed.sh <dir>', 
 # where <dir> is the output directory.
 #
+# If the jobs were killed (or some files failed), run this script again 
+# with the same settings: the campaign is resumed, i.e. only input files 
+# which are not recorded as done in <dir>/manifest.txt are processed.
+#
 ########################################################################
 ########################## Input lists #################################
 ########################################################################
@@ -115,10 +120,28 @@ mc=0
 #  2) on Intel Core i5-5300U (2.3GHz) one processor core becomes ~100% busy with ~5 jobs
 #  3) depends heavily on the network access (with slow network you will not win much with many parallel jobs)
 #  4) timing results can be quite stochastic
-# Splitting of input files between parallel jobs is done automatically
-# (there will be NP root and log files in the output directory).
+# Input files are split into small batches (NBATCH files each) and put 
+# into a queue: each of NP parallel workers runs cmsRun for the next batch 
+# as soon as its previous one is finished, so a slow or large file does 
+# not leave the other workers idle (there will be a log file per batch 
+# and a root file per input file in the output directory, see out_perFile
+# in analyzer_cfg.py). If cmsRun fails (typically xrootd 
+# problems), the batch is split into single files, and each file is 
+# retried up to NRETRY times (see runWorker.sh for details).
 #
 NP=1
+NBATCH=5 # number of input files per cmsRun job
+NRETRY=3 # number of attempts for each input file
+#
+# Prefetching of input files: if STAGEDIR is set (local scratch directory, 
+# e.g. STAGEDIR='/tmp/ttbar-stage'), each worker copies the input files 
+# of its next job (xrdcp) while the current job is running, using at most 
+# STAGEMAXMB MB of disk space per worker (other files are read remotely), 
+# and removes the copies after the job. Without local staging, reading 
+# remote files can be tuned in analyzer_cfg.py (in_cacheSize, in_cacheHint, 
+# in_readHint).
+STAGEDIR=''
+STAGEMAXMB=10000
 outrootsuffix='' # optional suffix for output root file names (can be a subdirectory, for instance)
 #
 ########################################################################
@@ -136,25 +159,66 @@ then
   echo "Error: no input file $INPUTLIST"
   exit 1
 fi
+manifest=${OUTPUTDIR}/manifest.txt
 if [ -d $OUTPUTDIR ]
 then
-  echo "Error: output directory $OUTPUTDIR exists"
-  exit 1
-else
-  mkdir -p $OUTPUTDIR
-  p=0
-  for inputFile in `cat $INPUTLIST`
+  # existing output directory: resume
+  if [ ! -f $manifest ]
+  then
+    echo "Error: output directory $OUTPUTDIR exists, but has no manifest.txt"
+    exit 1
+  fi
+  if pgrep -f "runWorker.sh ${OUTPUTDIR} " > /dev/null
+  then
+    echo "Error: workers for output directory $OUTPUTDIR are still running"
+    exit 1
+  fi
+  echo "Resuming in output directory $OUTPUTDIR"
+  # jobs which were not finished are queued again below
+  rm -rf ${OUTPUTDIR}/queue ${OUTPUTDIR}/running ${OUTPUTDIR}/tmp
+  # output files without records (see runWorker.sh) are incomplete
+  for output in `ls ${OUTPUTDIR} | grep "^ttbarSel.*\.root$"`
   do
-    p=$[$p+1]
-    echo $inputFile >> "$OUTPUTDIR/inputList"${outrootsuffix}"_$p.txt"
-    if [ $p == $NP ]; then p=0; fi
+    if [ ! -f ${OUTPUTDIR}/${output%.root}.lumis.txt ]; then rm -f ${OUTPUTDIR}/${output}; fi
   done
+else
+  mkdir -p $OUTPUTDIR
+  touch $manifest
 fi
-# call cmsRun analyzer_cfg.py for each parallel job
+mkdir -p ${OUTPUTDIR}/queue ${OUTPUTDIR}/running ${OUTPUTDIR}/tmp ${OUTPUTDIR}/failed
+# input files already done: recorded in manifest and the output record exists
+# (partially processed files are queued as single-file jobs, their stored luminosity
+# sections are skipped, see runWorker.sh)
+awk '$1 == "done" {print $2, $3}' $manifest | while read output inputFile
+do
+  if [ -f ${OUTPUTDIR}/${output}.lumis.txt ]; then echo $inputFile; fi
+done | sort -u > ${OUTPUTDIR}/tmp/done.txt
+# new job ids (job_<start>_<batch>.txt) for each (re)start, not to mix with outputs of previous starts
+start=$[`cat ${OUTPUTDIR}/nstart 2>/dev/null || echo 0`+1]
+echo $start > ${OUTPUTDIR}/nstart
+awk '$1 == "partial" {print $3}' $manifest | grep -v -x -F -f ${OUTPUTDIR}/tmp/done.txt | sort -u > ${OUTPUTDIR}/tmp/partial.txt
+# split remaining input files into batches (partially processed files alone)
+n=0
+b=0
+for inputFile in `grep -v -x -F -f ${OUTPUTDIR}/tmp/done.txt $INPUTLIST`
+do
+  if grep -q -x -F ${inputFile} ${OUTPUTDIR}/tmp/partial.txt
+  then
+    b=$[$b+1]
+    echo $inputFile > ${OUTPUTDIR}/queue/job_${start}_`printf %05d $b`.txt
+    n=0
+    continue
+  fi
+  if [ $n == 0 ]; then b=$[$b+1]; fi
+  echo $inputFile >> ${OUTPUTDIR}/queue/job_${start}_`printf %05d $b`.txt
+  n=$[$n+1]
+  if [ $n == $NBATCH ]; then n=0; fi
+done
+echo "Queued $b jobs (`cat ${OUTPUTDIR}/tmp/done.txt | wc -l` files already done)"
+# start NP workers to process the queue
 for p in `seq 1 $NP`
 do
-  command="time cmsRun analyzer_cfg.py ${OUTPUTDIR}/inputList${outrootsuffix}_${p}.txt ${OUTPUTDIR}/ttbarSel${outrootsuffix}_${p}.root ${reco} ${gen} ${mc}"
-  nohup ${command} >& ${OUTPUTDIR}/log${outrootsuffix}_${p}.txt&
+  nohup ./runWorker.sh ${OUTPUTDIR} ${reco} ${gen} ${mc} ${NRETRY} "${STAGEDIR}" ${STAGEMAXMB} ${outrootsuffix} >& ${OUTPUTDIR}/worker${outrootsuffix}_${p}.txt&
 done
 ########################################################################
 
@@ -0,0 +1,330 @@
+#!/bin/bash
+#
+# Worker for the job queue prepared by run.sh (normally you do not need
+# to run this script yourself: run.sh starts NP workers with nohup).
+# Usage:
+#   ./runWorker.sh <outputdir> <reco> <gen> <mc> <nretry> <stagedir> <stagemaxmb> [outrootsuffix]
+#
+# The worker repeatedly takes the next job (input file list) from
+# <outputdir>/queue/ and runs cmsRun analyzer_cfg.py on it. A job is claimed
+# by moving its list to <outputdir>/running/ ('mv' is atomic, so each job
+# is taken by exactly one worker), the worker pid is recorded in
+# <outputdir>/tmp/owner_<job>. Idle workers put jobs of workers which are not
+# running anymore back into the queue.
+# If <stagedir> is not empty, the worker picks the next queued job (not
+# staged by another worker) when cmsRun for the current one is started, and
+# copies its input files with xrdcp to <stagedir> (at most <stagemaxmb> MB
+# per worker, the rest is read remotely), so that the next job reads local
+# files. The next job is not claimed while it is staged: if an idle worker
+# takes it meanwhile, the staged copies are dropped. Staged copies are
+# removed after the job.
+# Analyzer writes output files ttbarSel_<job>.root, ttbarSel_<job>_<N>.root
+# (switched after each input file, see out_perFile in analyzer_cfg.py) to
+# <outputdir>/tmp/, each with the record <name>.lumis.txt written once the
+# output file is complete. Complete output files (also from failed jobs) are
+# moved to <outputdir>/, so <outputdir>/*.root contains only complete files.
+# In <outputdir>/manifest.txt the following lines are recorded:
+#   'done <output> <file>': input file is completely processed (its last
+#      events are in <output>.root)
+#   'partial <output> <file>': input file was not completed by an aborted
+#      job, but some of its luminosity sections are stored in <output>.root
+#      (those listed after the last closed input file in the record; they are
+#      skipped when the file is processed again, always as a single-file job,
+#      since a luminosity section can be spread over several input files)
+#   'failed <job> <file>': input file failed <nretry> times
+# If not all input files of the job are done (cmsRun failed, typically
+# xrootd error on file open or read):
+#  - remaining files of a job with several files are split into single-file
+#    jobs (so one bad file does not block the others, and the partially
+#    processed file is rerun alone), which are put back into the queue;
+#  - a single-file job is put back into the queue, until it failed
+#    <nretry> times, then it is recorded as failed.
+# Logs of failed attempts are kept in <outputdir>/failed/.
+# The worker exits when there are no queued or running jobs.
+#
+if [ $# -lt 7 ]
+then
+  echo "Usage: $0 <outputdir> <reco> <gen> <mc> <nretry> <stagedir> <stagemaxmb> [outrootsuffix]"
+  exit 1
+fi
+OUTPUTDIR=$1
+reco=$2
+gen=$3
+mc=$4
+NRETRY=$5
+STAGEDIR=$6
+STAGEMAXMB=$7
+outrootsuffix=$8
+manifest=${OUTPUTDIR}/manifest.txt
+
+# claim the job $1 from the queue (fails if it was taken by another worker)
+claim()
+{
+  mv ${OUTPUTDIR}/queue/$1 ${OUTPUTDIR}/running/$1 2>/dev/null || return 1
+  echo $$ > ${OUTPUTDIR}/tmp/owner_$1
+}
+
+# claim the next job from the queue, preferring jobs which are not being staged by
+# other workers (prints its name, nothing if the queue is empty)
+claim_job()
+{
+  for queued in `ls ${OUTPUTDIR}/queue/`
+  do
+    if [ ! -f ${OUTPUTDIR}/tmp/stage_${queued} ] && claim ${queued}
+    then
+      echo ${queued}
+      return
+    fi
+  done
+  for queued in `ls ${OUTPUTDIR}/queue/`
+  do
+    if claim ${queued}
+    then
+      echo ${queued}
+      return
+    fi
+  done
+}
+
+# pick the next queued job to be staged by this worker, without claiming it
+# (prints its name, nothing if all queued jobs are staged by other workers)
+stage_next()
+{
+  for queued in `ls ${OUTPUTDIR}/queue/`
+  do
+    if ( set -C; echo $$ > ${OUTPUTDIR}/tmp/stage_${queued} ) 2>/dev/null
+    then
+      echo ${queued}
+      return
+    fi
+  done
+}
+
+# put running jobs of dead workers (owner pid not among the workers of this
+# output directory, see run.sh) back into the queue
+requeue_orphans()
+{
+  for running in `ls ${OUTPUTDIR}/running/`
+  do
+    owner=${OUTPUTDIR}/tmp/owner_${running}
+    pid=`cat ${owner} 2>/dev/null`
+    # no owner yet: the job is being claimed
+    if [ -z "${pid}" ]; then continue; fi
+    if pgrep -f "runWorker.sh ${OUTPUTDIR} " | grep -q -x ${pid}; then continue; fi
+    # take over the owner record (only one idle worker succeeds), check that
+    # the job was not requeued and claimed again meanwhile
+    token=${OUTPUTDIR}/tmp/orphan_${running}_$$
+    mv ${owner} ${token} 2>/dev/null || continue
+    if [ "`cat ${token}`" != "${pid}" ]
+    then
+      mv ${token} ${owner}
+      continue
+    fi
+    if [ -n "${STAGEDIR}" ]; then rm -rf ${STAGEDIR}/${pid}_*; fi
+    mv ${OUTPUTDIR}/running/${running} ${OUTPUTDIR}/queue/${running}
+    rm -f ${token}
+    id=${running#job_}
+    echo "Job ${id%.txt} of worker ${pid}, which is not running anymore, put back into the queue"
+  done
+}
+
+# copy input files from the list $1 to the directory $2 (while the total size stays
+# below STAGEMAXMB MB and there is enough free disk space), writing lines
+# '<file> <local copy>' to $2/map.txt; files which could not be copied are read remotely
+stage_files()
+{
+  mkdir -p $2
+  touch $2/map.txt
+  # (the list may be gone already, if the job was taken by another worker)
+  for inputFile in `cat $1 2>/dev/null`
+  do
+    # file size from xrootd server (root://<server>/<path>)
+    server=`echo ${inputFile} | cut -d/ -f3`
+    path=/${inputFile#root://*/}
+    size=`xrdfs ${server} stat ${path} 2>/dev/null | awk '$1 == "Size:" {print int($2 / 1048576) + 1}'`
+    if [ -z "${size}" ]; then continue; fi
+    used=`du -sm $2 | awk '{print $1}'`
+    free=`df -Pm $2 | awk 'NR == 2 {print $4}'`
+    if [ $[${used}+${size}] -gt ${STAGEMAXMB} ] || [ ${size} -ge ${free} ]; then break; fi
+    copy=$2/`basename ${inputFile}`
+    if xrdcp -s ${inputFile} ${copy}.part >& /dev/null && mv ${copy}.part ${copy}
+    then
+      echo "${inputFile} file:${copy}" >> $2/map.txt
+    else
+      rm -f ${copy}.part
+    fi
+  done
+}
+
+# input files listed in the output record $1 (local copies replaced by original names using map file $2)
+record_files()
+{
+  awk -v map=$2 'BEGIN {while((getline line < map) > 0) {split(line, w, " "); sub(/^file:/, "", w[2]); orig[w[2]] = w[1]}}
+    $1 == "file" {f = $2; sub(/^file:/, "", f); print (f in orig) ? orig[f] : $2}' $1
+}
+
+# luminosity sections in the output record $1 ended after its last closed input file,
+# i.e. while the next input file was open
+open_lumis()
+{
+  awk '$1 == "file" {n = 0} $1 == "lumi" {l[n++] = $0} END {for(i = 0; i < n; i++) print l[i]}' $1
+}
+
+# run cmsRun for the job $1 (reading staged copies from directory $2, if any) and process the result
+process_job()
+{
+  # job id from list name job_<id>.txt, output name (different for each attempt)
+  job=$1
+  id=${job#job_}
+  id=${id%.txt}
+  list=${OUTPUTDIR}/running/${job}
+  owner=${OUTPUTDIR}/tmp/owner_${job}
+  stagemap=$2/map.txt
+  attempt=$[`cat ${OUTPUTDIR}/tmp/attempts_${id} 2>/dev/null || echo 0`+1]
+  run=${id}
+  if [ $attempt -gt 1 ]; then run=${id}r${attempt}; fi
+  outbase=ttbarSel${outrootsuffix}_${run}
+  outlog=log${outrootsuffix}_${run}.txt
+  # luminosity sections of the input file stored by previous aborted jobs (partially
+  # processed files are always in single-file jobs, the skipped luminosity sections
+  # must not be applied to other files which might contain parts of them)
+  skip=${OUTPUTDIR}/tmp/skip_${run}.txt
+  if [ `cat ${list} | wc -l` -eq 1 ]
+  then
+    awk -v f=`cat ${list}` '$1 == "partial" && $3 == f {print $2}' ${manifest} | sort -u | while read output
+    do
+      if [ -f ${OUTPUTDIR}/${output}.lumis.txt ]; then open_lumis ${OUTPUTDIR}/${output}.lumis.txt; fi
+    done > ${skip}
+  else
+    touch ${skip}
+  fi
+  # input list for cmsRun, with staged copies
+  input=${OUTPUTDIR}/tmp/input_${run}.txt
+  awk -v map=${stagemap} 'BEGIN {while((getline line < map) > 0) {split(line, w, " "); copy[w[1]] = w[2]}}
+    {print ($1 in copy) ? copy[$1] : $1}' ${list} > ${input}
+  { time cmsRun analyzer_cfg.py ${input} ${OUTPUTDIR}/tmp/${outbase}.root ${reco} ${gen} ${mc} ${skip} ; } >& ${OUTPUTDIR}/tmp/${outlog}
+  status=$?
+  # collect complete output files (with records): first record in manifest, then move
+  # output in place (run.sh treats files as done only if the output record exists)
+  # (in the order of writing: <outbase>, <outbase>_1, ...)
+  records=`ls ${OUTPUTDIR}/tmp/ | grep -E "^${outbase}(_[0-9]+)?\.lumis\.txt$" | sort -V`
+  for record in ${records}
+  do
+    output=${record%.lumis.txt}
+    for inputFile in `record_files ${OUTPUTDIR}/tmp/${record} ${stagemap}`
+    do
+      echo "done ${output} ${inputFile}" >> ${manifest}
+    done
+  done
+  remaining=`grep -v -x -F -f <(for record in ${records}; do record_files ${OUTPUTDIR}/tmp/${record} ${stagemap}; done) ${list}`
+  # the first remaining file was open when the job stopped: its luminosity sections
+  # stored so far are those ended after the last closed input file
+  partial=''
+  for record in ${records}
+  do
+    if grep -q "^file " ${OUTPUTDIR}/tmp/${record}; then partial=''; fi
+    if [ -n "`open_lumis ${OUTPUTDIR}/tmp/${record}`" ]; then partial="${partial} ${record%.lumis.txt}"; fi
+  done
+  if [ -n "${remaining}" ]
+  then
+    for output in ${partial}
+    do
+      echo "partial ${output} `echo ${remaining} | awk '{print $1}'`" >> ${manifest}
+    done
+  fi
+  for record in ${records}
+  do
+    output=${record%.lumis.txt}
+    mv ${OUTPUTDIR}/tmp/${output}.root ${OUTPUTDIR}/${output}.root
+    mv ${OUTPUTDIR}/tmp/${record} ${OUTPUTDIR}/${record}
+  done
+  # drop incomplete output and heartbeat (see running.sh)
+  rm -f ${OUTPUTDIR}/tmp/${outbase}.root ${OUTPUTDIR}/tmp/${outbase}_*.root ${OUTPUTDIR}/tmp/${outbase}*.tmp ${OUTPUTDIR}/tmp/${outbase}.heartbeat.json ${skip} ${input}
+  if [ $status == 0 ] && [ -z "${remaining}" ]
+  then
+    # success (job summary ${outbase}.stat.json is used for the timing in processed.sh)
+    mv ${OUTPUTDIR}/tmp/${outbase}.stat.json ${OUTPUTDIR}/ 2>/dev/null
+    mv ${OUTPUTDIR}/tmp/${outlog} ${OUTPUTDIR}/${outlog}
+    rm -f ${list} ${owner} ${OUTPUTDIR}/tmp/attempts_${id}
+    return
+  fi
+  # failure: keep the log (and summary, if the job finished)
+  mv ${OUTPUTDIR}/tmp/${outbase}.stat.json ${OUTPUTDIR}/failed/ 2>/dev/null
+  mv ${OUTPUTDIR}/tmp/${outlog} ${OUTPUTDIR}/failed/${outlog}
+  echo "Job ${id} failed (exit code ${status}, attempt ${attempt}), see ${OUTPUTDIR}/failed/${outlog}"
+  nfiles=`echo ${remaining} | wc -w`
+  if [ $nfiles -gt 1 ]
+  then
+    # split remaining files into single-file jobs
+    f=0
+    for inputFile in ${remaining}
+    do
+      f=$[$f+1]
+      echo $inputFile > ${OUTPUTDIR}/tmp/job_${id}-${f}.txt
+      mv ${OUTPUTDIR}/tmp/job_${id}-${f}.txt ${OUTPUTDIR}/queue/
+    done
+    rm -f ${list} ${owner} ${OUTPUTDIR}/tmp/attempts_${id}
+  elif [ $nfiles -eq 1 ] && [ $attempt -lt $NRETRY ]
+  then
+    # retry later (xrootd problems are often transient)
+    echo $attempt > ${OUTPUTDIR}/tmp/attempts_${id}
+    echo ${remaining} > ${list}
+    sleep 30
+    rm -f ${owner}
+    mv ${list} ${OUTPUTDIR}/queue/
+  else
+    for inputFile in ${remaining}
+    do
+      echo "failed ${id} ${inputFile}" >> ${manifest}
+    done
+    rm -f ${list} ${owner} ${OUTPUTDIR}/tmp/attempts_${id}
+  fi
+}
+
+# staging directory of the job $1 (unique for this worker)
+stage_dir()
+{
+  if [ -n "${STAGEDIR}" ]; then echo ${STAGEDIR}/$$_${1%.txt}; else echo ${OUTPUTDIR}/tmp/nostage; fi
+}
+
+job=''
+while true
+do
+  if [ -z "$job" ]; then job=`claim_job`; fi
+  if [ -z "$job" ]
+  then
+    # empty queue: finish if no running jobs left (failed running jobs
+    # might put new jobs into the queue, jobs of dead workers are put
+    # back into the queue here), otherwise wait for them
+    requeue_orphans
+    if [ -n "`ls ${OUTPUTDIR}/queue/`" ]; then continue; fi
+    if [ -z "`ls ${OUTPUTDIR}/running/`" ]; then break; fi
+    sleep 10
+    continue
+  fi
+  # stage input files of the next queued job while this job is running
+  next=''
+  stagepid=''
+  if [ -n "${STAGEDIR}" ]
+  then
+    next=`stage_next`
+    if [ -n "$next" ]
+    then
+      stage_files ${OUTPUTDIR}/queue/${next} `stage_dir ${next}` &
+      stagepid=$!
+    fi
+  fi
+  process_job ${job} `stage_dir ${job}`
+  # evict staged copies of the finished job (retries read the files again)
+  if [ -n "${STAGEDIR}" ]; then rm -rf `stage_dir ${job}`; fi
+  if [ -n "${stagepid}" ]; then wait ${stagepid}; fi
+  # continue with the staged job, unless it was taken by another worker meanwhile
+  job=''
+  if [ -n "$next" ]
+  then
+    if claim ${next}; then job=${next}; else rm -rf `stage_dir ${next}`; fi
+    rm -f ${OUTPUTDIR}/tmp/stage_${next}
+  fi
+done
+
+exit 0
@@ -1,16 +1,17 @@
 #!/bin/bash
+#
+# Monitor running jobs in the output directory <dir>: ./running.sh <dir>
+# For each running job, processed and selected events and the recent 
+# processing rate are printed from its heartbeat file (written by Analyzer 
+# each 'out_heartbeat' seconds, see analyzer_cfg.py and src/AnalyzerStat.h).
+#
 
 echo "cmsRun = "$[$[`ps aux | grep cmsRun | grep anal | wc -l`]/2]
 
 dir=$1
-sum1=0
-sum2=0
-for file in `ls $dir/log*`
+for file in `ls $dir/*.heartbeat.json $dir/tmp/*.heartbeat.json 2>/dev/null`
 do
-  n1=`grep NEVENTS $file | tail -n1 | awk '{print $4}'`
-  n2=`grep NEVENTS $file | tail -n1 | awk '{print $8}'`
-  sum1=$[$n1+$sum1]
-  sum2=$[$n2+$sum2]
-  echo n=$n1 K [${n2}]
-done
-echo sum=$sum1 K [$sum2]
+  # top level keys: one per line, indented by two spaces
+  awk -F'[:,]' '/^  "events":/ {n1 = $2} /^  "selected":/ {n2 = $2} /^  "eventsPerSecondRecent":/ {r = $2} /^  "bytesRead":/ {b = $2} 
+    END {printf("n=%d [%d] %.1f events/s %.1f MB read\n", n1, n2, r, b / 1e6)}' $file
+done | awk '{print} {n1 += substr($1, 3); gsub(/[\[\]]/, "", $2); n2 += $2; r += $3} END {printf("sum=%d [%d] %.1f events/s\n", n1, n2, r)}'
@@ -0,0 +1,72 @@
+// -*- C++ -*-
+//
+// Package:    Analyzer
+//
+// Trigger names used in the analysis (shared by Analyzer and SkimFilter):
+// the bit number in the stored 'Triggers' integer is the index in this list
+// (PostAnalyzer relies on it, see PostAnalyzer/eventReco.h).
+// The names are patterns for the full trigger path names, with '*'
+// matching any characters. They are the path name prefixes followed by '*',
+// so that each 2011 menu gives the same paths as the original substring
+// matching, e.g. HLT_DoubleMu7* matches HLT_DoubleMu7_v* and also
+// HLT_DoubleMu7_Acoplanarity03_v*, HLT_Ele8_CaloIdT_TrkIdVL_CaloIsoVL_TrkIsoVL*
+// matches also its _Jet* variants (the paths matched in the current menu are
+// printed by Analyzer::PrintTriggerBits).
+// An empty name is a reserved bit, which is never set.
+//
+
+#ifndef ANALYZER_ANALYSISTRIGGERS_H
+#define ANALYZER_ANALYSISTRIGGERS_H
+
+#include <string>
+#include <vector>
+#include <utility>
+#include <fnmatch.h>
+
+// fill the list of trigger name patterns (index = bit number)
+inline void AnalysisTriggerNames(std::vector<std::string>& names)
+{
+  names.clear();
+  // mumu triggers (bits 0 - 5)
+  names.push_back("HLT_DoubleMu7*");
+  names.push_back("HLT_Mu13_Mu8*");
+  names.push_back("HLT_Mu17_Mu8*");
+  names.push_back("HLT_DoubleMu6*");
+  names.push_back("HLT_DoubleMu45*");
+  // reserved (was "HLT_Mu10_Ele10_CaloIdl", which never matched because of the
+  // wrong case, kept not to change the following bits)
+  names.push_back("");
+  // ee triggers (bits 6 - 11)
+  names.push_back("HLT_Ele17_CaloIdL_CaloIsoVL_Ele8_CaloIdL_CaloIsoVL*");
+  names.push_back("HLT_Ele17_CaloIdT_TrkIdVL_CaloIsoVL_TrkIsoVL*");
+  names.push_back("HLT_Ele8_CaloIdT_TrkIdVL_CaloIsoVL_TrkIsoVL*");
+  names.push_back("HLT_Ele17_CaloIdT_CaloIsoVL_TrkIdVL_TrkIsoVL_*");
+  names.push_back("HLT_Ele8_CaloIdT_CaloIsoVL_TrkIdVL_TrkIsoVL*");
+  names.push_back("HLT_DoubleEle45_CaloIdL*");
+  // emu triggers (bits 12 - 16)
+  names.push_back("HLT_Mu10_Ele10_CaloIdL*");
+  names.push_back("HLT_Mu8_Ele17_CaloIdL*");
+  names.push_back("HLT_Mu17_Ele8_CaloIdL*");
+  names.push_back("HLT_Mu8_Ele17_CaloIdT_CaloIsoVL*");
+  names.push_back("HLT_Mu17_Ele8_CaloIdT_CaloIsoVL*");
+}
+
+// returns true if trigger path name matches the pattern (empty pattern matches nothing)
+inline bool MatchTriggerName(const std::string& path, const std::string& pattern)
+{
+  return !pattern.empty() && fnmatch(pattern.c_str(), path.c_str(), 0) == 0;
+}
+
+// find (path index, bit number) pairs for all trigger paths (pathNames, e.g. from
+// HLTConfigProvider::triggerNames()) which match the patterns (names, index = bit number)
+inline void FindAnalysisTriggerPaths(const std::vector<std::string>& pathNames, const std::vector<std::string>& names,
+  std::vector<std::pair<unsigned int, int> >& pathBits)
+{
+  pathBits.clear();
+  for(unsigned int i = 0; i < pathNames.size(); i++)
+    for(unsigned int n = 0; n < names.size(); n++)
+      if(MatchTriggerName(pathNames[i], names[n]))
+        pathBits.push_back(std::pair<unsigned int, int>(i, n));
+}
+
+#endif
@@ -14,13 +14,17 @@
 
 // system include files
 #include <memory>
+#include <map>
 
 // user include files
 #include "FWCore/Framework/interface/Frameworkfwd.h"
 #include "FWCore/Framework/interface/EDAnalyzer.h"
 #include "FWCore/Framework/interface/Event.h"
+#include "FWCore/Framework/interface/LuminosityBlock.h"
+#include "FWCore/Framework/interface/FileBlock.h"
 #include "FWCore/Framework/interface/MakerMacros.h"
 #include "FWCore/ParameterSet/interface/ParameterSet.h"
+#include "FWCore/Utilities/interface/Exception.h"
 
 //------ EXTRA HEADER FILES--------------------//
 #include "math.h"
@@ -30,6 +34,7 @@
 #include "FWCore/ServiceRegistry/interface/Service.h"
 #include "CommonTools/UtilAlgos/interface/TFileService.h"
 #include "DataFormats/Common/interface/Ref.h"
+#include "DataFormats/Common/interface/MergeableCounter.h"
 
 // for tracking information
 #include "DataFormats/TrackReco/interface/Track.h"
@@ -64,18 +69,29 @@
 // triggers
 #include "DataFormats/Common/interface/TriggerResults.h"
 #include "HLTrigger/HLTcore/interface/HLTConfigProvider.h"
+#include "DataFormats/Provenance/interface/ParameterSetID.h"
 
 // for MC generator level
 #include "DataFormats/HepMCCandidate/interface/GenParticle.h"
 
+// trigger names used in the analysis
+#include "AnalysisTriggers.h"
+
+// instrumentation (timing, cut-flow, heartbeat)
+#include "AnalyzerStat.h"
+
 // ROOT
 #include <TLorentzVector.h>
 #include <TFile.h>
 #include <TTree.h>
+#include <RVersion.h>
+#include <Compression.h>
 
 #include <TTree.h>
 #include <TDirectory.h>
 
+#include <cstdio>
+
 //
 // class declaration
 //
@@ -96,6 +112,8 @@ class Analyzer : public edm::EDAnalyzer {
       virtual void endRun(edm::Run const&, edm::EventSetup const&);
       virtual void beginLuminosityBlock(edm::LuminosityBlock const&, edm::EventSetup const&);
       virtual void endLuminosityBlock(edm::LuminosityBlock const&, edm::EventSetup const&);
+      virtual void respondToOpenInputFile(edm::FileBlock const&);
+      virtual void respondToCloseInputFile(edm::FileBlock const&);
       
       // user routines (detailed description given with the method implementations)
       int SelectEvent(const edm::Event& iEvent);
@@ -103,15 +121,19 @@ class Analyzer : public edm::EDAnalyzer {
       int SelectEl(const edm::Handle<reco::GsfElectronCollection>& electrons, const reco::VertexCollection::const_iterator& pv);
       int SelectJet(const edm::Handle<reco::PFJetCollection>& jets, const reco::JetTagCollection& bTags, const edm::Event& iEvent, const edm::EventSetup& iSetup);
       int SelectMET(const edm::Handle<edm::View<reco::PFMET> >& pfmets);
-      reco::PFJetCollection::const_iterator MatchJet(const edm::Handle<reco::PFJetCollection>& jets, const edm::RefToBase<reco::Jet>& jettag, double& diff, double& nextdiff);
+      int MatchJet(const edm::Handle<reco::PFJetCollection>& jets, const edm::RefToBase<reco::Jet>& jettag, double& diff, double& nextdiff);
+      void FillJetGrid(const edm::Handle<reco::PFJetCollection>& jets);
       void FindTriggerBits(const HLTConfigProvider& trigConf);
       void SelectTriggerBits(const edm::Handle<edm::TriggerResults>& HLTR);
-      void PrintTriggerBits();
+      void PrintTriggerBits(const HLTConfigProvider& trigConf);
       int SelectPrimaryVertex(const edm::Handle<reco::VertexCollection>& primVertex);
       const reco::Candidate* GetFinalState(const reco::Candidate* particle, const int id);
+      const reco::Candidate* FindFinalState(const reco::Candidate* particle, const int id);
       void FillFourMomentum(const reco::Candidate* particle, float* p);
       void SelectMCGen(const edm::Handle<reco::GenParticleCollection>& genParticles);
       void InitBranchVars();
+      void RolloverOutput();
+      void WriteOutputRecord(const std::string& outputName);
 
       // input tags
       edm::InputTag _inputTagMuons;
@@ -125,19 +147,53 @@ class Analyzer : public edm::EDAnalyzer {
 
       // jet correction label
       std::string mJetCorr;
+      // jet energy corrector (retrieved at the beginning of each run)
+      const JetCorrector* _jetCorrector;
+      // upper bound of jet energy correction factor: jets with uncorrected pT 
+      // below (pT threshold) / _jetMaxJEC are rejected without applying JEC
+      double _jetMaxJEC;
+      // validation of _jetMaxJEC (if _flagValidateJEC): JEC is evaluated also for 
+      // the rejected jets, counted are evaluated jets, rejected jets which would 
+      // pass the pT threshold after JEC, and the maximum JEC factor
+      int _flagValidateJEC;
+      long _nJetsValidateJEC;
+      long _nJetsLostJEC;
+      double _maxJEC;
 
       // general flags and variables
       int _flagMC;
       int _flagRECO;
       int _flagGEN;
+      int _flagSlim;
       int _nevents;
       int _neventsSelected;
+      // events rejected by SkimFilter before Analyzer (from its 'nEvents' luminosity section 
+      // product, empty label if not run), events processed in the current luminosity section
+      std::string _skimLabel;
+      int _neventsSkimRejected;
+      int _neventsLumi;
       int _signLeptonP;
       int _signLeptonM;
       
       // storage
       TFile* _file;
       TTree* _tree;
+      // output rollover: new output file after each input file (_flagPerFile) or 
+      // after _rolloverEvents processed events, done at the end of luminosity section
+      int _flagPerFile;
+      int _rolloverEvents;
+      int _neventsOutput;
+      // events processed (including those rejected by SkimFilter) and selected 
+      // while the current output file was open (see WriteOutputRecord())
+      int _neventsOutputProcessed;
+      int _neventsOutputSelected;
+      bool _rolloverPending;
+      // record lines for input files closed and (run, luminosity section) pairs ended
+      // since the current output file was opened, in this order (see WriteOutputRecord())
+      std::vector<std::string> _vecOutputRecord;
+      bool _lumiOpen;
+      // instrumentation: stage timing, cut-flow, input files (see AnalyzerStat.h)
+      AnalyzerStat* _stat;
       
       // >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
       // >>>>>>>>>>>>>>>> event variables >>>>>>>>>>>>>>>>>>>>>>>
@@ -185,13 +241,30 @@ class Analyzer : public edm::EDAnalyzer {
       float _jetBTagDiscr[_maxNjet];
       float _jetBTagMatchDiff1[_maxNjet];
       float _jetBTagMatchDiff2[_maxNjet];
+      // b-tagging info for each jet in the collection (by jet index, see SelectJet())
+      std::vector<double> _vecJetBTagDiscr;
+      std::vector<double> _vecJetBTagDiff1;
+      std::vector<double> _vecJetBTagDiff2;
+      // eta-phi grid of jets for b-tagging matching (see MatchJet()): 
+      // jet indices sorted by cell, first index for each cell, cell of each jet
+      static const int _gridNEta = 20;
+      static const int _gridNPhi = 12;
+      std::vector<int> _vecGridJets;
+      std::vector<int> _vecGridFirst;
+      std::vector<int> _vecGridCell;
+      bool _gridFilled;
       // MET
       float _metPx;
       float _metPy;
       // triggers
       int _triggers;
-      std::vector<std::vector<int> > _vecTriggerBits;
       std::vector<std::string> _vecTriggerNames;
+      // (trigger path index, bit number) pairs for the current HLT menu
+      std::vector<std::pair<unsigned int, int> > _vecTriggerPathBits;
+      // the same for all HLT menus seen so far (key: HLT process configuration ID)
+      std::map<edm::ParameterSetID, std::vector<std::pair<unsigned int, int> > > _mapTriggerPathBits;
+      // HLT configuration (kept between runs to know if the menu changed)
+      HLTConfigProvider _triggerConfig;
       // primary vertex
       int _Npv;
       int _pvNDOF;
@@ -216,8 +289,22 @@ class Analyzer : public edm::EDAnalyzer {
       float _mcNu[4];
       float _mcLm[4];
       float _mcNubar[4];
+      // generator level particles already searched without result in GetFinalState()
+      static const int _maxGenSearched = 64;
+      const reco::Candidate* _genSearched[_maxGenSearched];
+      int _nGenSearched;
 };
 
+//
+// output file name without '.root' suffix
+//
+inline std::string OutputBaseName(const std::string& outputName)
+{
+  if(outputName.size() > 5 && outputName.compare(outputName.size() - 5, 5, ".root") == 0)
+    return outputName.substr(0, outputName.size() - 5);
+  return outputName;
+}
+
 //
 // constants (particle masses)
 //
@@ -244,16 +331,57 @@ Analyzer::Analyzer(const edm::ParameterSet& iConfig)
   
   // jet correction label
   mJetCorr = "ak5PFL1FastL2L3Residual";
+  _jetCorrector = NULL;
+  // (assumed to be above L1FastL2L3Residual corrections for |eta| < 2.4, 
+  // can be checked with validateJEC = 1, see SelectJet())
+  _jetMaxJEC = 3.0;
 
   // read configuration parameters
   _flagMC = iConfig.getParameter<int>("mc"); // true for MC, false for data
   _flagRECO = iConfig.getParameter<int>("reco"); // if true, RECO level processed
   _flagGEN = iConfig.getParameter<int>("gen"); // if true, generator level processed (works only for MC)
-  _nevents = 0; // number of processed events
+  _nevents = 0; // number of events processed in Analyzer
   _neventsSelected = 0; // number of selected events
+  _skimLabel = iConfig.getParameter<std::string>("skim"); // SkimFilter module label ('' if not run)
+  _neventsSkimRejected = 0;
+  _neventsLumi = 0;
+  _flagSlim = iConfig.getParameter<int>("slim"); // if true, branches not used in PostAnalyzer are not stored
+  _flagValidateJEC = iConfig.getParameter<int>("validateJEC"); // if true, JEC is evaluated also for jets rejected before JEC
+  _nJetsValidateJEC = 0;
+  _nJetsLostJEC = 0;
+  _maxJEC = 0.0;
   std::string fileout = iConfig.getParameter<std::string>("outFile"); // output file name
   _file = new TFile(fileout.c_str(), "recreate"); // output file
+  // output compression: algorithm (zlib, lzma or lz4) and level
+  std::string compression = iConfig.getParameter<std::string>("compression");
+  int compressionLevel = iConfig.getParameter<int>("compressionLevel");
+  if(compression == "zlib")
+    _file->SetCompressionSettings(ROOT::CompressionSettings(ROOT::kZLIB, compressionLevel));
+  else if(compression == "lzma")
+    _file->SetCompressionSettings(ROOT::CompressionSettings(ROOT::kLZMA, compressionLevel));
+#if ROOT_VERSION_CODE >= ROOT_VERSION(6,12,0)
+  else if(compression == "lz4")
+    _file->SetCompressionSettings(ROOT::CompressionSettings(ROOT::kLZ4, compressionLevel));
+#endif
+  else
+    throw cms::Exception("Configuration") << "unknown or not supported compression algorithm " << compression;
   _tree = new TTree("tree", "ttbar"); // output tree
+  // clusters of autoFlush events (PostAnalyzer reads the ntuples in blocks of 10000 events, 
+  // see PostAnalyzer/eventReco.h), initial basket size (optimised by ROOT after the first cluster)
+  _tree->SetAutoFlush(iConfig.getParameter<int>("autoFlush"));
+  const int basketSize = iConfig.getParameter<int>("basketSize");
+  // output rollover (0 to disable): one output file per input file, every rolloverEvents events
+  _flagPerFile = iConfig.getParameter<int>("perFile");
+  _rolloverEvents = iConfig.getParameter<int>("rolloverEvents");
+  _neventsOutput = 0;
+  _neventsOutputProcessed = 0;
+  _neventsOutputSelected = 0;
+  _rolloverPending = false;
+  _lumiOpen = false;
+  // instrumentation: summary <output>.stat.json at the end of job, 
+  // <output>.heartbeat.json each 'heartbeat' seconds while running (0 to disable)
+  const std::string outputBase = OutputBaseName(fileout);
+  _stat = new AnalyzerStat(outputBase + ".stat.json", outputBase + ".heartbeat.json", iConfig.getParameter<double>("heartbeat"));
 
   // >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
   // >>>>>>> tree branches >>>>>>>>>>>>
@@ -271,7 +399,8 @@ Analyzer::Analyzer(const edm::ParameterSet& iConfig)
     _tree->Branch("muEta", _muEta, "muEta[Nmu]/F"); // muon pseudorapidity
     _tree->Branch("muPhi", _muPhi, "muPhi[Nmu]/F"); // muon phi
     _tree->Branch("muIso03", _muIso03, "muIso03[Nmu]/F"); // muon isolation, delta_R=0.3
-    _tree->Branch("muIso04", _muIso04, "muIso04[Nmu]/F"); // muon isolation, delta_R=0.4
+    if(!_flagSlim)
+      _tree->Branch("muIso04", _muIso04, "muIso04[Nmu]/F"); // muon isolation, delta_R=0.4
     _tree->Branch("muHitsValid", _muHitsValid, "muHitsValid[Nmu]/I"); // muon valid hits number
     _tree->Branch("muHitsPixel", _muHitsPixel, "muHitsPixel[Nmu]/I"); // muon pixel hits number
     _tree->Branch("muDistPV0", _muDistPV0, "muDistPV0[Nmu]/F"); // muon distance to the primary vertex (projection on transverse plane)
@@ -283,10 +412,13 @@ Analyzer::Analyzer(const edm::ParameterSet& iConfig)
     _tree->Branch("elEta", _elEta, "elEta[Nel]/F"); // electron pseudorapidity
     _tree->Branch("elPhi", _elPhi, "elPhi[Nel]/F"); // electron phi
     _tree->Branch("elIso03", _elIso03, "elIso03[Nel]/F"); // electron isolation, delta_R=0.3
-    _tree->Branch("elIso04", _elIso04, "elIso04[Nel]/F"); // electron isolation, delta_R=0.4
-    _tree->Branch("elConvFlag", _elConvFlag, "elConvFlag[Nel]/I"); // electron (not used) electron conversion flag
-    _tree->Branch("elConvDist", _elConvDist, "elConvDist[Nel]/F"); // electron (not used) electron conversion distance
-    _tree->Branch("elConvDcot", _elConvDcot, "elConvDcot[Nel]/F"); // electron (not used) electron conversion cotangent
+    if(!_flagSlim)
+    {
+      _tree->Branch("elIso04", _elIso04, "elIso04[Nel]/F"); // electron isolation, delta_R=0.4
+      _tree->Branch("elConvFlag", _elConvFlag, "elConvFlag[Nel]/I"); // electron (not used) electron conversion flag
+      _tree->Branch("elConvDist", _elConvDist, "elConvDist[Nel]/F"); // electron (not used) electron conversion distance
+      _tree->Branch("elConvDcot", _elConvDcot, "elConvDcot[Nel]/F"); // electron (not used) electron conversion cotangent
+    }
     _tree->Branch("elMissHits", _elMissHits, "elMissHits[Nel]/F"); // electron missing hits number 
     // jets
     _tree->Branch("Njet", &_Njet, "Njet/I"); // number of jets
@@ -297,34 +429,18 @@ Analyzer::Analyzer(const edm::ParameterSet& iConfig)
     _tree->Branch("jetMuEn", _jetMuEn, "jetMuEn[Njet]/F"); // jet muon energy
     _tree->Branch("jetElEn", _jetElEn, "jetElEn[Njet]/F"); // jet electron energy
     _tree->Branch("jetBTagDiscr", _jetBTagDiscr, "jetBTagDiscr[Njet]/F"); // jet b-tagging discriminant (Combined Secondary Vertex, CSV)
-    _tree->Branch("jetBTagMatchDiff1", _jetBTagMatchDiff1, "jetBTagMatchDiff1[Njet]/F"); // (not used, for checks) jet b-tagging: eta-phi distance to the closest matched jet
-    _tree->Branch("jetBTagMatchDiff2", _jetBTagMatchDiff2, "jetBTagMatchDiff2[Njet]/F"); // (not used, for checks) jet b-tagging: eta-phi distance to the second closest matched jet
+    if(!_flagSlim)
+    {
+      _tree->Branch("jetBTagMatchDiff1", _jetBTagMatchDiff1, "jetBTagMatchDiff1[Njet]/F"); // (not used, for checks) jet b-tagging: eta-phi distance to the closest matched jet
+      _tree->Branch("jetBTagMatchDiff2", _jetBTagMatchDiff2, "jetBTagMatchDiff2[Njet]/F"); // (not used, for checks) jet b-tagging: eta-phi distance to the second closest matched jet
+    }
     // MET
     _tree->Branch("metPx", &_metPx, "metPx/F"); // missing transverse energy x component
     _tree->Branch("metPy", &_metPy, "metPy/F"); // missing transverse energy y component
     // triggers
     _tree->Branch("Triggers", &_triggers, "Triggers/I"); // trigger bits (see trigger names below)
-    // mumu triggers
-    _vecTriggerNames.push_back("HLT_DoubleMu7");
-    _vecTriggerNames.push_back("HLT_Mu13_Mu8");
-    _vecTriggerNames.push_back("HLT_Mu17_Mu8");
-    _vecTriggerNames.push_back("HLT_DoubleMu6");
-    _vecTriggerNames.push_back("HLT_DoubleMu45");
-    _vecTriggerNames.push_back("HLT_Mu10_Ele10_CaloIdl");
-    // ee triggers
-    _vecTriggerNames.push_back("HLT_Ele17_CaloIdL_CaloIsoVL_Ele8_CaloIdL_CaloIsoVL");
-    _vecTriggerNames.push_back("HLT_Ele17_CaloIdT_TrkIdVL_CaloIsoVL_TrkIsoVL");
-    _vecTriggerNames.push_back("HLT_Ele8_CaloIdT_TrkIdVL_CaloIsoVL_TrkIsoVL");
-    _vecTriggerNames.push_back("HLT_Ele17_CaloIdT_CaloIsoVL_TrkIdVL_TrkIsoVL_");
-    _vecTriggerNames.push_back("HLT_Ele8_CaloIdT_CaloIsoVL_TrkIdVL_TrkIsoVL");
-    _vecTriggerNames.push_back("HLT_DoubleEle45_CaloIdL");
-    // emu triggers
-    _vecTriggerNames.push_back("HLT_Mu10_Ele10_CaloIdL");
-    _vecTriggerNames.push_back("HLT_Mu8_Ele17_CaloIdL");
-    _vecTriggerNames.push_back("HLT_Mu17_Ele8_CaloIdL");
-    _vecTriggerNames.push_back("HLT_Mu8_Ele17_CaloIdT_CaloIsoVL");
-    _vecTriggerNames.push_back("HLT_Mu17_Ele8_CaloIdT_CaloIsoVL");
-    _vecTriggerNames.push_back("HLT_Mu10_Ele10_CaloIdL");
+    // trigger names (bits in the same order, see AnalysisTriggers.h)
+    AnalysisTriggerNames(_vecTriggerNames);
     // primary vertex
     _tree->Branch("Npv", &_Npv, "Npv/I"); // total number of primary vertices
     _tree->Branch("pvNDOF", &_pvNDOF, "pvNDOF/I"); // number of degrees of freedom of the primary vertex
@@ -345,15 +461,22 @@ Analyzer::Analyzer(const edm::ParameterSet& iConfig)
     _tree->Branch("mcEventType", &_mcEventType, "mcEventType/I"); // MC generator level event type: 1 ttbar decay into ee, 2 ttbar decay into mumu, 3 ttbar decay into emu, 0 anything else
     _tree->Branch("mcT", _mcT, "mcT[4]/F"); // generator level top four vector
     _tree->Branch("mcTbar", _mcTbar, "mcTbar[4]/F"); // generator level antitop four vector
-    _tree->Branch("mcWp", _mcWp, "mcWp[4]/F"); // generator level W+ four vector
-    _tree->Branch("mcWm", _mcWm, "mcWm[4]/F"); // generator level W- four vector
-    _tree->Branch("mcB", _mcB, "mcB[4]/F"); // generator level top b vector
-    _tree->Branch("mcBbar", _mcBbar, "mcBbar[4]/F"); // generator level bbar four vector
-    _tree->Branch("mcLp", _mcLp, "mcLp[4]/F"); // generator level top l+ vector
-    _tree->Branch("mcNu", _mcNu, "mcNu[4]/F"); // generator level top neutrino vector
-    _tree->Branch("mcLm", _mcLm, "mcLm[4]/F"); // generator level top l- vector
-    _tree->Branch("mcNubar", _mcNubar, "mcNubar[4]/F"); // generator level top antineutrino vector
+    // (only mcEventType, mcT, mcTbar are used in PostAnalyzer)
+    if(!_flagSlim)
+    {
+      _tree->Branch("mcWp", _mcWp, "mcWp[4]/F"); // generator level W+ four vector
+      _tree->Branch("mcWm", _mcWm, "mcWm[4]/F"); // generator level W- four vector
+      _tree->Branch("mcB", _mcB, "mcB[4]/F"); // generator level top b vector
+      _tree->Branch("mcBbar", _mcBbar, "mcBbar[4]/F"); // generator level bbar four vector
+      _tree->Branch("mcLp", _mcLp, "mcLp[4]/F"); // generator level top l+ vector
+      _tree->Branch("mcNu", _mcNu, "mcNu[4]/F"); // generator level top neutrino vector
+      _tree->Branch("mcLm", _mcLm, "mcLm[4]/F"); // generator level top l- vector
+      _tree->Branch("mcNubar", _mcNubar, "mcNubar[4]/F"); // generator level top antineutrino vector
+    }
   }
+
+  // basket size for all branches
+  _tree->SetBasketSize("*", basketSize);
 }
 
 
@@ -361,9 +484,19 @@ Analyzer::Analyzer(const edm::ParameterSet& iConfig)
 Analyzer::~Analyzer()
 {
    // close files, deallocate resources etc.
+  std::string outputName = _file->GetName();
   _file->cd();
   _tree->Write();
   _file->Close();
+  // luminosity section not finished: job was aborted, the output file is incomplete
+  // (at least its last luminosity section), remove it and do not write the record
+  if(_lumiOpen)
+  {
+    printf("Warning: job aborted, incomplete output file %s removed\n", outputName.c_str());
+    remove(outputName.c_str());
+  }
+  else
+    WriteOutputRecord(outputName);
 
   if(_flagGEN)
   {
@@ -376,8 +509,12 @@ Analyzer::~Analyzer()
     printf("%25s = %10d(%5.2f%%)\n", "_mcNTtbarDileptonEMu", _mcNTtbarDileptonEMu, 100. * _mcNTtbarDileptonEMu / _mcNTTbar);
   }
 
-  // print total number of processed and selected events
-  printf("Processed %d events, selected %d\n", _nevents, _neventsSelected);
+  // print total number of processed (including those rejected by SkimFilter) and selected events
+  if(_skimLabel != "")
+    printf("Processed %d events (%d rejected by SkimFilter), selected %d\n", _nevents + _neventsSkimRejected, _neventsSkimRejected, _neventsSelected);
+  else
+    printf("Processed %d events, selected %d\n", _nevents, _neventsSelected);
+  delete _stat;
 }
 
 
@@ -522,38 +659,131 @@ int Analyzer::SelectEl(const edm::Handle<reco::GsfElectronCollection>& electrons
   return 0;
 }
 
-// jet matching (for b-tagging)
-reco::PFJetCollection::const_iterator Analyzer::MatchJet(const edm::Handle<reco::PFJetCollection>& jets, const edm::RefToBase<reco::Jet>& jettag, double& diff, double& nextdiff)
+// eta-phi grid for jet matching: cell size 0.5 in eta (|eta| < 5, jets beyond are 
+// put in the edge cells) and 2pi/12 in phi (_gridCellSize is the smaller of the two); 
+// routines return cell index in eta, phi
+const double _gridCellEta = 0.5;
+const double _gridCellSize = 0.5;
+inline int GridEta(const double eta, const int nEta)
+{
+  int i = (int)floor(eta / _gridCellEta) + nEta / 2;
+  return (i < 0) ? 0 : ((i >= nEta) ? (nEta - 1) : i);
+}
+inline int GridPhi(const double phi, const int nPhi)
+{
+  int i = (int)floor((phi + TMath::Pi()) / TMath::TwoPi() * nPhi);
+  return ((i % nPhi) + nPhi) % nPhi;
+}
+// squared eta-phi distance (with proper phi wraparound)
+inline double DistEtaPhi2(const double eta1, const double phi1, const double eta2, const double phi2)
+{
+  double dphi = TMath::Abs(phi1 - phi2);
+  if(dphi > TMath::Pi())
+    dphi = TMath::TwoPi() - dphi;
+  return (eta1 - eta2) * (eta1 - eta2) + dphi * dphi;
+}
+
+// check one jet j for matching (for MatchJet()): 
+// update the closest (diff, best) and second closest (nextdiff) distances
+inline void CheckMatchJet(const reco::PFJet& jet, const int j, const double tagEta, const double tagPhi, 
+  double& diff, double& nextdiff, int& best)
+{
+  // calculate eta-phi difference to the current jet
+  double ldiff = DistEtaPhi2(jet.eta(), jet.phi(), tagEta, tagPhi);
+  if(ldiff < nextdiff && ldiff > diff)
+    nextdiff = ldiff;
+  // skip this jet, if the difference is larger than the minimum difference found already
+  if(ldiff > diff)
+    return;
+  // if this jet is not skipped, update needed variables with the current eta-phi difference
+  nextdiff = diff;
+  diff = ldiff;
+  best = j;
+}
+
+// fill eta-phi grid of jets (for MatchJet())
+void Analyzer::FillJetGrid(const edm::Handle<reco::PFJetCollection>& jets)
 {
+  const int nJets = jets->size();
+  _vecGridFirst.assign(_gridNEta * _gridNPhi + 1, 0);
+  _vecGridJets.resize(nJets);
+  _vecGridCell.resize(nJets);
+  // count jets in each cell, then sort jet indices by cell
+  for(int j = 0; j < nJets; j++)
+  {
+    const reco::PFJet& jet = (*jets)[j];
+    _vecGridCell[j] = GridEta(jet.eta(), _gridNEta) * _gridNPhi + GridPhi(jet.phi(), _gridNPhi);
+    _vecGridFirst[_vecGridCell[j]]++;
+  }
+  // (after this loop _vecGridFirst[c] is the end of cell c)
+  for(unsigned int c = 1; c < _vecGridFirst.size(); c++)
+    _vecGridFirst[c] += _vecGridFirst[c - 1];
+  // (after this loop _vecGridFirst[c] is the first index of cell c)
+  for(int j = nJets - 1; j >= 0; j--)
+    _vecGridJets[--_vecGridFirst[_vecGridCell[j]]] = j;
+  _gridFilled = true;
+}
+
+// jet matching (for b-tagging): returns index of the matched jet in the collection (-1 if none)
+// If the b-tag refers to this jet collection, the jet is known (diff = 0, nextdiff = -1 is not calculated).
+// Otherwise the closest jet in eta-phi is taken (diff and nextdiff are the squared eta-phi 
+// distances to the closest and second closest jets): the jets are searched in the neighbouring 
+// cells of the eta-phi grid, all jets are searched only if less than two jets are found 
+// closer than the cell size.
+int Analyzer::MatchJet(const edm::Handle<reco::PFJetCollection>& jets, const edm::RefToBase<reco::Jet>& jettag, double& diff, double& nextdiff)
+{
+  // b-tag refers to the jet collection: take the jet directly
+  if(jettag.id() == jets.id())
+  {
+    diff = 0.0;
+    nextdiff = -1.0;
+    return jettag.key();
+  }
+  if(!_gridFilled)
+    FillJetGrid(jets);
+  const double tagEta = jettag->eta();
+  const double tagPhi = jettag->phi();
   // initialise eta-phi difference with very large initial value
   diff = nextdiff = 1000.0;
-  // iterator to the best matched jet
-  reco::PFJetCollection::const_iterator bestit = jets->begin();
-  // loop over jet collection
-  for(reco::PFJetCollection::const_iterator it = jets->begin(); it != jets->end(); it++)
+  // index of the best matched jet
+  int best = -1;
+  // loop over jets in the neighbouring cells
+  const int cellEta = GridEta(tagEta, _gridNEta);
+  const int cellPhi = GridPhi(tagPhi, _gridNPhi);
+  for(int ieta = TMath::Max(cellEta - 1, 0); ieta <= TMath::Min(cellEta + 1, _gridNEta - 1); ieta++)
   {
-    // calculate et-phi difference to the current jet
-    double ldiff = TMath::Power(it->eta() - jettag->eta(), 2.0) + TMath::Power(it->phi() - jettag->phi(), 2.0);
-    if(ldiff < nextdiff && ldiff > diff)
-      nextdiff = ldiff;
-    // skip this jet, if the difference is larger than the minimum difference found already
-    if(ldiff > diff)
-      continue;
-    // if this jet is not skipped, update needed variables with the current eta-phi difference
-    nextdiff = diff;
-    diff = ldiff;
-    bestit = it;
+    for(int dphi = -1; dphi <= 1; dphi++)
+    {
+      int c = ieta * _gridNPhi + (cellPhi + dphi + _gridNPhi) % _gridNPhi;
+      for(int k = _vecGridFirst[c]; k < _vecGridFirst[c + 1]; k++)
+        CheckMatchJet((*jets)[_vecGridJets[k]], _vecGridJets[k], tagEta, tagPhi, diff, nextdiff, best);
+    }
   }
-  // return iterator to the bset matched jet
-  return bestit;
+  // jets in other cells are farther than the cell size: 
+  // if the two closest jets are not found yet, loop over all jets
+  if(nextdiff > _gridCellSize * _gridCellSize)
+  {
+    diff = nextdiff = 1000.0;
+    best = -1;
+    for(unsigned int j = 0; j < jets->size(); j++)
+      CheckMatchJet((*jets)[j], j, tagEta, tagPhi, diff, nextdiff, best);
+  }
+  // return index of the best matched jet
+  return best;
 }
 
 // jet selection
 int Analyzer::SelectJet(const edm::Handle<reco::PFJetCollection>& jets, const reco::JetTagCollection& bTags, const edm::Event& iEvent, const edm::EventSetup& iSetup)
 {
   _Njet = 0;
-  // Loop over jets and study b-tagging info
-  std::vector<std::pair<reco::PFJetCollection::const_iterator, std::vector<double> > > vItBTagMatched;
+  // Loop over b-tags and match them to jets: b-tagging info is stored by jet index 
+  // (if several b-tags are matched to the same jet, the first one is taken)
+  double t = StatWallTime();
+  const int nJets = jets->size();
+  _vecJetBTagDiscr.assign(nJets, -1.0);
+  _vecJetBTagDiff1.assign(nJets, -1.0);
+  _vecJetBTagDiff2.assign(nJets, -1.0);
+  _gridFilled = false;
   for (unsigned int i = 0; i != bTags.size(); ++i) 
   {
     // b-tagging discriminator
@@ -561,18 +791,20 @@ int Analyzer::SelectJet(const edm::Handle<reco::PFJetCollection>& jets, const re
     if(discriminator < 0.2)
       continue;
     // these are variables for debugging purpose: study eta-phi difference when matching jets
-    std::vector<double> btag(3);
-    btag[1] = btag[2] = -1.0;
-    reco::PFJetCollection::const_iterator itBTagMatched = MatchJet(jets, bTags[i].first, btag[1], btag[2]);
-    //printf("%.3f  %.3f\n", btag[1], btag[2]);
-    btag[0] = discriminator;
-    vItBTagMatched.push_back(std::pair<reco::PFJetCollection::const_iterator, std::vector<double> >(itBTagMatched, btag));
+    double diff1 = -1.0;
+    double diff2 = -1.0;
+    int j = MatchJet(jets, bTags[i].first, diff1, diff2);
+    //printf("%.3f  %.3f\n", diff1, diff2);
+    if(j < 0 || _vecJetBTagDiscr[j] >= 0.0)
+      continue;
+    _vecJetBTagDiscr[j] = discriminator;
+    _vecJetBTagDiff1[j] = diff1;
+    _vecJetBTagDiff2[j] = diff2;
   }
+  _stat->StageDone(AnalyzerStat::kBTag, t);
   
-  // Load jet energy correction service
-  const JetCorrector* corrector = JetCorrector::getJetCorrector(mJetCorr, iSetup);
-
   // Loop over needed jets
+  // (jet energy corrector is retrieved in beginRun())
   int status = 1;
   for (reco::PFJetCollection::const_iterator it = jets->begin(); it != jets->end(); it++)
   {
@@ -581,38 +813,60 @@ int Analyzer::SelectJet(const edm::Handle<reco::PFJetCollection>& jets, const re
       printf("Maximum number of jets %d reached, skipping the rest\n", _maxNjet);
       return 0;
     }
-    // Apply jet energy correction (JEC)
-    double jec = corrector->correction(*it, iEvent, iSetup);
-    // copy original (uncorrected) jet;
-    reco::PFJet corjet = *it;
-    // apply JEC
-    corjet.scaleEnergy(jec);
-    // select jet: pT > 30 GeV, |eta| < 2.4
-    if(corjet.pt() < 30)
-      continue;
-    if(TMath::Abs(corjet.eta()) > 2.4)
+    // select jet: |eta| < 2.4 (not changed by JEC)
+    if(TMath::Abs(it->eta()) > 2.4)
       continue;
-    // fill jet four momentum (pT, eta, phi, mass)
-    _jetPt[_Njet] = corjet.pt();
-    _jetEta[_Njet] = corjet.eta();
-    _jetPhi[_Njet] = corjet.phi();
-    _jetMass[_Njet] = corjet.mass();
-    // fill jet muon and electron energy fractions
-    _jetMuEn[_Njet] = corjet.muonEnergy();
-    _jetElEn[_Njet] = corjet.electronEnergy();
-    // find and fill b-tagging info
-    _jetBTagDiscr[_Njet] = _jetBTagMatchDiff1[_Njet] = _jetBTagMatchDiff2[_Njet] = -1.0;
-    for(std::vector<std::pair<reco::PFJetCollection::const_iterator, std::vector<double> > >::const_iterator ittag = vItBTagMatched.begin(); ittag != vItBTagMatched.end(); ittag++)
+    // reject jets which cannot pass pT > 30 GeV after JEC (most of jets are soft), 
+    // so that JEC is evaluated only for the remaining jets
+    if(it->pt() * _jetMaxJEC < 30)
     {
-      if(it == ittag->first)
+      // validation: would the jet pass pT > 30 GeV after JEC?
+      if(_flagValidateJEC)
       {
-        status = 0;
-        _jetBTagDiscr[_Njet] = (ittag->second)[0];
-        _jetBTagMatchDiff1[_Njet] = (ittag->second)[1];
-        _jetBTagMatchDiff2[_Njet] = (ittag->second)[2];
-        break;
+        double jec = _jetCorrector->correction(*it, iEvent, iSetup);
+        _nJetsValidateJEC++;
+        _maxJEC = TMath::Max(_maxJEC, jec);
+        if(jec * it->pt() >= 30)
+        {
+          _nJetsLostJEC++;
+          printf("Warning: jet with raw pT = %.3f, eta = %.3f rejected before JEC = %.3f (assumed maximum %.3f)\n", it->pt(), it->eta(), jec, _jetMaxJEC);
+        }
       }
+      continue;
     }
+    // Apply jet energy correction (JEC): 
+    // it scales the jet four momentum, i.e. pT and mass, eta and phi are not changed
+    // (no need to copy the jet and call reco::PFJet::scaleEnergy())
+    double jec = _jetCorrector->correction(*it, iEvent, iSetup);
+    // (this check sees only jets which passed the cut above, for the rejected 
+    // jets use validateJEC = 1)
+    if(jec > _jetMaxJEC)
+      printf("Warning: JEC = %.3f exceeds assumed maximum %.3f\n", jec, _jetMaxJEC);
+    if(_flagValidateJEC)
+    {
+      _nJetsValidateJEC++;
+      _maxJEC = TMath::Max(_maxJEC, jec);
+    }
+    // select jet: pT > 30 GeV
+    double corPt = jec * it->pt();
+    if(corPt < 30)
+      continue;
+    // fill jet four momentum (pT, eta, phi, mass)
+    _jetPt[_Njet] = corPt;
+    _jetEta[_Njet] = it->eta();
+    _jetPhi[_Njet] = it->phi();
+    _jetMass[_Njet] = jec * it->mass();
+    // fill jet muon and electron energy fractions
+    // (not scaled by JEC, as with reco::PFJet::scaleEnergy())
+    _jetMuEn[_Njet] = it->muonEnergy();
+    _jetElEn[_Njet] = it->electronEnergy();
+    // fill b-tagging info (-1 if no b-tag matched)
+    const int j = it - jets->begin();
+    _jetBTagDiscr[_Njet] = _vecJetBTagDiscr[j];
+    _jetBTagMatchDiff1[_Njet] = _vecJetBTagDiff1[j];
+    _jetBTagMatchDiff2[_Njet] = _vecJetBTagDiff2[j];
+    if(_vecJetBTagDiscr[j] >= 0.0)
+      status = 0;
     _Njet++;
   }
   // if there are less then two jets selected, thiscan be skipped (return status 1)
@@ -621,40 +875,35 @@ int Analyzer::SelectJet(const edm::Handle<reco::PFJetCollection>& jets, const re
   return status;
 }
 
-// returns vector of integers which are trigger bits needed in the analysis
-// (called in the beginning of each run)
+// find trigger path indices and corresponding bits needed in the analysis
+// (called in the beginning of each run with new HLT menu; the result is cached 
+// for each menu, so the trigger names are matched only once per menu)
 void Analyzer::FindTriggerBits(const HLTConfigProvider& trigConf)
 {
-  // reset containers
-  _vecTriggerBits.clear();
-  _vecTriggerBits.resize(_vecTriggerNames.size());
-  std::vector<std::string> trigNames;
-  trigNames = trigConf.triggerNames();
-  // for interesting trigger names find corresponding trigger bits
-  for(unsigned int i = 0; i < trigNames.size(); i++)
+  const edm::ParameterSetID menuID = trigConf.processPSet().id();
+  std::map<edm::ParameterSetID, std::vector<std::pair<unsigned int, int> > >::const_iterator it = _mapTriggerPathBits.find(menuID);
+  if(it != _mapTriggerPathBits.end())
   {
-    std::string currentName = trigConf.triggerNames()[i];
-    //printf("%5d  %s\n", i, currentName.c_str());
-    for(unsigned int n = 0; n < _vecTriggerNames.size(); n++)
-    {
-      if(currentName.find(_vecTriggerNames[n]) != std::string::npos)
-      {
-        _vecTriggerBits[n].push_back(i);
-      }
-    }
+    _vecTriggerPathBits = it->second;
+    return;
   }
+  // for interesting trigger names find corresponding trigger paths (see AnalysisTriggers.h)
+  FindAnalysisTriggerPaths(trigConf.triggerNames(), _vecTriggerNames, _vecTriggerPathBits);
+  _mapTriggerPathBits[menuID] = _vecTriggerPathBits;
+  PrintTriggerBits(trigConf);
 }
 
-// print found trigger indices
-// (for debugging purpose)
-void Analyzer::PrintTriggerBits()
+// print trigger paths matched for each bit in the HLT menu
+// (printed once per menu, see FindTriggerBits)
+void Analyzer::PrintTriggerBits(const HLTConfigProvider& trigConf)
 {
-  printf("********* Trigger Bits: **********\n");
+  printf("********* Trigger Bits (%s): **********\n", trigConf.tableName().c_str());
   for(unsigned int n = 0; n < _vecTriggerNames.size(); n++)
   {
-    printf("%s: ", _vecTriggerNames[n].c_str());
-    for(unsigned int i = 0; i < _vecTriggerBits[n].size(); i++)
-      printf(" %d ", _vecTriggerBits[n][i]);
+    printf("%2d %s:", n, _vecTriggerNames[n].c_str());
+    for(unsigned int i = 0; i < _vecTriggerPathBits.size(); i++)
+      if(_vecTriggerPathBits[i].second == (int)n)
+        printf(" %s", trigConf.triggerName(_vecTriggerPathBits[i].first).c_str());
     printf("\n");
   }
 }
@@ -662,18 +911,11 @@ void Analyzer::PrintTriggerBits()
 // fill trigger bits
 void Analyzer::SelectTriggerBits(const edm::Handle<edm::TriggerResults>& HLTR)
 {
-  for(unsigned int i = 0; i < _vecTriggerBits.size(); i++)
-  {
-    int status = 0;
-    for(unsigned int j = 0; j < _vecTriggerBits[i].size(); j++)
-    {
-      status = status || HLTR->accept(_vecTriggerBits[i][j]);
-    }
-    //printf("TRIGGER:  %d %s\n", status, _vecTriggerNames[i].c_str());
-    // set ith bit of _triggers integer to the current trigger bit status
-    _triggers ^= (-status ^ _triggers) & (1 << i);
-  }
-  //printf("*************\n");
+  // set the bit of _triggers integer for each fired trigger path
+  _triggers = 0;
+  for(unsigned int i = 0; i < _vecTriggerPathBits.size(); i++)
+    if(HLTR->accept(_vecTriggerPathBits[i].first))
+      _triggers |= (1 << _vecTriggerPathBits[i].second);
 }
 
 // select primary vertex
@@ -698,6 +940,15 @@ int Analyzer::SelectPrimaryVertex(const edm::Handle<reco::VertexCollection>& pri
 // get final-state stable generator level particle with required id
 // (if not found, return NULL pointer)
 const reco::Candidate* Analyzer::GetFinalState(const reco::Candidate* particle, const int id)
+{
+  // decay chains are not trees (after showering, particles can have several mothers), 
+  // so particles already searched without result are remembered not to search them again
+  _nGenSearched = 0;
+  return FindFinalState(particle, id);
+}
+
+// recursive search for GetFinalState()
+const reco::Candidate* Analyzer::FindFinalState(const reco::Candidate* particle, const int id)
 {
   // loop over daughters
   for(unsigned int i = 0; i < particle->numberOfDaughters(); i++)
@@ -706,11 +957,20 @@ const reco::Candidate* Analyzer::GetFinalState(const reco::Candidate* particle,
     // if this daughter has required id, return its pointer
     if(daughter->pdgId() == id && daughter->status() == 1)
       return daughter;
+    // skip daughters already searched
+    bool searched = false;
+    for(int s = 0; s < _nGenSearched && !searched; s++)
+      searched = (_genSearched[s] == daughter);
+    if(searched)
+      continue;
     // otherwise call itself recursively
-    const reco::Candidate* result = GetFinalState(daughter, id);
+    const reco::Candidate* result = FindFinalState(daughter, id);
     // return the result of the recursive call
     if(result)
       return result;
+    // nothing found: remember this daughter (if there is space left in the table)
+    if(_nGenSearched < _maxGenSearched)
+      _genSearched[_nGenSearched++] = daughter;
   }
   // if gets here, there are no daughter with required id: return NULL pointer
   return NULL;
@@ -748,7 +1008,8 @@ void Analyzer::SelectMCGen(const edm::Handle<reco::GenParticleCollection>& genPa
   const reco::Candidate* genLm = NULL;
   const reco::Candidate* genNubar = NULL;
   // loop over generated particeles
-  for(unsigned int p = 0; p < genParticles->size(); p++)
+  // (hard-scattering particles are at the beginning of the collection: stop when both top and antitop are found)
+  for(unsigned int p = 0; p < genParticles->size() && !(genT && genTbar); p++)
   {
     const reco::Candidate* particle = &genParticles->at(p);
     const bool sign = (particle->pdgId() > 0); // true for top, false for antitop
@@ -837,17 +1098,20 @@ void Analyzer::SelectMCGen(const edm::Handle<reco::GenParticleCollection>& genPa
     }
   }
 
-  // fill branch variables
+  // fill branch variables (only mcT, mcTbar are stored with slim flag)
   FillFourMomentum(genT, _mcT);
   FillFourMomentum(genTbar, _mcTbar);
-  FillFourMomentum(genB, _mcB);
-  FillFourMomentum(genBbar, _mcBbar);
-  FillFourMomentum(genWp, _mcWp);
-  FillFourMomentum(genWm, _mcWm);
-  FillFourMomentum(genLp, _mcLp);
-  FillFourMomentum(genNu, _mcNu);
-  FillFourMomentum(genLm, _mcLm);
-  FillFourMomentum(genNubar, _mcNubar);
+  if(!_flagSlim)
+  {
+    FillFourMomentum(genB, _mcB);
+    FillFourMomentum(genBbar, _mcBbar);
+    FillFourMomentum(genWp, _mcWp);
+    FillFourMomentum(genWm, _mcWm);
+    FillFourMomentum(genLp, _mcLp);
+    FillFourMomentum(genNu, _mcNu);
+    FillFourMomentum(genLm, _mcLm);
+    FillFourMomentum(genNubar, _mcNubar);
+  }
   
   // now classify this generated event
   _mcEventType = 0;
@@ -895,6 +1159,9 @@ void Analyzer::analyze(const edm::Event& iEvent, const edm::EventSetup& iSetup)
 
   // event counting, printout after each 1K processed events
   _nevents++;
+  _neventsLumi++;
+  _neventsOutput++;
+  _neventsOutputProcessed++;
   //printf("*** EVENT %6d ***\n", _nevents);
   if( (_nevents % 1000) == 0)
   {
@@ -934,14 +1201,20 @@ void Analyzer::analyze(const edm::Event& iEvent, const edm::EventSetup& iSetup)
   //
   // initialise event variables with default values
   InitBranchVars();
+  // time of each stage (see AnalyzerStat.h)
+  double t = _stat->BeginEvent();
   // process generator level, if needed
   bool selGEN = false;
   if(_flagGEN)
   {
     iEvent.getByLabel(_inputTagMCgen, genParticles);
     SelectMCGen(genParticles);
+    t = _stat->StageDone(AnalyzerStat::kGen, t);
     if(_mcEventType != 0)
+    {
       selGEN = true;
+      _stat->Pass(AnalyzerStat::kCutGen);
+    }
     // if nothing interesting at generator level and not required to process reco level, return here
     if(!selGEN && !_flagRECO)
       return;
@@ -950,27 +1223,38 @@ void Analyzer::analyze(const edm::Event& iEvent, const edm::EventSetup& iSetup)
   bool selRECO = false;
   if(_flagRECO)
   {
-    // primary vertex
+    // primary vertex (needed for lepton selection, its variables are filled here
+    // as well, so that the time of the vertex stage is recorded once per event)
     iEvent.getByLabel(_inputTagPrimaryVertex, primVertex);
     reco::VertexCollection::const_iterator pv = primVertex->begin();
+    SelectPrimaryVertex(primVertex);
+    t = _stat->StageDone(AnalyzerStat::kPV, t);
     // electrons
     _signLeptonP = _signLeptonM = 0;
     iEvent.getByLabel(_inputTagElectrons, electrons);
     SelectEl(electrons, pv);
+    t = _stat->StageDone(AnalyzerStat::kElectrons, t);
     // muons
     iEvent.getByLabel(_inputTagMuons, muons);
     SelectMu(muons, pv);
+    t = _stat->StageDone(AnalyzerStat::kMuons, t);
     // require pair of opposite signed leptons
     if( _signLeptonP && _signLeptonM )
+    {
       selRECO = true;
+      _stat->Pass(AnalyzerStat::kCutLeptons);
+    }
     if(!selRECO && !selGEN)
       return;
-    // jets and b-tagging
+    // jets and b-tagging (b-tag matching time is counted separately)
     iEvent.getByLabel(_inputTagJets, jets);
     iEvent.getByLabel(_inputTagBtags, bTagHandle);
     const reco::JetTagCollection& bTags = *(bTagHandle.product());
     SelectJet(jets, bTags, iEvent, iSetup);
+    t = _stat->StageDone(AnalyzerStat::kJets, t, AnalyzerStat::kBTag);
     // require two jets
+    if(selRECO && _Njet >= 2)
+      _stat->Pass(AnalyzerStat::kCutJets);
     if( _Njet >= 2)
       selRECO = true;
     // if nothing interesting at both generator and reco levels, return here
@@ -979,28 +1263,135 @@ void Analyzer::analyze(const edm::Event& iEvent, const edm::EventSetup& iSetup)
     // fill MET
     iEvent.getByLabel(_inputTagMet, pfmets);
     SelectMET(pfmets);
-    // fill primary vertex
-    SelectPrimaryVertex(primVertex);
+    t = _stat->StageDone(AnalyzerStat::kMET, t);
     // fill triggers
     iEvent.getByLabel(_inputTagTriggerResults, HLTR);
     SelectTriggerBits(HLTR);
+    t = _stat->StageDone(AnalyzerStat::kTriggers, t);
   }
   // fill event info
   SelectEvent(iEvent);
   // all done: store event
   _tree->Fill();
   _neventsSelected++;
+  _neventsOutputSelected++;
+  _stat->Pass(AnalyzerStat::kCutStored);
 }
 
 
+// Close the current output file and continue with the new one
+// (TTree::ChangeFile() writes the tree, closes the file and opens <name>_<N>.root 
+// with the same compression settings), then write the record for the closed file.
+void Analyzer::RolloverOutput()
+{
+  std::string outputName = _file->GetName();
+  _file = _tree->ChangeFile(_file);
+  WriteOutputRecord(outputName);
+  _neventsOutput = 0;
+  _rolloverPending = false;
+}
+
+// Write the record for the closed output file <name>.root to <name>.lumis.txt: 
+// input files closed ('file <name>') and luminosity sections ended ('lumi <run> <lumi>') 
+// while this output file was open, in the order they happened (luminosity sections 
+// listed after the last closed input file were ended while the next input file was 
+// open, see runWorker.sh), then the numbers of processed (including those rejected 
+// by SkimFilter) and stored events ('events <processed> <stored>', summed over
+// complete output files by processed.sh). The record is written (renamed from a temporary 
+// file) after the output file is closed, i.e. it exists only for complete output files. 
+// Output is switched only at the end of luminosity sections, so all listed 
+// luminosity sections are completely contained in output files written so far, 
+// and can be skipped if an aborted job is rerun (see 'lumisToSkip' in analyzer_cfg.py).
+void Analyzer::WriteOutputRecord(const std::string& outputName)
+{
+  std::string recordName = OutputBaseName(outputName) + ".lumis.txt";
+  std::string tmpName = recordName + ".tmp";
+  FILE* f = fopen(tmpName.c_str(), "w");
+  if(!f)
+  {
+    printf("Error: cannot write output record %s\n", tmpName.c_str());
+    exit(1);
+  }
+  for(unsigned int i = 0; i < _vecOutputRecord.size(); i++)
+    fprintf(f, "%s\n", _vecOutputRecord[i].c_str());
+  fprintf(f, "events %d %d\n", _neventsOutputProcessed, _neventsOutputSelected);
+  fclose(f);
+  rename(tmpName.c_str(), recordName.c_str());
+  _vecOutputRecord.clear();
+  _neventsOutputProcessed = 0;
+  _neventsOutputSelected = 0;
+}
+
 // ------------ method called when starting to processes a run  ------------
 void Analyzer::beginRun(edm::Run const& iRun, edm::EventSetup const& iSetup)
 {
-  // trigger stuff
-  HLTConfigProvider triggerConfig;
+  // trigger stuff (trigger bits are updated only if the HLT menu changed)
   bool changed = true;
-  triggerConfig.init(iRun, iSetup, _inputTagTriggerResults.process(), changed);
-  FindTriggerBits(triggerConfig);
+  _triggerConfig.init(iRun, iSetup, _inputTagTriggerResults.process(), changed);
+  if(changed)
+    FindTriggerBits(_triggerConfig);
+  // jet energy corrector (the same for all events in the run)
+  if(_flagRECO)
+    _jetCorrector = JetCorrector::getJetCorrector(mJetCorr, iSetup);
+}
+
+// ------------ method called when starting to processes a luminosity block  ------------
+void Analyzer::beginLuminosityBlock(edm::LuminosityBlock const&, edm::EventSetup const&)
+{
+  _lumiOpen = true;
+  _neventsLumi = 0;
+}
+
+// ------------ method called when ending the processing of a luminosity block  ------------
+void Analyzer::endLuminosityBlock(edm::LuminosityBlock const& iLumi, edm::EventSetup const&)
+{
+  _lumiOpen = false;
+  // events of this luminosity section rejected by SkimFilter
+  if(_skimLabel != "")
+  {
+    edm::Handle<edm::MergeableCounter> nEvents;
+    iLumi.getByLabel(edm::InputTag(_skimLabel, "nEvents"), nEvents);
+    const int rejected = nEvents->value - _neventsLumi;
+    _neventsSkimRejected += rejected;
+    _neventsOutputProcessed += rejected;
+    _stat->Rejected(rejected);
+  }
+  char line[64];
+  snprintf(line, sizeof(line), "lumi %d %d", iLumi.run(), iLumi.luminosityBlock());
+  _vecOutputRecord.push_back(line);
+  // switch output file if requested (all events of this luminosity section are in the current one)
+  if(_rolloverEvents > 0 && _neventsOutput >= _rolloverEvents)
+    _rolloverPending = true;
+  if(_rolloverPending)
+    RolloverOutput();
+}
+
+// ------------ method called when an input file is opened  ------------
+void Analyzer::respondToOpenInputFile(edm::FileBlock const& fb)
+{
+  _stat->OpenInputFile(fb.fileName());
+}
+
+// ------------ method called when an input file is closed  ------------
+void Analyzer::respondToCloseInputFile(edm::FileBlock const& fb)
+{
+  _stat->CloseInputFile();
+  _vecOutputRecord.push_back("file " + fb.fileName());
+  // switch output file at the end of the current luminosity section
+  // (the next input file might continue it)
+  if(_flagPerFile)
+    _rolloverPending = true;
+}
+
+// ------------ method called once each job just after ending the event loop  ------------
+void Analyzer::endJob()
+{
+  // validation of the bound of JEC (see SelectJet())
+  if(_flagValidateJEC)
+    printf("JEC validation: %ld jets evaluated, maximum JEC = %.3f (assumed %.3f), %ld jets lost by the cut before JEC\n", 
+      _nJetsValidateJEC, _maxJEC, _jetMaxJEC, _nJetsLostJEC);
+  // instrumentation summary (histograms to the last output file)
+  _stat->WriteSummary(_file);
 }
 
 // below is some default stuff, was not modified
@@ -1008,18 +1399,9 @@ void Analyzer::beginRun(edm::Run const& iRun, edm::EventSetup const& iSetup)
 // ------------ method called once each job just before starting event loop  ------------
 void Analyzer::beginJob() {;}
 
-// ------------ method called once each job just after ending the event loop  ------------
-void Analyzer::endJob() {;}
-
 // ------------ method called when ending the processing of a run  ------------
 void Analyzer::endRun(edm::Run const& run, edm::EventSetup const& setup) {;}
 
-// ------------ method called when starting to processes a luminosity block  ------------
-void Analyzer::beginLuminosityBlock(edm::LuminosityBlock const&, edm::EventSetup const&) {;}
-
-// ------------ method called when ending the processing of a luminosity block  ------------
-void Analyzer::endLuminosityBlock(edm::LuminosityBlock const&, edm::EventSetup const&) {;}
-
 // ------------ method fills 'descriptions' with the allowed parameters for the module  ------------
 void Analyzer::fillDescriptions(edm::ConfigurationDescriptions& descriptions)
 {
@@ -0,0 +1,267 @@
+// -*- C++ -*-
+//
+// Package:    Analyzer
+//
+// Instrumentation of Analyzer: wall time of processing stages (cumulative
+// and per event histograms), processing rate, bytes read per input file and
+// selection cut-flow (events rejected by SkimFilter before Analyzer are counted
+// as processed, but did not pass the 'skim' step). The summary is written at the end of the job to JSON file
+// (and histograms to ROOT file), the same JSON (with "status": "running") is
+// written periodically as heartbeat file while the job is running
+// (see running.sh and processed.sh).
+// JSON files have one top level key per line, so that they can be read
+// also with grep (arrays and objects are written one element per line).
+//
+
+#ifndef ANALYZER_ANALYZERSTAT_H
+#define ANALYZER_ANALYZERSTAT_H
+
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <cmath>
+#include <sys/time.h>
+
+// ROOT
+#include <TH1D.h>
+#include <TDirectory.h>
+#include <TFile.h>
+
+// wall clock time in seconds
+inline double StatWallTime()
+{
+  timeval tv;
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec + 1e-6 * tv.tv_usec;
+}
+
+class AnalyzerStat
+{
+  public:
+    // processing stages (kBTag is b-tag matching, it is done within kJets,
+    // but its time is not included there)
+    enum Stage { kGen, kElectrons, kMuons, kJets, kBTag, kMET, kPV, kTriggers, kNStages };
+    // selection cut-flow steps
+    enum Cut { kCutAll, kCutSkim, kCutGen, kCutLeptons, kCutJets, kCutStored, kNCuts };
+
+    // summary and heartbeat file names (empty: not written), heartbeat period (seconds)
+    AnalyzerStat(const std::string& summaryName, const std::string& heartbeatName, const double heartbeatPeriod):
+      _summaryName(summaryName), _heartbeatName(heartbeatName), _heartbeatPeriod(heartbeatPeriod)
+    {
+      const char* stageNames[kNStages] = { "gen", "electrons", "muons", "jets", "btag", "met", "pv", "triggers" };
+      const char* cutNames[kNCuts] = { "all", "skim", "gen", "leptons", "jets", "stored" };
+      for(int s = 0; s < kNStages; s++)
+      {
+        _stageNames[s] = stageNames[s];
+        _stageCalls[s] = 0;
+        _stageTime[s] = 0.0;
+        _eventTime[s] = -1.0;
+        // per event time, log10(t / microseconds)
+        _hStageTime[s] = new TH1D(("time_" + _stageNames[s]).c_str(), (_stageNames[s] + ";log_{10}(t / #mus);events").c_str(), 70, -1.0, 6.0);
+        _hStageTime[s]->SetDirectory(0);
+      }
+      for(int c = 0; c < kNCuts; c++)
+      {
+        _cutNames[c] = cutNames[c];
+        _cutFlow[c] = 0;
+      }
+      _events = 0;
+      _startTime = StatWallTime();
+      _lastHeartbeat = _startTime;
+      _lastHeartbeatEvents = 0;
+    }
+
+    ~AnalyzerStat()
+    {
+      for(int s = 0; s < kNStages; s++)
+        delete _hStageTime[s];
+    }
+
+    // call at the beginning of each event, returns current time (start of the first stage)
+    double BeginEvent()
+    {
+      FillEventTime();
+      _events++;
+      _cutFlow[kCutAll]++;
+      _cutFlow[kCutSkim]++;
+      double now = StatWallTime();
+      if(_heartbeatPeriod > 0.0 && now - _lastHeartbeat > _heartbeatPeriod)
+      {
+        WriteJSON(_heartbeatName, "running", now);
+        _lastHeartbeat = now;
+        _lastHeartbeatEvents = _events;
+      }
+      return now;
+    }
+
+    // add time since t to the stage (excluding the time of the nested stage in this event, if given),
+    // returns current time (start of the next stage)
+    double StageDone(const Stage s, const double t, const int nested = -1)
+    {
+      double now = StatWallTime();
+      double dt = now - t;
+      if(nested >= 0 && _eventTime[nested] > 0.0)
+        dt -= _eventTime[nested];
+      _stageCalls[s]++;
+      _stageTime[s] += dt;
+      _eventTime[s] = (_eventTime[s] < 0.0) ? dt : (_eventTime[s] + dt);
+      return now;
+    }
+
+    // count events rejected before Analyzer (by SkimFilter) as processed
+    void Rejected(const int n)
+    {
+      _events += n;
+      _cutFlow[kCutAll] += n;
+    }
+
+    // count event in the cut-flow step
+    void Pass(const Cut c) { _cutFlow[c]++; }
+
+    // input files (bytes read by ROOT, events and wall time between open and close)
+    void OpenInputFile(const std::string& name)
+    {
+      StatInputFile file;
+      file.Name = name;
+      file.Events = _events;
+      file.BytesRead = TFile::GetFileBytesRead();
+      file.WallTime = StatWallTime();
+      file.Open = true;
+      _vecInputFiles.push_back(file);
+    }
+    void CloseInputFile()
+    {
+      if(_vecInputFiles.empty() || !_vecInputFiles.back().Open)
+        return;
+      StatInputFile& file = _vecInputFiles.back();
+      file.Events = _events - file.Events;
+      file.BytesRead = TFile::GetFileBytesRead() - file.BytesRead;
+      file.WallTime = StatWallTime() - file.WallTime;
+      file.Open = false;
+    }
+
+    // end of job: write histograms to dir (subdirectory 'stat') and the summary JSON file
+    // (the heartbeat file is removed: the job is not running anymore)
+    void WriteSummary(TDirectory* dir)
+    {
+      FillEventTime();
+      CloseInputFile();
+      if(dir)
+      {
+        TDirectory* statDir = dir->mkdir("stat");
+        statDir->cd();
+        for(int s = 0; s < kNStages; s++)
+          _hStageTime[s]->Write();
+        TH1D hCutFlow("cutflow", "selection cut-flow;;events", kNCuts, 0.0, kNCuts);
+        TH1D hStage("stages", "wall time;;t [s]", kNStages, 0.0, kNStages);
+        for(int c = 0; c < kNCuts; c++)
+        {
+          hCutFlow.GetXaxis()->SetBinLabel(c + 1, _cutNames[c].c_str());
+          hCutFlow.SetBinContent(c + 1, _cutFlow[c]);
+        }
+        for(int s = 0; s < kNStages; s++)
+        {
+          hStage.GetXaxis()->SetBinLabel(s + 1, _stageNames[s].c_str());
+          hStage.SetBinContent(s + 1, _stageTime[s]);
+        }
+        hCutFlow.Write();
+        hStage.Write();
+        dir->cd();
+      }
+      WriteJSON(_summaryName, "finished", StatWallTime());
+      if(_heartbeatName != "")
+        remove(_heartbeatName.c_str());
+    }
+
+  private:
+    // fill per event histograms for the previous event
+    void FillEventTime()
+    {
+      for(int s = 0; s < kNStages; s++)
+      {
+        if(_eventTime[s] < 0.0)
+          continue;
+        _hStageTime[s]->Fill(log10(1e6 * _eventTime[s] + 1e-3));
+        _eventTime[s] = -1.0;
+      }
+    }
+
+    // write all counters to JSON file (via temporary file, so that readers never see it incomplete)
+    void WriteJSON(const std::string& name, const char* status, const double now) const
+    {
+      if(name == "")
+        return;
+      std::string tmpName = name + ".tmp";
+      FILE* f = fopen(tmpName.c_str(), "w");
+      if(!f)
+      {
+        printf("Warning: cannot write %s\n", tmpName.c_str());
+        return;
+      }
+      const double wallTime = now - _startTime;
+      const double recentTime = now - _lastHeartbeat;
+      fprintf(f, "{\n");
+      fprintf(f, "  \"status\": \"%s\",\n", status);
+      fprintf(f, "  \"time\": %.0f,\n", now);
+      fprintf(f, "  \"wallTime\": %.3f,\n", wallTime);
+      fprintf(f, "  \"events\": %d,\n", _events);
+      fprintf(f, "  \"selected\": %d,\n", _cutFlow[kCutStored]);
+      fprintf(f, "  \"eventsPerSecond\": %.3f,\n", (wallTime > 0.0) ? (_events / wallTime) : 0.0);
+      fprintf(f, "  \"eventsPerSecondRecent\": %.3f,\n", (recentTime > 0.0) ? ((_events - _lastHeartbeatEvents) / recentTime) : 0.0);
+      fprintf(f, "  \"bytesRead\": %lld,\n", (long long)TFile::GetFileBytesRead());
+      fprintf(f, "  \"stages\": {\n");
+      for(int s = 0; s < kNStages; s++)
+        fprintf(f, "    \"%s\": {\"calls\": %d, \"time\": %.6f}%s\n", _stageNames[s].c_str(), _stageCalls[s], _stageTime[s], (s < kNStages - 1) ? "," : "");
+      fprintf(f, "  },\n");
+      fprintf(f, "  \"cutFlow\": {\n");
+      for(int c = 0; c < kNCuts; c++)
+        fprintf(f, "    \"%s\": %d%s\n", _cutNames[c].c_str(), _cutFlow[c], (c < kNCuts - 1) ? "," : "");
+      fprintf(f, "  },\n");
+      fprintf(f, "  \"inputFiles\": [\n");
+      for(unsigned int i = 0; i < _vecInputFiles.size(); i++)
+      {
+        const StatInputFile& file = _vecInputFiles[i];
+        // for the open file: events, bytes and time so far
+        const int events = file.Open ? (_events - file.Events) : file.Events;
+        const long long bytesRead = file.Open ? (TFile::GetFileBytesRead() - file.BytesRead) : file.BytesRead;
+        const double fileTime = file.Open ? (now - file.WallTime) : file.WallTime;
+        fprintf(f, "    {\"name\": \"%s\", \"open\": %s, \"events\": %d, \"bytesRead\": %lld, \"wallTime\": %.3f}%s\n", file.Name.c_str(),
+          file.Open ? "true" : "false", events, bytesRead, fileTime, (i < _vecInputFiles.size() - 1) ? "," : "");
+      }
+      fprintf(f, "  ]\n");
+      fprintf(f, "}\n");
+      fclose(f);
+      rename(tmpName.c_str(), name.c_str());
+    }
+
+    // input file statistics (while the file is open, values at the opening)
+    struct StatInputFile
+    {
+      std::string Name;
+      int Events;
+      long long BytesRead;
+      double WallTime;
+      bool Open;
+    };
+
+    std::string _summaryName;
+    std::string _heartbeatName;
+    double _heartbeatPeriod;
+    // stages: names, number of calls, total time, time in the current event (-1 if not called)
+    std::string _stageNames[kNStages];
+    int _stageCalls[kNStages];
+    double _stageTime[kNStages];
+    double _eventTime[kNStages];
+    TH1D* _hStageTime[kNStages];
+    // cut-flow
+    std::string _cutNames[kNCuts];
+    int _cutFlow[kNCuts];
+    // events and time
+    int _events;
+    double _startTime;
+    double _lastHeartbeat;
+    int _lastHeartbeatEvents;
+    std::vector<StatInputFile> _vecInputFiles;
+};
+
+#endif
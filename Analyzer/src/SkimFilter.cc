@@ -0,0 +1,217 @@
+// -*- C++ -*-
+//
+// Package:    Analyzer
+// Class:      SkimFilter
+//
+/**\class SkimFilter SkimFilter.cc ttbar/Analyzer/src/SkimFilter.cc
+
+ Description: fast event preselection before Analyzer
+
+ Implementation:
+     Rejects events which cannot be used in the analysis: no analysis trigger
+     fired (trigger names from AnalysisTriggers.h, the same as in Analyzer),
+     or no pair of opposite signed leptons (electrons or muons) with
+     pT > minPt and |eta| < maxEta. Only trigger results and lepton
+     kinematics are checked, i.e. this is looser than the selection in
+     Analyzer: the rejected events would not pass reco level selection
+     in Analyzer and PostAnalyzer anyway.
+     Must not be used if generator level is processed (events are stored
+     in Analyzer also if they are interesting at generator level only).
+     The number of input events in each luminosity section is stored as
+     luminosity section product 'nEvents', so that Analyzer reports all
+     processed events, not only those passing this filter.
+*/
+
+
+// system include files
+#include <memory>
+
+// user include files
+#include "FWCore/Framework/interface/Frameworkfwd.h"
+#include "FWCore/Framework/interface/EDFilter.h"
+#include "FWCore/Framework/interface/Event.h"
+#include "FWCore/Framework/interface/Run.h"
+#include "FWCore/Framework/interface/LuminosityBlock.h"
+#include "FWCore/Framework/interface/MakerMacros.h"
+#include "FWCore/ParameterSet/interface/ParameterSet.h"
+#include "DataFormats/Common/interface/MergeableCounter.h"
+
+// for muons
+#include "DataFormats/MuonReco/interface/Muon.h"
+#include "DataFormats/MuonReco/interface/MuonFwd.h"
+
+// for electrons
+#include "DataFormats/EgammaCandidates/interface/GsfElectron.h"
+
+// triggers
+#include "DataFormats/Common/interface/TriggerResults.h"
+#include "HLTrigger/HLTcore/interface/HLTConfigProvider.h"
+
+// trigger names used in the analysis
+#include "AnalysisTriggers.h"
+
+// ROOT
+#include <TMath.h>
+
+//
+// class declaration
+//
+class SkimFilter : public edm::EDFilter {
+   public:
+      explicit SkimFilter(const edm::ParameterSet&);
+      ~SkimFilter();
+
+   private:
+      virtual bool filter(edm::Event&, const edm::EventSetup&);
+      virtual bool beginRun(edm::Run&, edm::EventSetup const&);
+      virtual bool beginLuminosityBlock(edm::LuminosityBlock&, edm::EventSetup const&);
+      virtual bool endLuminosityBlock(edm::LuminosityBlock&, edm::EventSetup const&);
+
+      // user routines
+      bool SelectTrigger(const edm::Event& iEvent);
+      template<class Collection> void CountLeptons(const edm::Handle<Collection>& leptons, int& nPlus, int& nMinus);
+
+      // input tags
+      edm::InputTag _inputTagMuons;
+      edm::InputTag _inputTagElectrons;
+      edm::InputTag _inputTagTriggerResults;
+
+      // selection parameters
+      bool _flagTrigger;
+      double _minPt;
+      double _maxEta;
+
+      // trigger path indices and bits for the analysis triggers (updated if the HLT menu changes)
+      std::vector<std::string> _vecTriggerNames;
+      std::vector<std::pair<unsigned int, int> > _vecTriggerPathBits;
+      HLTConfigProvider _triggerConfig;
+
+      // event counters
+      int _nevents;
+      int _neventsTrigger;
+      int _neventsSelected;
+      // input events in the current luminosity section
+      unsigned int _neventsLumi;
+};
+
+//
+// constructor
+//
+SkimFilter::SkimFilter(const edm::ParameterSet& iConfig)
+{
+  // input tags (the same as in Analyzer)
+  _inputTagMuons = edm::InputTag("muons");
+  _inputTagElectrons = edm::InputTag("gsfElectrons");
+  _inputTagTriggerResults = edm::InputTag("TriggerResults", "", "HLT");
+
+  // read configuration parameters
+  _flagTrigger = iConfig.getParameter<int>("trigger"); // if true, require at least one analysis trigger
+  _minPt = iConfig.getParameter<double>("minPt"); // minimum lepton pT
+  _maxEta = iConfig.getParameter<double>("maxEta"); // maximum lepton |eta|
+
+  AnalysisTriggerNames(_vecTriggerNames);
+  _nevents = 0;
+  _neventsTrigger = 0;
+  _neventsSelected = 0;
+  _neventsLumi = 0;
+
+  // input events per luminosity section (read by Analyzer)
+  produces<edm::MergeableCounter, edm::InLumi>("nEvents");
+}
+
+// destructor
+SkimFilter::~SkimFilter()
+{
+  // print total number of processed and selected events
+  printf("SkimFilter: processed %d events, triggered %d, selected %d\n", _nevents, _neventsTrigger, _neventsSelected);
+}
+
+//
+// member functions
+//
+
+// returns true if at least one analysis trigger is fired
+bool SkimFilter::SelectTrigger(const edm::Event& iEvent)
+{
+  edm::Handle<edm::TriggerResults> HLTR;
+  iEvent.getByLabel(_inputTagTriggerResults, HLTR);
+  for(unsigned int i = 0; i < _vecTriggerPathBits.size(); i++)
+    if(HLTR->accept(_vecTriggerPathBits[i].first))
+      return true;
+  return false;
+}
+
+// count leptons with pT > _minPt and |eta| < _maxEta (nPlus positive, nMinus negative)
+template<class Collection>
+void SkimFilter::CountLeptons(const edm::Handle<Collection>& leptons, int& nPlus, int& nMinus)
+{
+  for(typename Collection::const_iterator it = leptons->begin(); it != leptons->end(); it++)
+  {
+    if(it->pt() < _minPt)
+      continue;
+    if(TMath::Abs(it->eta()) > _maxEta)
+      continue;
+    if(it->charge() == +1)
+      nPlus++;
+    if(it->charge() == -1)
+      nMinus++;
+  }
+}
+
+// ------------ method called for each event  ------------
+bool SkimFilter::filter(edm::Event& iEvent, const edm::EventSetup& iSetup)
+{
+  _nevents++;
+  _neventsLumi++;
+  // triggers (cheapest check first)
+  if(_flagTrigger && !SelectTrigger(iEvent))
+    return false;
+  _neventsTrigger++;
+  // require pair of opposite signed leptons (muons first: typically fewer candidates)
+  int nPlus = 0;
+  int nMinus = 0;
+  edm::Handle<reco::MuonCollection> muons;
+  iEvent.getByLabel(_inputTagMuons, muons);
+  CountLeptons(muons, nPlus, nMinus);
+  if(!nPlus || !nMinus)
+  {
+    edm::Handle<reco::GsfElectronCollection> electrons;
+    iEvent.getByLabel(_inputTagElectrons, electrons);
+    CountLeptons(electrons, nPlus, nMinus);
+  }
+  if(!nPlus || !nMinus)
+    return false;
+  _neventsSelected++;
+  return true;
+}
+
+// ------------ method called when starting to processes a run  ------------
+bool SkimFilter::beginRun(edm::Run& iRun, edm::EventSetup const& iSetup)
+{
+  // find trigger path indices for the analysis triggers, if the HLT menu changed 
+  // (as in Analyzer::FindTriggerBits())
+  bool changed = true;
+  _triggerConfig.init(iRun, iSetup, _inputTagTriggerResults.process(), changed);
+  if(changed)
+    FindAnalysisTriggerPaths(_triggerConfig.triggerNames(), _vecTriggerNames, _vecTriggerPathBits);
+  return true;
+}
+
+// ------------ method called when starting to processes a luminosity block  ------------
+bool SkimFilter::beginLuminosityBlock(edm::LuminosityBlock&, edm::EventSetup const&)
+{
+  _neventsLumi = 0;
+  return true;
+}
+
+// ------------ method called when ending the processing of a luminosity block  ------------
+bool SkimFilter::endLuminosityBlock(edm::LuminosityBlock& iLumi, edm::EventSetup const&)
+{
+  std::auto_ptr<edm::MergeableCounter> nEvents(new edm::MergeableCounter);
+  nEvents->value = _neventsLumi;
+  iLumi.put(nEvents, "nEvents");
+  return true;
+}
+
+//define this as a plug-in
+DEFINE_FWK_MODULE(SkimFilter);
@@ -1,8 +1,22 @@
 #!/bin/bash
 
-# compile code (produces two executables)
-g++ -o ttbarMakeHist `root-config --cflags --libs` -lMathMore -std=c++11 ttbarMakeHist.cxx
+# compile code (produces two executables, and the benchmark of the kinematic 
+# reconstruction, see ttbarBenchKinReco.cxx)
+# (to use ROOT polynomial solver in kinematic reconstruction for validation, 
+# add -DKINRECO_ROOT_POLYNOMIAL -lMathMore to the first command;
+# batched kinematic reconstruction is vectorised with -O3, add -march=native
+# to use AVX2/AVX-512 if available on the machine where the code is run;
+# -ffp-contract=off keeps batched and one-by-one kinematic reconstruction
+# identical, see CoefsKinRecoDilepton() in kinReco.h;
+# to print and store timing of the processing stages and the cut flow, add 
+# -DTTBAR_PROFILE [-DTTBAR_PROFILE_RDTSC] to the first command, see profile.h)
+# (the checksum of the sources is stored in the fingerprint of the output 
+# histograms, so that they are produced again after any change in the code, 
+# see ZEventRecoInput::Fingerprint() in eventReco.h)
+codeStamp=`cat ttbarMakeHist.cxx *.h | cksum | cut -d' ' -f1`
+g++ -o ttbarMakeHist `root-config --cflags --libs` -O3 -ffp-contract=off -std=c++11 -DTTBAR_CODE_STAMP=${codeStamp} ttbarMakeHist.cxx
 g++ -o ttbarMakePlots `root-config --cflags --libs` -std=c++11 ttbarMakePlots.cxx
+g++ -o ttbarBenchKinReco `root-config --cflags --libs` -O3 -ffp-contract=off -std=c++11 ttbarBenchKinReco.cxx
 
 # create needed directories if do not exist yet
-mkdir -p data mc hist plots
+mkdir -p data mc hist hist/parts plots cache
@@ -9,50 +9,327 @@
 #include "tree.h"
 #include "kinReco.h"
 #include "selection.h"
+#include "preselCache.h"
 #include "settings.h"
+#include "profile.h"
 // C++ library or ROOT header files
 #include <map>
+#include <cstdlib>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <memory>
+#include <algorithm>
+#include <TROOT.h>
 #include <TChain.h>
 #include <TCanvas.h>
 #include <TFile.h>
+#include <TNamed.h>
 
+// version of the event reconstruction: increase it if a change in the code
+// changes the histograms (outputs with an older version are not reused, see
+// ZEventRecoInput::UpToDate() below)
+const int gEventRecoVersion = 3;
+
+// compile-time switches which change the outputs (also part of the fingerprint):
+// ROOT polynomial solver (see kinReco.h), batch size of the kinematic 
+// reconstruction, timing and cut flow histograms (see profile.h)
+const int gEventRecoSwitches[] = {
+#ifdef KINRECO_ROOT_POLYNOMIAL
+  1,
+#else
+  0,
+#endif
+  KINRECO_BATCH_SIZE,
+#ifdef TTBAR_PROFILE
+  1,
+#else
+  0,
+#endif
+};
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+// >>>>>>>>>>>>>>>>>> Event kinematics for histograms >>>>>>>>>>>>>>>>>>>
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+//
+// Quantities which can be filled in histograms, 
+// calculated once per event (see void FillHistos() below)
+//
+class ZFillKinematics
+{
+  public:
+    double PtT, PtTbar; // top and antitop pT
+    double YT, YTbar; // top and antitop rapidity
+    double PtTT, YTT, MTT; // ttbar pT, rapidity and invariant mass
+    double PtLepM, PtLepP; // lepton- and lepton+ pT (if leptons are provided)
+
+    // constructor (vecLepM and vecLepP can be NULL)
+    ZFillKinematics(const TLorentzVector* t, const TLorentzVector* tbar, const TLorentzVector* vecLepM, const TLorentzVector* vecLepP)
+    {
+      // momentum of ttbar pair
+      TLorentzVector ttbar = *t + *tbar;
+      PtT = t->Pt();
+      PtTbar = tbar->Pt();
+      YT = t->Rapidity();
+      YTbar = tbar->Rapidity();
+      PtTT = ttbar.Pt();
+      YTT = ttbar.Rapidity();
+      MTT = ttbar.M();
+      PtLepM = vecLepM ? vecLepM->Pt() : 0.0;
+      PtLepP = vecLepP ? vecLepP->Pt() : 0.0;
+    }
+};
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+// >>>>>>>>>>>>>>>>>>>>>> ZFlatHisto class >>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+//
+// Compact one-dimensional histogram used during the event reconstruction: 
+// flat arrays of weighted bin contents and sums of squared weights 
+// (including underflow and overflow bins, filled as TH1D::Fill() does), 
+// converted to TH1D only when stored (see MakeTH1D() and StoreHistos() 
+// below). The binning (name, title, bin edges) is shared by all copies, 
+// the bin arrays are owned by each object, allocated at the first fill 
+// and freed by Release() or the destructor. Copies are cheap until filled, 
+// e.g. histograms of inputs and variations made from one definition.
+//
+class ZFlatHisto
+{
+  private:
+    // binning (never changed after construction)
+    struct ZBinning
+    {
+      TString Name, Title;
+      int NBins;
+      double Min, Max;
+      std::vector<double> Edges; // bin edges (empty for equidistant bins)
+    };
+    std::shared_ptr<const ZBinning> zBinning;
+    std::vector<double> zSumW; // weighted bin contents (bin 0 underflow, NBins() + 1 overflow), empty if not filled
+    std::vector<double> zSumW2; // sums of squared weights (the same bins)
+    double zEntries; // number of entries
+  
+    // allocate bin arrays (if not done yet)
+    void Alloc()
+    {
+      if(!zSumW.empty())
+        return;
+      zSumW.assign(NBins() + 2, 0.0);
+      zSumW2.assign(NBins() + 2, 0.0);
+    }
+
+  public:
+    // constructor for nBins equidistant bins between min and max (as TH1D)
+    ZFlatHisto(const TString& name, const TString& title, const int nBins, const double min, const double max)
+    {
+      std::shared_ptr<ZBinning> binning(new ZBinning);
+      binning->Name = name;
+      binning->Title = title;
+      binning->NBins = nBins;
+      binning->Min = min;
+      binning->Max = max;
+      zBinning = binning;
+      zEntries = 0.0;
+    }
+
+    // constructor for nBins bins with edges (array of nBins + 1 values, as TH1D)
+    ZFlatHisto(const TString& name, const TString& title, const int nBins, const double* edges)
+    {
+      std::shared_ptr<ZBinning> binning(new ZBinning);
+      binning->Name = name;
+      binning->Title = title;
+      binning->NBins = nBins;
+      binning->Min = edges[0];
+      binning->Max = edges[nBins];
+      binning->Edges.assign(edges, edges + nBins + 1);
+      zBinning = binning;
+      zEntries = 0.0;
+    }
+
+    // access binning
+    const TString& Name() const {return zBinning->Name;}
+    const TString& Title() const {return zBinning->Title;}
+    int NBins() const {return zBinning->NBins;}
+
+    // low edge of bin b (1 <= b <= NBins() + 1, the same values as TAxis::GetBinLowEdge())
+    double LowEdge(const int b) const
+    {
+      if(!zBinning->Edges.empty())
+        return zBinning->Edges[b - 1];
+      return zBinning->Min + (b - 1) * ((zBinning->Max - zBinning->Min) / NBins());
+    }
+
+    // bin for value x (the same as TAxis::FindBin())
+    int FindBin(const double x) const
+    {
+      if(x < zBinning->Min)
+        return 0;
+      if(!(x < zBinning->Max))
+        return NBins() + 1;
+      if(zBinning->Edges.empty())
+        return 1 + int(NBins() * (x - zBinning->Min) / (zBinning->Max - zBinning->Min));
+      return std::upper_bound(zBinning->Edges.begin(), zBinning->Edges.end(), x) - zBinning->Edges.begin();
+    }
+
+    // fill value x with weight w
+    void Fill(const double x, const double w)
+    {
+      Alloc();
+      const int b = FindBin(x);
+      zSumW[b] += w;
+      zSumW2[b] += w * w;
+      zEntries++;
+    }
+
+    // add contents of a histogram with the same binning (e.g. read from a file)
+    void Add(const TH1* h)
+    {
+      if(h->GetNbinsX() != NBins())
+      {
+        printf("Error: cannot add histogram %s with %d bins to %s with %d bins\n", h->GetName(), h->GetNbinsX(), Name().Data(), NBins());
+        exit(1);
+      }
+      Alloc();
+      for(int b = 0; b < NBins() + 2; b++)
+      {
+        const double e = h->GetBinError(b);
+        zSumW[b] += h->GetBinContent(b);
+        zSumW2[b] += e * e;
+      }
+      zEntries += h->GetEntries();
+    }
+
+    // free bin arrays (contents are reset, binning is kept)
+    void Release()
+    {
+      std::vector<double>().swap(zSumW);
+      std::vector<double>().swap(zSumW2);
+      zEntries = 0.0;
+    }
+
+    // new TH1D with the same binning and contents (not attached to any directory, 
+    // to be deleted by the caller; mean and RMS are calculated from bin contents)
+    TH1D* MakeTH1D() const
+    {
+      TH1D* h = zBinning->Edges.empty() ? 
+        new TH1D(Name(), Title(), NBins(), zBinning->Min, zBinning->Max) : 
+        new TH1D(Name(), Title(), NBins(), &zBinning->Edges[0]);
+      h->SetDirectory(0);
+      if(h->GetSumw2N() == 0)
+        h->Sumw2();
+      for(int b = 0; b < NBins() + 2 && !zSumW.empty(); b++)
+      {
+        h->SetBinContent(b, zSumW[b]);
+        h->GetSumw2()->SetAt(zSumW2[b], b);
+      }
+      h->SetEntries(zEntries);
+      return h;
+    }
+};
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+
+// function which fills one histogram from event kinematics with weight w
+typedef void (*ZFillFunction)(ZFlatHisto& histo, const ZFillKinematics& kin, const double w);
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+// >>>>>>>>>>>>>>>>>>>>>>>> Known variables >>>>>>>>>>>>>>>>>>>>>>>>>>>>
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+//
+// Table of variables which can be used for ZVarHisto: variable name 
+// and fill function. To implement a new variable, add one line here 
+// (and a new member of ZFillKinematics if needed).
+//
+struct ZFillVariable
+{
+  const char* Var; // variable name
+  ZFillFunction Fill; // fill function
+};
+const ZFillVariable gFillVariables[] = {
+  // top pT
+  {"ptt",   [](ZFlatHisto& h, const ZFillKinematics& k, const double w) { h.Fill(k.PtT, w); }},
+  // antitop pT
+  {"ptat",  [](ZFlatHisto& h, const ZFillKinematics& k, const double w) { h.Fill(k.PtTbar, w); }},
+  // top pT, antitop pT (two entries per one event)
+  {"pttat", [](ZFlatHisto& h, const ZFillKinematics& k, const double w) { h.Fill(k.PtT, w); h.Fill(k.PtTbar, w); }},
+  // ttbar pT
+  {"pttt",  [](ZFlatHisto& h, const ZFillKinematics& k, const double w) { h.Fill(k.PtTT, w); }},
+  // top rapidity
+  {"yt",    [](ZFlatHisto& h, const ZFillKinematics& k, const double w) { h.Fill(k.YT, w); }},
+  // antitop rapidity
+  {"yat",   [](ZFlatHisto& h, const ZFillKinematics& k, const double w) { h.Fill(k.YTbar, w); }},
+  // top rapidity, antitop rapidity (two entries per one event)
+  {"ytat",  [](ZFlatHisto& h, const ZFillKinematics& k, const double w) { h.Fill(k.YT, w); h.Fill(k.YTbar, w); }},
+  // ttbar rapidity
+  {"ytt",   [](ZFlatHisto& h, const ZFillKinematics& k, const double w) { h.Fill(k.YTT, w); }},
+  // ttbar invariant mass
+  {"mtt",   [](ZFlatHisto& h, const ZFillKinematics& k, const double w) { h.Fill(k.MTT, w); }},
+  // lepton pT (two entries per one event)
+  {"ptl",   [](ZFlatHisto& h, const ZFillKinematics& k, const double w) { h.Fill(k.PtLepM, w); h.Fill(k.PtLepP, w); }},
+};
+
+// return fill function for variable name var (NULL for unknown variable)
+ZFillFunction FindFillFunction(const TString& var)
+{
+  for(unsigned int v = 0; v < sizeof(gFillVariables) / sizeof(gFillVariables[0]); v++)
+    if(var == gFillVariables[v].Var)
+      return gFillVariables[v].Fill;
+  // unknown (not implemented) variable: histogram is not filled
+  //printf("Error: unknown variable %s\n", var.Data());
+  //exit(1);
+  return NULL;
+}
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
 
 // >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
 // >>>>>>>>>>>>>>>>>>>>>>>> ZVarHisto class >>>>>>>>>>>>>>>>>>>>>>>>>>>>
 // >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
 //
 // Class for control plot and cross section histograms: 
-// it stores variable name and histogram. 
+// it stores variable name and histogram (owned by the object, see 
+// ZFlatHisto above; copies have their own contents, can be moved). 
 // A bunch of histograms can be filled using proper ttbar kinematics 
 // input with just one line (see void FillHistos() below).
 // Also see void StoreHistos() for histogram storage.
+// The variable name is resolved into the fill function in the constructor 
+// (see gFillVariables above).
 //
 class ZVarHisto
 {
   private:
-    TH1D* zHisto; // histogram
-    TString zVar; // variable name (see void FillHistos() fot its usage)
+    ZFlatHisto zHisto; // histogram
+    TString zVar; // variable name
+    ZFillFunction zFill; // fill function for this variable (NULL if unknown)
   
   public:
-    // constructor
-    ZVarHisto(const TString& str, TH1D* h)
+    // constructor for equidistant bins (name, title, nBins, min, max as for TH1D)
+    ZVarHisto(const TString& str, const TString& name, const TString& title, const int nBins, const double min, const double max) :
+      zHisto(name, title, nBins, min, max)
     {
-      zHisto = h;
       zVar = str;
+      zFill = FindFillFunction(str);
     }
 
-    // copy constructor
-    ZVarHisto(const ZVarHisto& old)
+    // constructor for bins with edges (name, title, nBins, edges as for TH1D)
+    ZVarHisto(const TString& str, const TString& name, const TString& title, const int nBins, const double* edges) :
+      zHisto(name, title, nBins, edges)
     {
-      zHisto = new TH1D(*(old.zHisto));
-      zVar = old.zVar;
+      zVar = str;
+      zFill = FindFillFunction(str);
     }
 
     // access histogram
-    TH1* H() {return zHisto;}
+    ZFlatHisto& H() {return zHisto;}
+    const ZFlatHisto& H() const {return zHisto;}
     
     // access variable name
-    TString V() {return zVar;}
+    TString V() const {return zVar;}
+
+    // fill histogram from event kinematics
+    void Fill(const ZFillKinematics& kin, const double w)
+    {
+      if(zFill)
+        zFill(zHisto, kin, w);
+    }
 };
 // >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
 
@@ -63,71 +340,20 @@ class ZVarHisto
 // Arguments:
 //   std::vector<ZVarHisto>& VecVarHisto: vector of objects to be filled
 //   double w: weight
-//   TLorentzVector* t: top quark momentum
-//   TLorentzVector* tbar: antitop quark momentum
-//   TLorentzVector* vecLepM: leptoni momentum (if needed, can be omitted)
-//   TLorentzVector* vecLepP: lepton+ momentum (if needed, can be omitted)
+//   const TLorentzVector* t: top quark momentum
+//   const TLorentzVector* tbar: antitop quark momentum
+//   const TLorentzVector* vecLepM: leptoni momentum (if needed, can be omitted)
+//   const TLorentzVector* vecLepP: lepton+ momentum (if needed, can be omitted)
 //
-void FillHistos(std::vector<ZVarHisto>& VecVarHisto, double w, TLorentzVector* t, TLorentzVector* tbar, TLorentzVector* vecLepM = NULL, TLorentzVector* vecLepP = NULL)
+void FillHistos(std::vector<ZVarHisto>& VecVarHisto, double w, const TLorentzVector* t, const TLorentzVector* tbar, 
+  const TLorentzVector* vecLepM = NULL, const TLorentzVector* vecLepP = NULL)
 {
-  // momentum of ttbar pair
-  TLorentzVector ttbar = *t + *tbar;
+  PROFILE_TIMER(stageFill);
+  // all needed quantities are calculated once
+  ZFillKinematics kin(t, tbar, vecLepM, vecLepP);
   // loop over provided histograms to be filled
   for(int h = 0; h < VecVarHisto.size(); h++)
-  {
-    // retrieve variable name
-    TString var = VecVarHisto[h].V();
-    // retrieve histogram
-    TH1* histo = VecVarHisto[h].H();
-    // now fill histograms depending on the variable:
-    // top pT
-    if(var == "ptt") 
-      histo->Fill(t->Pt(), w);
-    // antitop pT
-    else if(var == "ptat") 
-      histo->Fill(tbar->Pt(), w);
-    // top pT, antitop pT (two entries per one event)
-    else if(var == "pttat") 
-    {
-      histo->Fill(t->Pt(), w);
-      histo->Fill(tbar->Pt(), w);
-    }
-    // ttbar pT
-    else if(var == "pttt") 
-      histo->Fill(ttbar.Pt(), w);
-    // top rapidity
-    else if(var == "yt") 
-      histo->Fill(t->Rapidity(), w);
-    // antitop pT
-    else if(var == "yat") 
-      histo->Fill(tbar->Rapidity(), w);
-    // top rapidity, antitop rapidity (two entries per one event)
-    else if(var == "ytat") 
-    {
-      histo->Fill(t->Rapidity(), w);
-      histo->Fill(tbar->Rapidity(), w);
-    }
-    // ttbar rapidity
-    else if(var == "ytt") 
-      histo->Fill(ttbar.Rapidity(), w);
-    // ttbar invariant mass
-    else if(var == "mtt") 
-      histo->Fill(ttbar.M(), w);
-    // lepton pT
-    else if(var == "ptl") 
-    {
-      histo->Fill(vecLepM->Pt(), w);
-      histo->Fill(vecLepP->Pt(), w);
-    }
-    // unknown (not implemented) variable
-    // (you can implement more variables here if needed)
-    else
-    {
-      //printf("Error: unknown variable %s\n", var.Data());
-      //exit(1);
-      continue;
-    } // end variable for histo
-  } // end loop over histos
+    VecVarHisto[h].Fill(kin, w);
 }
 // >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
 
@@ -136,21 +362,69 @@ void FillHistos(std::vector<ZVarHisto>& VecVarHisto, double w, TLorentzVector* t
 // >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
 //
 // Store bunch of histogram (argument std::vector<ZVarHisto>& VecVarHisto)
-// (stores a copy of histogram)
+// in the current directory (each one is converted to a temporary TH1D)
 //
-void StoreHistos(std::vector<ZVarHisto>& VecVarHisto)
+void StoreHistos(const std::vector<ZVarHisto>& VecVarHisto)
 {
   for(int h = 0; h < VecVarHisto.size(); h++)
   {
-    TH1* histo = VecVarHisto[h].H();
-    TString name = histo->GetName();
-    TString title = histo->GetTitle();
-    histo->SetNameTitle(name, title);
+    TH1D* histo = VecVarHisto[h].H().MakeTH1D();
     histo->Write();
+    delete histo;
   }
 }
 // >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
 
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+// >>>>>>>>>>>>> Parameters of the event reconstruction >>>>>>>>>>>>>>>>>>
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+//
+// Parameters which can be varied for systematic studies (see 
+// ZEventRecoVariation below), nominal values by default
+//
+class ZEventRecoParameters
+{
+  public:
+    ZKinRecoParameters KinReco; // kinematic reconstruction parameters (see kinReco.h)
+    double JetPtMin; // jet pT threshold (see SelectJets() in selection.h)
+    double BTagDiscrMin; // b-tagging discriminator threshold (see SelectJets() in selection.h)
+
+    // constructor (nominal values)
+    ZEventRecoParameters()
+    {
+      JetPtMin = gSelectionCuts.JetPtMin;
+      BTagDiscrMin = gSelectionCuts.BTagDiscrMin;
+    }
+};
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+// >>>>>>>>>>>>>>>>>>> Systematic variation >>>>>>>>>>>>>>>>>>>>>>>>>>>>
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+//
+// Named parameter point with its own histograms: all variations of one 
+// ZEventRecoInput are processed in the same event loop as the nominal 
+// parameters, reusing the selected leptons and the lepton context of 
+// the kinematic reconstruction (see RecoEvent() below). Histograms are 
+// stored in <Name>_<variation name>-c<Channel>.root. 
+// Only reco level is affected (generator level inputs ignore variations).
+// The jet pT threshold cannot be lower than the nominal one (jets below it 
+// are not preselected), such variations are rejected in eventrecoPass().
+//
+class ZEventRecoVariation
+{
+  public:
+    TString Name; // variation name (used in output file name)
+    ZEventRecoParameters Par; // parameters (nominal values by default)
+    std::vector<ZVarHisto> VecVarHisto; // container with histograms for this variation
+
+    // constructor (vecVarHisto is copied, parameters should be set afterwards)
+    ZEventRecoVariation(const TString& name, const std::vector<ZVarHisto>& vecVarHisto)
+    {
+      Name = name;
+      VecVarHisto = vecVarHisto;
+    }
+};
+
 // >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
 // >>>>>> Input parameters for eventreco routine (see below)  >>>>>>>>>>
 // >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
@@ -165,6 +439,13 @@ class ZEventRecoInput
     std::vector<TString> VecInFile; // container with input files
     double Weight; // weight for histogram filling
     long MaxNEvents; // maximum number of processed events
+    std::vector<ZEventRecoVariation> VecVariation; // systematic variations (see above), none by default
+    TString OutDir; // directory for output ROOT files with histograms
+    int Part; // if >= 0, partial output for a range of input files (see samples.h)
+#ifdef TTBAR_PROFILE
+    std::vector<TH1D*> VecCutFlow; // cut flow histograms (index v + 1 for variation v, see profile.h), stored if not empty
+    TH1D* Timing; // timing histogram of the pass (see profile.h), stored if not NULL
+#endif
     
     // contstructor
     ZEventRecoInput()
@@ -173,6 +454,11 @@ class ZEventRecoInput
       Weight = 1.0;
       MaxNEvents = 100e10;
       Gen = false;
+      OutDir = gHistDir;
+      Part = -1;
+#ifdef TTBAR_PROFILE
+      Timing = NULL;
+#endif
     }
     
     // add one more input file (str) to the chain
@@ -186,227 +472,902 @@ class ZEventRecoInput
     {
       VecInFile.clear();
     }
+
+    // histograms for variation v (v = -1: nominal)
+    std::vector<ZVarHisto>& Histos(const int v)
+    {
+      return (v < 0) ? VecVarHisto : VecVariation[v].VecVarHisto;
+    }
+
+    // number of variations with output files (generator level inputs ignore variations)
+    int NVariations() const
+    {
+      return Gen ? 0 : VecVariation.size();
+    }
+
+    // output file name for variation v (v = -1: nominal): <Name>[_<variation>]-c<Channel>[.part<Part>].root
+    TString OutFileName(const int v) const
+    {
+      TString name = (v < 0) ? Name : (Name + "_" + VecVariation[v].Name);
+      TString part = (Part < 0) ? TString("") : TString::Format(".part%d", Part);
+      return TString::Format("%s/%s-c%d%s.root", OutDir.Data(), name.Data(), Channel, part.Data());
+    }
+
+    // Fingerprint of everything the output histograms depend on: input files 
+    // (names, sizes and modification times), selection cuts (as in the key of 
+    // the preselected event cache including the code stamp, see preselCache.h),
+    // code (version and compile-time switches, see above), type, channel, weight, 
+    // parameters of the event reconstruction, histogram definitions (names, 
+    // variables, binning) for nominal and all variations
+    unsigned long long Fingerprint()
+    {
+      unsigned long long h = ZPreselCache::MakeKey(VecInFile, Type == 2 || Type == 3, !Gen);
+      ZPreselCache::HashValue(h, gEventRecoVersion);
+      ZPreselCache::Hash(h, gEventRecoSwitches, sizeof(gEventRecoSwitches));
+      long long info[4] = { Type, Channel, Gen, MaxNEvents };
+      ZPreselCache::Hash(h, info, sizeof(info));
+      ZPreselCache::HashValue(h, Weight);
+      for(int v = -1; v < NVariations(); v++)
+      {
+        const ZEventRecoParameters par = (v < 0) ? ZEventRecoParameters() : VecVariation[v].Par;
+        ZPreselCache::HashString(h, (v < 0) ? TString("") : VecVariation[v].Name);
+        // parameters field by field (add new fields of ZEventRecoParameters here)
+        const double values[] = { par.KinReco.zMassW, par.KinReco.zMassTop, par.KinReco.zLandauMean, par.KinReco.zLandauSigma,
+          par.JetPtMin, par.BTagDiscrMin };
+        static_assert(sizeof(values) == sizeof(ZEventRecoParameters), "ZEventRecoParameters field missing in Fingerprint()");
+        ZPreselCache::Hash(h, values, sizeof(values));
+        std::vector<ZVarHisto>& vecVarHisto = Histos(v);
+        for(int i = 0; i < vecVarHisto.size(); i++)
+        {
+          const ZFlatHisto& histo = vecVarHisto[i].H();
+          ZPreselCache::HashString(h, vecVarHisto[i].V());
+          ZPreselCache::HashString(h, histo.Name());
+          const int nBins = histo.NBins();
+          ZPreselCache::Hash(h, &nBins, sizeof(nBins));
+          for(int b = 1; b <= nBins + 1; b++)
+          {
+            const double edge = histo.LowEdge(b);
+            ZPreselCache::Hash(h, &edge, sizeof(edge));
+          }
+        }
+      }
+      return h;
+    }
+
+    // fingerprint stored in the output file for variation v (0 if the file 
+    // does not exist or has no fingerprint)
+    unsigned long long StoredFingerprint(const int v) const
+    {
+      struct stat st;
+      if(stat(OutFileName(v).Data(), &st) != 0)
+        return 0;
+      TFile* f = TFile::Open(OutFileName(v));
+      if(!f)
+        return 0;
+      TNamed* named = (TNamed*)f->Get("fingerprint");
+      unsigned long long fingerprint = named ? strtoull(named->GetTitle(), NULL, 16) : 0;
+      f->Close();
+      delete f;
+      return fingerprint;
+    }
+
+    // true if all output files exist and were produced with the same fingerprint
+    bool UpToDate()
+    {
+      const unsigned long long fingerprint = Fingerprint();
+      for(int v = -1; v < NVariations(); v++)
+        if(StoredFingerprint(v) != fingerprint)
+          return false;
+      return true;
+    }
+
+    // store histograms (nominal and variations) and the fingerprint in the output files
+    void WriteHistos()
+    {
+      TNamed fingerprint("fingerprint", TString::Format("%016llx", Fingerprint()));
+      for(int v = -1; v < NVariations(); v++)
+      {
+        TFile* fout = TFile::Open(OutFileName(v), "recreate");
+        fout->cd();
+        StoreHistos(Histos(v));
+        fingerprint.Write();
+#ifdef TTBAR_PROFILE
+        if(VecCutFlow.size() > v + 1)
+          VecCutFlow[v + 1]->Write();
+        if(Timing)
+          Timing->Write();
+#endif
+        fout->Close();
+        delete fout;
+      }
+    }
+
+    // free memory of all histograms (nominal and variations, e.g. after they 
+    // are stored; definitions are kept for Fingerprint())
+    void ReleaseHistos()
+    {
+      for(int v = -1; v < (int)VecVariation.size(); v++)
+      {
+        std::vector<ZVarHisto>& vecVarHisto = Histos(v);
+        for(int h = 0; h < vecVarHisto.size(); h++)
+          vecVarHisto[h].H().Release();
+      }
+    }
 };
 
 // >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
-// >>>>>>>>> Basic routine for ttbar event reconstruction >>>>>>>>>>>>>>
+// >>>>>>>>>> Event counters for one ZEventRecoInput >>>>>>>>>>>>>>>>>>>>
 // >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
-void eventreco(ZEventRecoInput in)
-{ 
-  printf("****** EVENTRECO ******\n");
-  printf("input sample: %s\n", in.Name.Data());
-  printf("type: %d   channel: %d\n", in.Type, in.Channel);
-  
-  // steering
-  // b-tagging discriminator for Combined Secondary Vertex Loose 
-  // (consult https://twiki.cern.ch/twiki/bin/view/CMSPublic/BtagRecommendation2011OpenData)
-  const double bTagDiscrL = 0.244; 
-  // directory for output ROOT files with histograms
-  TString outDir = gHistDir; 
+class ZEventRecoCounters
+{
+  public:
+    long NSel; // number of selected events
+    long NReco; // number of events with successfull kinematic reconstruction
+    long NGen; // number of events at generator level
+    std::vector<long> VecNSel, VecNReco; // NSel and NReco for systematic variations
+#ifdef TTBAR_PROFILE
+    ZCutFlow CutFlow; // preselection cut flow (see profile.h)
+#endif
 
+    // constructor
+    ZEventRecoCounters()
+    {
+      NSel = 0;
+      NReco = 0;
+      NGen = 0;
+    }
+
+    // counters of selected and reconstructed events for variation v (v = -1: nominal)
+    long& Sel(const int v)
+    {
+      Resize(v + 1);
+      return (v < 0) ? NSel : VecNSel[v];
+    }
+    long& Reco(const int v)
+    {
+      Resize(v + 1);
+      return (v < 0) ? NReco : VecNReco[v];
+    }
+
+    // add counters from another object
+    void Add(const ZEventRecoCounters& other)
+    {
+      NSel += other.NSel;
+      NReco += other.NReco;
+      NGen += other.NGen;
+#ifdef TTBAR_PROFILE
+      CutFlow.Add(other.CutFlow);
+#endif
+      Resize(other.VecNSel.size());
+      for(int v = 0; v < other.VecNSel.size(); v++)
+      {
+        VecNSel[v] += other.VecNSel[v];
+        VecNReco[v] += other.VecNReco[v];
+      }
+    }
+
+  private:
+    // make counters for n variations available
+    void Resize(const int n)
+    {
+      if(VecNSel.size() >= n)
+        return;
+      VecNSel.resize(n, 0);
+      VecNReco.resize(n, 0);
+    }
+};
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+// >>>>>>>>>> Stored histogram fill (for multi-threaded mode) >>>>>>>>>>>
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+//
+// Arguments of one FillHistos() call, stored by the worker threads 
+// and replayed later in the event order (see eventrecoPass() below)
+//
+class ZEventRecoFill
+{
+  public:
+    TLorentzVector T, Tbar; // top and antitop momenta
+    TLorentzVector LepM, LepP; // lepton- and lepton+ momenta (if Lep is true)
+    bool Lep; // true if lepton momenta are set
+    int Variation; // systematic variation (-1: nominal, see ZEventRecoInput::Histos())
+
+    // constructor (generator level, without leptons)
+    ZEventRecoFill(const TLorentzVector& t, const TLorentzVector& tbar)
+    {
+      T = t;
+      Tbar = tbar;
+      Lep = false;
+      Variation = -1;
+    }
+
+    // constructor (reco level, with leptons, for variation v)
+    ZEventRecoFill(const TLorentzVector& t, const TLorentzVector& tbar, const TLorentzVector& lepM, const TLorentzVector& lepP, const int v = -1)
+    {
+      T = t;
+      Tbar = tbar;
+      LepM = lepM;
+      LepP = lepP;
+      Lep = true;
+      Variation = v;
+    }
+};
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+// >>>>>>>>>> Results for one block of events (multi-threaded mode) >>>
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+class ZEventRecoBlock
+{
+  public:
+    long First; // first event of the block
+    long Last; // last event of the block (not included)
+    bool Done; // true if the block is processed (see ZEventRecoQueue below)
+    std::vector<ZEventRecoCounters> VecCounters; // event counters, one per input
+    std::vector<std::vector<ZEventRecoFill> > VecFill; // stored histogram fills, one container per input
+    ZPreselCache Cache; // preselected events of the block (if the cache is produced)
+};
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+// >>>>>>>>>> Queue of event blocks (multi-threaded mode) >>>>>>>>>>>>>>
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+//
+// Blocks are taken by the worker threads in the event order (see 
+// eventrecoWorker() below). A processed block is merged as soon as all 
+// previous blocks are merged: its counters are added, its stored fills 
+// are replayed into the histograms of the inputs and its preselected 
+// events are appended to the cache, i.e. everything is done in the event 
+// order as in the serial processing. The merge is done by the thread 
+// which completed the sequence (one thread at a time, the others continue 
+// processing), afterwards the block is freed. A thread does not take a 
+// new block while maxAhead blocks are not merged, so at most maxAhead 
+// blocks are kept in memory.
+//
+class ZEventRecoQueue
+{
+  private:
+    std::vector<ZEventRecoBlock> zVecBlock; // all blocks
+    int zNextBlock; // next block to be processed
+    int zNextMerge; // next block to be merged
+    int zMaxAhead; // maximum number of processed or taken blocks which are not merged
+    bool zMerging; // true if one thread is merging
+    std::mutex zMutex;
+    std::condition_variable zCondition; // signalled when zNextMerge is increased
+    // merge destination
+    std::vector<ZEventRecoInput*>& zVecIn;
+    std::vector<ZEventRecoCounters>& zVecCounters;
+    ZPreselCache* zCache; // NULL if the cache is not produced
+
+    // merge the block into the destination and free it
+    void Merge(ZEventRecoBlock& block)
+    {
+      if(zCache)
+        zCache->Append(block.Cache);
+      for(int i = 0; i < zVecIn.size(); i++)
+      {
+        ZEventRecoInput& in = *zVecIn[i];
+        zVecCounters[i].Add(block.VecCounters[i]);
+        const std::vector<ZEventRecoFill>& vecFill = block.VecFill[i];
+        for(int f = 0; f < vecFill.size(); f++)
+        {
+          const ZEventRecoFill& fill = vecFill[f];
+          if(fill.Lep)
+            FillHistos(in.Histos(fill.Variation), in.Weight, &fill.T, &fill.Tbar, &fill.LepM, &fill.LepP);
+          else
+            FillHistos(in.Histos(fill.Variation), in.Weight, &fill.T, &fill.Tbar);
+        }
+      }
+      std::vector<ZEventRecoCounters>().swap(block.VecCounters);
+      std::vector<std::vector<ZEventRecoFill> >().swap(block.VecFill);
+      block.Cache = ZPreselCache();
+    }
+
+  public:
+    // constructor: nEvents split into blocks of nEventsBlock events
+    // (cache: NULL if the cache is not produced)
+    ZEventRecoQueue(std::vector<ZEventRecoInput*>& vecIn, std::vector<ZEventRecoCounters>& vecCounters, ZPreselCache* cache, 
+      const long nEvents, const long nEventsBlock, const int maxAhead) :
+      zVecIn(vecIn), zVecCounters(vecCounters)
+    {
+      for(long first = 0; first < nEvents; first += nEventsBlock)
+      {
+        ZEventRecoBlock block;
+        block.First = first;
+        block.Last = TMath::Min(first + nEventsBlock, nEvents);
+        block.Done = false;
+        zVecBlock.push_back(block);
+      }
+      zNextBlock = 0;
+      zNextMerge = 0;
+      zMaxAhead = maxAhead;
+      zMerging = false;
+      zCache = cache;
+    }
+
+    // take the next block to be processed (waits if too many blocks are not merged), 
+    // NULL if all blocks are taken
+    ZEventRecoBlock* Take()
+    {
+      std::unique_lock<std::mutex> lock(zMutex);
+      while(zNextBlock < zVecBlock.size() && zNextBlock >= zNextMerge + zMaxAhead)
+        zCondition.wait(lock);
+      if(zNextBlock >= zVecBlock.size())
+        return NULL;
+      return &zVecBlock[zNextBlock++];
+    }
+
+    // mark the block as processed and merge all blocks which can be merged
+    // (if no other thread is merging)
+    void Finish(ZEventRecoBlock* block)
+    {
+      std::unique_lock<std::mutex> lock(zMutex);
+      block->Done = true;
+      if(zMerging)
+        return;
+      zMerging = true;
+      while(zNextMerge < zVecBlock.size() && zVecBlock[zNextMerge].Done)
+      {
+        ZEventRecoBlock& next = zVecBlock[zNextMerge];
+        lock.unlock();
+        Merge(next);
+        lock.lock();
+        zNextMerge++;
+        zCondition.notify_all();
+      }
+      zMerging = false;
+    }
+
+    // true if all blocks are merged
+    bool Merged()
+    {
+      std::lock_guard<std::mutex> lock(zMutex);
+      return zNextMerge == zVecBlock.size();
+    }
+};
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+// >>>>>>>>> Reconstruction of one event for one ZEventRecoInput >>>>>>
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+//
+// The routine is specialised at compile time for the sample type, 
+// generator or reco level and decay channel of the input (template 
+// arguments, the same meaning as ZEventRecoInput::Type, Gen and Channel, 
+// which are not checked per event): e.g. the MC truth filter and 
+// generator level code are compiled away for data, the trigger mask and 
+// dilepton selection are fixed for the channel (see SelectEvent() in 
+// selection.h). The specialisation for the input is found once per pass, 
+// see FindRecoEventFunction() below.
+// Arguments:
+//   ZEventRecoInput& in: steering (histograms are filled if the event is accepted)
+//   ZEventPresel& presel: event from the input tree or from the cache (see preselCache.h)
+//   ZEventRecoCounters& counters: event counters to be incremented
+//   TH1D* hInacc, TH1D* hAmbig: kinematic reconstruction debugging histograms (see kinReco.h)
+//   std::vector<ZEventRecoFill>* vecFill: if not NULL, histograms are not 
+//          filled, instead the fill is stored in this container (multi-threaded mode)
+//
+template<int type, bool gen, int channel>
+void RecoEvent(ZEventRecoInput& in, ZEventPresel& presel, ZEventRecoCounters& counters, TH1D* hInacc, TH1D* hAmbig, 
+  std::vector<ZEventRecoFill>* vecFill)
+{
   // this flag determines whether generator level information is available
   // (should be available for signal MC)
-  bool flagMC = (in.Type == 2 || in.Type == 3);
+  constexpr bool flagMC = (type == 2 || type == 3);
+
+  if(flagMC)
+  {
+    // skip background events for MC signal
+    if(type == 2 && presel.McEventType != channel)
+    {
+      PROFILE_COUNT(counters, ZCutFlow::cutEvents);
+      return;
+    }
+    // skip signal events for MC 'ttbar other' (background)
+    if(type == 3 && presel.McEventType == channel)
+    {
+      PROFILE_COUNT(counters, ZCutFlow::cutEvents);
+      return;
+    }
+  }
+  // process generator level if needed
+  if(gen)
+  {
+    // prepare four vectors for top and antitop
+    TLorentzVector t, tbar;
+    t.SetXYZM(presel.McT[0], presel.McT[1], presel.McT[2], presel.McT[3]);
+    tbar.SetXYZM(presel.McTbar[0], presel.McTbar[1], presel.McTbar[2], presel.McTbar[3]);
+    // fill histos (or store the fill)
+    double w = in.Weight;
+    if(vecFill)
+      vecFill->push_back(ZEventRecoFill(t, tbar));
+    else
+      FillHistos(in.VecVarHisto, w, &t, &tbar);
+    counters.NGen++;
+    PROFILE_COUNT(counters, ZCutFlow::cutTruth);
+    return;
+  }
+  if(type > 1)
+    counters.NGen++;
   
-  // output file
-  TFile* fout = TFile::Open(TString::Format("%s/%s-c%d.root", outDir.Data(), in.Name.Data(), in.Channel), "recreate");
+  // process reco level if needed:
+  // event preselection (see SelectEvent() in selection.h, done once per 
+  // event and channel for all inputs)
+  const ZPreselEvent* ev = presel.Get<channel>();
+  PROFILE_COUNT(counters, presel.LastCut(channel));
+  if(!ev)
+    return;
+  // lepton context of kinematic reconstruction (see kinReco.h), 
+  // shared by the nominal parameters and all variations
+  ZKinRecoDileptonLeptons leptons(ev->LepM, ev->LepP, ev->MetPx, ev->MetPy);
+  // loop over nominal parameters (v = -1) and systematic variations, 
+  // jets are selected again only if their thresholds change
+  std::vector<ZPxPyPzE> vecJets;
+  bool selJets = false;
+  double jetPtMin = -1.0;
+  double bTagDiscrMin = -1.0;
+  for(int v = -1; v < (int)in.VecVariation.size(); v++)
+  {
+    const ZEventRecoParameters par = (v < 0) ? ZEventRecoParameters() : in.VecVariation[v].Par;
+    if(par.JetPtMin != jetPtMin || par.BTagDiscrMin != bTagDiscrMin)
+    {
+      jetPtMin = par.JetPtMin;
+      bTagDiscrMin = par.BTagDiscrMin;
+      // at least two jets with at least one b-tagged jet (see SelectJets() in selection.h)
+      PROFILE_TIMER(stageJets);
+      selJets = SelectJets(*ev, jetPtMin, bTagDiscrMin, vecJets);
+    }
+    if(!selJets)
+      continue;
+    // event selection done: increment the counter of selected events
+    counters.Sel(v)++;
   
-  // input tree
+    // now run kinematic reconstruction to restore the top and antitop momenta
+    ZPxPyPzE t, tbar;
+    // call main routine, see kinReco.h for description
+    // (debugging histograms are filled for nominal parameters only)
+    leptons.SetParameters(par.KinReco);
+    int status = KinRecoDilepton(leptons, vecJets, t, tbar, (v < 0) ? hInacc : NULL, (v < 0) ? hAmbig : NULL);
+    // returned status is 1 for successfull kinreco, 0 otherwise
+    // t, tbar are vectors with single "best" solution (if kinreco was successfull)
+    //printf("STATUS: %d\n", status);
+    if(status > 0) // successfull kinreco
+    {
+      // print the top and antitop momenta, if needed
+      //printf("top:      (%8.3f  %8.3f  %8.3f  %8.3f)\n", t.X(), t.Y(), t.Z(), t.M());
+      //printf("antitop:  (%8.3f  %8.3f  %8.3f  %8.3f)\n", tbar.X(), tbar.Y(), tbar.Z(), tbar.M());
+      counters.Reco(v)++;
+      
+      // fill histograms (or store the fill),
+      // four-vectors are converted to TLorentzVector for FillHistos()
+      double w = in.Weight;
+      ZEventRecoFill fill(t, tbar, ev->LepM, ev->LepP, v);
+      if(vecFill)
+        vecFill->push_back(fill);
+      else
+        FillHistos(in.Histos(v), w, &fill.T, &fill.Tbar, &fill.LepM, &fill.LepP);
+    } // end kinreco
+  } // end loop over variations
+}
+
+// specialisation of RecoEvent() for one input
+typedef void (*ZRecoEventFunction)(ZEventRecoInput& in, ZEventPresel& presel, ZEventRecoCounters& counters, 
+  TH1D* hInacc, TH1D* hAmbig, std::vector<ZEventRecoFill>* vecFill);
+
+// return the specialisation of RecoEvent() for the channel
+template<int type, bool gen>
+ZRecoEventFunction FindRecoEventFunction(const int channel)
+{
+  switch(channel)
+  {
+    case 1: return RecoEvent<type, gen, 1>;
+    case 2: return RecoEvent<type, gen, 2>;
+    case 3: return RecoEvent<type, gen, 3>;
+  }
+  printf("Error: unknown channel %d\n", channel);
+  exit(1);
+}
+
+// return the specialisation of RecoEvent() for the input (type, generator or reco level, channel)
+ZRecoEventFunction FindRecoEventFunction(const ZEventRecoInput& in)
+{
+  switch(in.Type)
+  {
+    case 1: return in.Gen ? FindRecoEventFunction<1, true>(in.Channel) : FindRecoEventFunction<1, false>(in.Channel);
+    case 2: return in.Gen ? FindRecoEventFunction<2, true>(in.Channel) : FindRecoEventFunction<2, false>(in.Channel);
+    case 3: return in.Gen ? FindRecoEventFunction<3, true>(in.Channel) : FindRecoEventFunction<3, false>(in.Channel);
+    case 4: return in.Gen ? FindRecoEventFunction<4, true>(in.Channel) : FindRecoEventFunction<4, false>(in.Channel);
+  }
+  printf("Error: unknown type %d\n", in.Type);
+  exit(1);
+}
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+// >>>>>>>>>>>>>>>>>>>> Prepare input tree >>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+//
+// Creates chain with provided input files and ZTree attached to it 
+// (chain is accessible as ZTree::fChain). 
+// flagMC: if true, generator level branches are read; 
+// flagReco: if true, branches needed for reco level are read.
+// Only the needed branches are enabled (see ZTree::SetReadSet()).
+//
+ZTree* MakeTree(const std::vector<TString>& vecInFile, bool flagMC, bool flagReco)
+{
   TChain* chain = new TChain("tree");
-  for(int f = 0; f < in.VecInFile.size(); f++)
-    chain->Add(in.VecInFile[f]);
+  for(int f = 0; f < vecInFile.size(); f++)
+    chain->Add(vecInFile[f]);
   ZTree* preselTree = new ZTree(flagMC);
   preselTree->Init(chain);
 
-  // process generator level, if needed
-  if(in.Gen)
+  // read only needed branches
+  int readSet = 0;
+  if(flagMC)
+    readSet |= ZTree::readGen;
+  if(flagReco)
+    readSet |= ZTree::readReco;
+  preselTree->SetReadSet(readSet);
+  return preselTree;
+}
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+// >>>>>>>>>> Worker thread for eventrecoPass() >>>>>>>>>>>>>>>>>>>>>>>>
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+//
+// Processes blocks of events from the queue until all are done. Each thread 
+// has its own chain, ZTree and kinematic reconstruction debugging histograms; 
+// the fills are stored in the blocks (as well as the preselected events, if 
+// flagCache is true) and are merged into the inputs in the event order 
+// (see ZEventRecoQueue above).
+//
+void eventrecoWorker(std::vector<ZEventRecoInput*>& vecIn, const std::vector<ZRecoEventFunction>& vecRecoEvent, 
+  ZEventRecoQueue& queue, bool flagMC, bool flagReco, bool flagCache, TH1D* hInacc, TH1D* hAmbig)
+{
+  ZTree* preselTree = MakeTree(vecIn[0]->VecInFile, flagMC, flagReco);
+  while(ZEventRecoBlock* ptrBlock = queue.Take())
   {
-    chain->SetBranchStatus("*", 0);
-    chain->SetBranchStatus("mcEventType", 1);
-    chain->SetBranchStatus("mcT", 1);
-    chain->SetBranchStatus("mcTbar", 1);
+    ZEventRecoBlock& block = *ptrBlock;
+    block.VecCounters.resize(vecIn.size());
+    block.VecFill.resize(vecIn.size());
+    for(long e = block.First; e < block.Last; e++)
+    {
+      {
+        PROFILE_TIMER(stageRead);
+        preselTree->fChain->GetEntry(e);
+      }
+      ZEventPresel presel(preselTree, flagMC);
+      for(int i = 0; i < vecIn.size(); i++)
+      {
+        if(e >= vecIn[i]->MaxNEvents)
+          continue;
+        vecRecoEvent[i](*vecIn[i], presel, block.VecCounters[i], hInacc, hAmbig, &block.VecFill[i]);
+      }
+      if(flagCache)
+        block.Cache.Add(e, presel, flagMC, flagReco);
+    }
+    queue.Finish(ptrBlock);
+  }
+  delete preselTree->fChain;
+  delete preselTree;
+  PROFILE_COLLECT();
+}
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+// >>>>>> Single pass ttbar event reconstruction for many inputs >>>>>>>>
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+//
+// All provided ZEventRecoInput objects must have the same input files: 
+// the chain is read only once and each event is passed to all of them 
+// (e.g. ee, mumu and emu channels, or MC signal, 'ttbar other' and 
+// generator level for the same TTJets sample). Each ZEventRecoInput 
+// still produces its own output file <Name>-c<Channel>.root.
+//
+// If nThreads > 1, events are split into blocks of fixed size which are 
+// processed by nThreads parallel threads (see eventrecoWorker() above). 
+// The stored fills are replayed block by block, i.e. in the same order 
+// as in the serial processing, while the threads are running (see 
+// ZEventRecoQueue above): produced histograms are identical to those 
+// with nThreads = 1, independently of the number of threads.
+//
+// If flagCache is true, the preselected event cache for the input files 
+// (see preselCache.h) is read instead of the input tree, if it exists; 
+// otherwise it is produced in this pass (if all events are processed). 
+// The produced histograms are the same with and without the cache.
+//
+// If compiled with -DTTBAR_PROFILE, the time spent in each stage and the 
+// cut flow of each input are printed and stored in the output files (see 
+// profile.h); the cache is not used then, to measure the full processing
+// (as well as incremental skipping, see eventrecoMulti() below).
+//
+void eventrecoPass(std::vector<ZEventRecoInput*>& vecIn, int nThreads = 1, bool flagCache = false)
+{ 
+  // number of events in one block (multi-threaded mode)
+  const long nEventsBlock = 10000;
+#ifdef TTBAR_PROFILE
+  gProfile.Reset();
+  const long long profileStart = ProfileTicks();
+  if(flagCache)
+  {
+    printf("profiling: preselection cache is not used\n");
+    flagCache = false;
+  }
+#endif
+
+  // generator level information is needed if there is at least one MC 
+  // signal or 'ttbar other' input; branches other than generator level 
+  // are needed if there is at least one reco level input
+  bool flagMC = false;
+  bool flagReco = false;
+  // the pass should process as many events as the largest requested number
+  // (the cache can be used only if all inputs need all events)
+  long maxNEvents = 0;
+  long minNEvents = vecIn[0]->MaxNEvents;
+  // specialisation of RecoEvent() for each input
+  std::vector<ZRecoEventFunction> vecRecoEvent;
+  for(int i = 0; i < vecIn.size(); i++)
+  {
+    ZEventRecoInput& in = *vecIn[i];
+    printf("****** EVENTRECO ******\n");
+    printf("input sample: %s\n", in.Name.Data());
+    printf("type: %d   channel: %d\n", in.Type, in.Channel);
+    if(in.VecInFile != vecIn[0]->VecInFile)
+    {
+      printf("Error: all inputs in one pass should have the same input files\n");
+      exit(1);
+    }
+    // jets below the nominal threshold are not preselected (see SelectJets() in selection.h)
+    for(int v = 0; v < in.NVariations(); v++)
+      if(in.VecVariation[v].Par.JetPtMin < gSelectionCuts.JetPtMin)
+      {
+        printf("Error: variation %s has jet pT threshold %.2f below the nominal %.2f\n", in.VecVariation[v].Name.Data(), 
+          in.VecVariation[v].Par.JetPtMin, gSelectionCuts.JetPtMin);
+        exit(1);
+      }
+    if(in.Type == 2 || in.Type == 3)
+      flagMC = true;
+    if(!in.Gen)
+      flagReco = true;
+    if(in.MaxNEvents > maxNEvents)
+      maxNEvents = in.MaxNEvents;
+    if(in.MaxNEvents < minNEvents)
+      minNEvents = in.MaxNEvents;
+    vecRecoEvent.push_back(FindRecoEventFunction(in));
   }
-    
-  // event counters
-  long nSel = 0;
-  long nReco = 0;
-  int nGen = 0;
+  
+  // event counters (one set per input)
+  std::vector<ZEventRecoCounters> vecCounters(vecIn.size());
   
   // histograms for kinematic reconstruction debugging
   // (not needed in physics analysis, not stored)
   TH1D* hInacc = new TH1D("hInacc", "KinReco inaccuracy", 1000, 0.0, 100.0);
   TH1D* hAmbig = new TH1D("hAmbig", "KinReco ambiguity", 100, 0.0, 100.0);
 
-  // determine number of events
-  long nEvents = chain->GetEntries();
-  //limit it if exceeds the specified maximum number
-  if(nEvents > in.MaxNEvents)
-    nEvents = in.MaxNEvents;
-  printf("nEvents: %ld\n", nEvents);
-  // event loop
-  for(int e = 0; e < nEvents; e++)
+  // preselected event cache: the key depends on input files, selection and stored content
+  // (generator level information is stored if needed, events selected in all channels are stored)
+  unsigned long long cacheKey = flagCache ? ZPreselCache::MakeKey(vecIn[0]->VecInFile, flagMC, flagReco) : 0;
+  TString cacheName = TString::Format("%s/presel-%016llx.bin", gCacheDir.Data(), cacheKey);
+  ZPreselCache cache(cacheKey);
+  bool flagCacheRead = false;
+  if(flagCache && cache.Read(cacheName))
   {
-    chain->GetEntry(e);
-    if(flagMC)
-    {
-      // skip background events for MC signal
-      if(in.Type == 2 && preselTree->mcEventType != in.Channel) continue;
-      // skip signal events for MC 'ttbar other' (background)
-      if(in.Type == 3 && preselTree->mcEventType == in.Channel) continue;
-    }
-    // process generator level if needed
-    if(in.Gen)
-    {
-      // prepare four vectors for top and antitop
-      TLorentzVector t, tbar;
-      t.SetXYZM(preselTree->mcT[0], preselTree->mcT[1], preselTree->mcT[2], preselTree->mcT[3]);
-      tbar.SetXYZM(preselTree->mcTbar[0], preselTree->mcTbar[1], preselTree->mcTbar[2], preselTree->mcTbar[3]);
-      // fill histos
-      double w = in.Weight;
-      FillHistos(in.VecVarHisto, w, &t, &tbar);
-      nGen++;
-      continue;
+    if(cache.NEvents() <= minNEvents)
+      flagCacheRead = true;
+    else
+      flagCache = false; // limited number of events: use the input tree (keep the cache)
+  }
+  if(flagCacheRead)
+  {
+    printf("preselection cache: %s\n", cacheName.Data());
+    printf("nEvents: %lld (stored: %lld)\n", cache.NEvents(), cache.NRecords());
+    // event loop over stored events
+    for(long long r = 0; r < cache.NRecords(); r++)
+    {
+      ZEventPresel presel;
+      cache.Get(r, presel);
+      for(int i = 0; i < vecIn.size(); i++)
+        vecRecoEvent[i](*vecIn[i], presel, vecCounters[i], hInacc, hAmbig, NULL);
     }
-    if(in.Type > 1)
-      nGen++;
-    
-    // process reco level if needed
-    //
-    // primary vertex selection
-    if(preselTree->Npv < 1 || preselTree->pvNDOF < 4 || preselTree->pvRho > 2.0 || TMath::Abs(preselTree->pvZ) > 24.0)
-      continue;
-    // primary dataset name
-    TString inFile = chain->GetCurrentFile()->GetName();
-    // select dilepton pair
-    TLorentzVector vecLepM, vecLepP;
-    double maxPtDiLep = -1.0; // initialise with a negative value to determine later on whether a dilepton pair is found in the event
-    bool trig = false;
-    // *****************************************
-    // ***************** emu *******************
-    // *****************************************
-    if(in.Channel == 3)
-    {
-      // trigger: 12th to 17th bits
-      // (accept the event if at least one needed trigger bit is fired) 
-      for(int bit = 12; bit < 17; bit++)
-        if((preselTree->Triggers >> bit) & 1)
-        {
-          trig = true;
-          break;
-        }
-      // call dileption selection routine (see selection.h for description)
-      if(trig)
-        SelectDilepEMu(preselTree, vecLepM, vecLepP, maxPtDiLep);
-    }
-    // *****************************************
-    // ***************** ee ********************
-    // *****************************************
-    if(in.Channel == 1)
-    {
-      // trigger: 6th to 11th bits
-      for(int bit = 6; bit < 11; bit++)
-        if((preselTree->Triggers >> bit) & 1)
+    // generator level events are counted for all events, not only the stored ones
+    for(int i = 0; i < vecIn.size(); i++)
+    {
+      ZEventRecoInput& in = *vecIn[i];
+      if(in.Type == 2)
+        vecCounters[i].NGen = cache.NEventsType(in.Channel);
+      else if(in.Type == 3)
+        vecCounters[i].NGen = cache.NEvents() - cache.NEventsType(in.Channel);
+      else if(in.Type == 4)
+        vecCounters[i].NGen = cache.NEvents();
+    }
+  }
+  else
+  {
+    // input tree
+    ZTree* preselTree = MakeTree(vecIn[0]->VecInFile, flagMC, flagReco);
+    TTree* chain = preselTree->fChain;
+    // determine number of events
+    long nEvents = chain->GetEntries();
+    // the cache is produced only if all events are processed
+    if(nEvents > minNEvents)
+      flagCache = false;
+    //limit it if exceeds the specified maximum number
+    if(nEvents > maxNEvents)
+      nEvents = maxNEvents;
+    printf("nEvents: %ld\n", nEvents);
+    if(nThreads <= 1)
+    {
+      // event loop
+      for(long e = 0; e < nEvents; e++)
+      {
         {
-          trig = true;
-          break;
+          PROFILE_TIMER(stageRead);
+          chain->GetEntry(e);
         }
-      double met = TMath::Sqrt(TMath::Power(preselTree->metPx, 2.0) + TMath::Power(preselTree->metPy, 2.0));
-      // additional requirement on the missing transverse energy
-      if(trig && met > 30.0)
-        SelectDilepEE(preselTree, vecLepM, vecLepP, maxPtDiLep);
-    }
-    // *****************************************
-    // **************** mumu *******************
-    // *****************************************
-    if(in.Channel == 2)
-    {
-      // trigger: 0th to 5th bits
-      for(int bit = 0; bit < 5; bit++)
-        if((preselTree->Triggers >> bit) & 1)
+        // pass this event to all inputs
+        ZEventPresel presel(preselTree, flagMC);
+        for(int i = 0; i < vecIn.size(); i++)
         {
-          trig = true;
-          break;
+          if(e >= vecIn[i]->MaxNEvents)
+            continue;
+          vecRecoEvent[i](*vecIn[i], presel, vecCounters[i], hInacc, hAmbig, NULL);
         }
-      double met = TMath::Sqrt(TMath::Power(preselTree->metPx, 2.0) + TMath::Power(preselTree->metPy, 2.0));
-      // additional requirement on the missing transverse energy
-      if(trig && met > 30.0)
-        SelectDilepMuMu(preselTree, vecLepM, vecLepP, maxPtDiLep);
+        if(flagCache)
+          cache.Add(e, presel, flagMC, flagReco);
+      } // end event loop
     }
-    // check if there is a dilepton pair found, otherwise skip the event
-    if(maxPtDiLep < 0.0)
-      continue;
-    // dilepton pair found, now select jets; 
-    // all jets are stored for kinematic reconstruction
-    std::vector<TLorentzVector> vecJets;
-    bool oneBTagJet = false;
-    for(int j = 0; j < preselTree->Njet; j++)
+    else
     {
-      if(TMath::Abs(preselTree->jetEta[j]) > 2.4)
-        continue;
-      TLorentzVector vecJet;
-      vecJet.SetPtEtaPhiM(preselTree->jetPt[j], preselTree->jetEta[j], preselTree->jetPhi[j], preselTree->jetMass[j]);
-      // subtract muon and electron energy fractions
-      double corrE = vecJet.E() - preselTree->jetMuEn[j] - preselTree->jetElEn[j];
-      double corrPt = preselTree->jetPt[j] * corrE / vecJet.E();\
-      // require pT(jet) > 30 GeV
-      if(corrPt < 30.0)
-        continue;
-      TLorentzVector corrVec;
-      corrVec.SetPtEtaPhiE(corrPt, preselTree->jetEta[j], preselTree->jetPhi[j], corrE);
-      // b-tagging: check if there at least one b-tagged jet
-      // for b-tagged jet make the jet mass negative: this is for proper 
-      // identification of b-tagged jets in the kinematic reconstruction
-      if(preselTree->jetBTagDiscr[j] > bTagDiscrL)
+      printf("nThreads: %d\n", nThreads);
+      ROOT::EnableThreadSafety();
+      // queue of blocks: at most two blocks per thread are not merged
+      ZEventRecoQueue queue(vecIn, vecCounters, flagCache ? &cache : NULL, nEvents, nEventsBlock, 2 * nThreads);
+      // start threads, each with its own debugging histograms
+      std::vector<std::thread> vecThread;
+      std::vector<TH1D*> vecHInacc, vecHAmbig;
+      for(int t = 0; t < nThreads; t++)
+      {
+        vecHInacc.push_back(new TH1D(*hInacc));
+        vecHInacc.back()->SetDirectory(0);
+        vecHAmbig.push_back(new TH1D(*hAmbig));
+        vecHAmbig.back()->SetDirectory(0);
+        vecThread.push_back(std::thread(eventrecoWorker, std::ref(vecIn), std::cref(vecRecoEvent), std::ref(queue), 
+          flagMC, flagReco, flagCache, vecHInacc.back(), vecHAmbig.back()));
+      }
+      for(int t = 0; t < nThreads; t++)
       {
-        corrVec.SetPtEtaPhiM(corrVec.Pt(), corrVec.Eta(), corrVec.Phi(), -1 * corrVec.M());
-        oneBTagJet = true;
+        vecThread[t].join();
+        hInacc->Add(vecHInacc[t]);
+        hAmbig->Add(vecHAmbig[t]);
+        delete vecHInacc[t];
+        delete vecHAmbig[t];
+      }
+      if(!queue.Merged())
+      {
+        printf("Error: not all blocks of events are merged\n");
+        exit(1);
       }
-      vecJets.push_back(corrVec);
     }
-    // if there are no two jets, skip the event
-    if(vecJets.size() < 2)
-      continue;
-    // require at least one b-tagged jet
-    if(!oneBTagJet)
-      continue;
-    // event selection done: increment the counter of selected events
-    nSel++;
-    
-    // now run kinematic reconstruction to restore the top and antitop momenta
-    TLorentzVector t, tbar;
-    // call main routine, see kinReco.h for description
-    int status = KinRecoDilepton(vecLepM, vecLepP, vecJets, preselTree->metPx, preselTree->metPy, t, tbar, hInacc, hAmbig);
-    // returned status is 1 for successfull kinreco, 0 otherwise
-    // t, tbar are vectors with single "best" solution (if kinreco was successfull)
-    //printf("STATUS: %d\n", status);
-    if(status > 0) // successfull kinreco
+  
+    // store the cache
+    if(flagCache)
     {
-      // print the top and antitop momenta, if needed
-      //printf("top:      (%8.3f  %8.3f  %8.3f  %8.3f)\n", t.X(), t.Y(), t.Z(), t.M());
-      //printf("antitop:  (%8.3f  %8.3f  %8.3f  %8.3f)\n", tbar.X(), tbar.Y(), tbar.Z(), tbar.M());
-      nReco++;
-      
-      // fill histograms
-      double w = in.Weight;
-      FillHistos(in.VecVarHisto, w, &t, &tbar, &vecLepM, &vecLepP);
-    } // end kinreco
-  } // end event loop
+      if(cache.Write(cacheName))
+        printf("preselection cache written: %s (stored: %lld)\n", cacheName.Data(), cache.NRecords());
+      else
+        printf("Warning: cannot write preselection cache %s\n", cacheName.Data());
+    }
+    delete chain;
+    delete preselTree;
+  }
+#ifdef TTBAR_PROFILE
+  PROFILE_COLLECT();
+  const double profileWall = (ProfileTicks() - profileStart) * ProfileSecondsPerTick();
+  ProfilePrint(gProfile, profileWall);
+#endif
   
-  // print the numbers of selected events and events with successfull kinematic reconstruction
-  printf("nSel  : %ld\n", nSel);
-  printf("nReco : %ld\n", nReco);
-  // for signal MC, print the number of signal events at generator level and detector efficiency
-  // (with and without kinematic reconstruction)
-  if(in.Type == 2) 
+  for(int i = 0; i < vecIn.size(); i++)
   {
-    printf("nGen  : %ld\n", nGen);
-    printf("C = %.2f%% (no KINRECO %.2f%%)\n", 100. * nReco / nGen, 100. * nSel / nGen);
+    ZEventRecoInput& in = *vecIn[i];
+    const ZEventRecoCounters& counters = vecCounters[i];
+    // print the numbers of selected events and events with successfull kinematic reconstruction
+    printf("****** %s-c%d ******\n", in.Name.Data(), in.Channel);
+    printf("nSel  : %ld\n", counters.NSel);
+    printf("nReco : %ld\n", counters.NReco);
+    // for signal MC, print the number of signal events at generator level and detector efficiency
+    // (with and without kinematic reconstruction)
+    if(in.Type == 2) 
+    {
+      printf("nGen  : %ld\n", counters.NGen);
+      printf("C = %.2f%% (no KINRECO %.2f%%)\n", 100. * counters.NReco / counters.NGen, 100. * counters.NSel / counters.NGen);
+    }
+    // the same for systematic variations (reco level only)
+    for(int v = 0; v < in.NVariations(); v++)
+    {
+      printf("****** %s_%s-c%d ******\n", in.Name.Data(), in.VecVariation[v].Name.Data(), in.Channel);
+      printf("nSel  : %ld\n", vecCounters[i].Sel(v));
+      printf("nReco : %ld\n", vecCounters[i].Reco(v));
+    }
+
+#ifdef TTBAR_PROFILE
+    // cut flow (nominal and variations) and timing of the pass
+    for(int v = -1; v < in.NVariations(); v++)
+    {
+      ZEventRecoCounters& c = vecCounters[i];
+      printf("****** cut flow %s-c%d%s ******\n", in.Name.Data(), in.Channel, (v < 0) ? "" : ("_" + in.VecVariation[v].Name).Data());
+      c.CutFlow.Print(c.Sel(v), c.Reco(v));
+      in.VecCutFlow.push_back(c.CutFlow.Histo(c.Sel(v), c.Reco(v)));
+    }
+    in.Timing = ProfileTimingHisto(gProfile, profileWall);
+#endif
+    // output files: store histograms, then free them
+    in.WriteHistos();
+    in.ReleaseHistos();
+#ifdef TTBAR_PROFILE
+    for(int h = 0; h < in.VecCutFlow.size(); h++)
+      delete in.VecCutFlow[h];
+    in.VecCutFlow.clear();
+    delete in.Timing;
+    in.Timing = NULL;
+#endif
   }
+  delete hInacc;
+  delete hAmbig;
+}
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+// >>>>>>>>> Basic routine for ttbar event reconstruction >>>>>>>>>>>>>>
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+void eventreco(ZEventRecoInput& in)
+{ 
+  std::vector<ZEventRecoInput*> vecIn(1, &in);
+  eventrecoPass(vecIn);
+}
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
 
-  // store histograms, close output file
-  fout->cd();
-  StoreHistos(in.VecVarHisto);
-  fout->Close();
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+// >>>>>>>>> Event reconstruction for many inputs >>>>>>>>>>>>>>>>>>>>>>>
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+//
+// If flagSinglePass is true, inputs with the same input files are 
+// grouped and each group is processed in one pass (see eventrecoPass() 
+// above), otherwise each input is processed separately, as eventreco().
+// nThreads is the number of threads for each pass, flagCache enables 
+// preselected event cache (see eventrecoPass() above).
+// If flagIncremental is true, inputs with up-to-date output files (see 
+// ZEventRecoInput::UpToDate() above) are skipped (not if compiled with 
+// -DTTBAR_PROFILE: all inputs are processed to be measured).
+//
+void eventrecoMulti(std::vector<ZEventRecoInput>& vecIn, bool flagSinglePass = true, int nThreads = 1, bool flagCache = false, bool flagIncremental = false)
+{
+#ifdef TTBAR_PROFILE
+  if(flagIncremental)
+  {
+    printf("profiling: up-to-date inputs are not skipped\n");
+    flagIncremental = false;
+  }
+#endif
+  std::vector<bool> done(vecIn.size(), false);
+  for(int i = 0; i < vecIn.size() && flagIncremental; i++)
+  {
+    done[i] = vecIn[i].UpToDate();
+    if(done[i])
+      printf("input sample: %s-c%d is up to date, skipped\n", vecIn[i].Name.Data(), vecIn[i].Channel);
+  }
+  for(int i = 0; i < vecIn.size(); i++)
+  {
+    if(done[i])
+      continue;
+    std::vector<ZEventRecoInput*> vecPass(1, &vecIn[i]);
+    done[i] = true;
+    for(int j = i + 1; flagSinglePass && j < vecIn.size(); j++)
+    {
+      if(done[j] || vecIn[j].VecInFile != vecIn[i].VecInFile)
+        continue;
+      vecPass.push_back(&vecIn[j]);
+      done[j] = true;
+    }
+    eventrecoPass(vecPass, nThreads, flagCache);
+  }
 }
 
 #endif
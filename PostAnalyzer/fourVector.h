@@ -0,0 +1,145 @@
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+// >>>>>>>>>>>>> Helper for four-vectors (lightweight) >>>>>>>>>>>>>>>>>>
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+// ZPxPyPzE is a plain value type (no virtual table, no dynamic memory)
+// used instead of TLorentzVector in the selection -> kinematic
+// reconstruction chain (selection.h, eventReco.h, kinReco.h).
+// All methods use the same formulas as TLorentzVector, so the results
+// are the same bit by bit: e.g. Pt() is always calculated from px and py,
+// also for a vector created from pT, eta and phi. Therefore pT, eta and
+// phi are not cached: the input values (from the ntuples) differ in the
+// last bits from the ones calculated from the components, which can change
+// selection results, and caching the calculated values would make each
+// vector larger to save only a square root in the few places where pT is
+// used repeatedly (these keep it themselves, e.g. ZLeptonCandidates in
+// selection.h). The trigonometric functions are evaluated only once, when
+// the vector is created.
+// Jet b-tagging is stored explicitly.
+// It is implicitly converted to TLorentzVector (e.g. for FillHistos()).
+
+#ifndef TTBAR_FOURVECTOR_H
+#define TTBAR_FOURVECTOR_H
+
+// C++ library or ROOT header files
+#include <TMath.h>
+#include <TLorentzVector.h>
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+// >>>>>>>>>>>>>>>>>>>>>>>>>> ZPxPyPzE >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+struct ZPxPyPzE
+{
+  // constructor (from momentum components and energy)
+  constexpr ZPxPyPzE(const double px = 0.0, const double py = 0.0, const double pz = 0.0, const double e = 0.0, const bool bTag = false):
+    zPx(px), zPy(py), zPz(pz), zE(e), zBTag(bTag) {;}
+
+  // constructor from TLorentzVector
+  explicit ZPxPyPzE(const TLorentzVector& v):
+    zPx(v.X()), zPy(v.Y()), zPz(v.Z()), zE(v.E()), zBTag(false) {;}
+
+  // create from pT, eta, phi and mass (as TLorentzVector::SetPtEtaPhiM())
+  static ZPxPyPzE PtEtaPhiM(const double pt, const double eta, const double phi, const double m, const bool bTag = false)
+  {
+    ZPxPyPzE v;
+    v.SetPtEtaPhiM(pt, eta, phi, m);
+    v.zBTag = bTag;
+    return v;
+  }
+
+  // create from pT, eta, phi and energy (as TLorentzVector::SetPtEtaPhiE())
+  static ZPxPyPzE PtEtaPhiE(const double pt, const double eta, const double phi, const double e, const bool bTag = false)
+  {
+    ZPxPyPzE v;
+    v.SetPtEtaPhiE(pt, eta, phi, e);
+    v.zBTag = bTag;
+    return v;
+  }
+
+  // setters (the same as in TLorentzVector)
+  void SetXYZT(const double x, const double y, const double z, const double t)
+  {
+    zPx = x;
+    zPy = y;
+    zPz = z;
+    zE = t;
+  }
+  void SetXYZM(const double x, const double y, const double z, const double m)
+  {
+    if(m >= 0)
+      SetXYZT(x, y, z, TMath::Sqrt(x * x + y * y + z * z + m * m));
+    else
+      SetXYZT(x, y, z, TMath::Sqrt(TMath::Max((x * x + y * y + z * z - m * m), 0.)));
+  }
+  void SetPtEtaPhiM(double pt, const double eta, const double phi, const double m)
+  {
+    pt = TMath::Abs(pt);
+    SetXYZM(pt * TMath::Cos(phi), pt * TMath::Sin(phi), pt * TMath::SinH(eta), m);
+  }
+  void SetPtEtaPhiE(double pt, const double eta, const double phi, const double e)
+  {
+    pt = TMath::Abs(pt);
+    SetXYZT(pt * TMath::Cos(phi), pt * TMath::Sin(phi), pt * TMath::SinH(eta), e);
+  }
+
+  // getters (the same as in TLorentzVector)
+  constexpr double X() const { return zPx; }
+  constexpr double Y() const { return zPy; }
+  constexpr double Z() const { return zPz; }
+  constexpr double T() const { return zE; }
+  constexpr double Px() const { return zPx; }
+  constexpr double Py() const { return zPy; }
+  constexpr double Pz() const { return zPz; }
+  constexpr double E() const { return zE; }
+  constexpr bool BTag() const { return zBTag; }
+  constexpr double P2() const { return zPx * zPx + zPy * zPy + zPz * zPz; }
+  constexpr double M2() const { return zE * zE - P2(); }
+  double P() const { return TMath::Sqrt(P2()); }
+  double M() const
+  {
+    double mm = M2();
+    return (mm < 0.0) ? (-TMath::Sqrt(-mm)) : TMath::Sqrt(mm);
+  }
+  double Pt() const { return TMath::Sqrt(zPx * zPx + zPy * zPy); }
+  double Phi() const
+  {
+    return (zPx == 0.0 && zPy == 0.0) ? 0.0 : TMath::ATan2(zPy, zPx);
+  }
+  double Eta() const
+  {
+    double p = P();
+    double cosTheta = (p == 0.0) ? 1.0 : zPz / p;
+    if(cosTheta * cosTheta < 1)
+      return -0.5 * TMath::Log((1.0 - cosTheta) / (1.0 + cosTheta));
+    if(zPz == 0)
+      return 0;
+    return (zPz > 0) ? 10e10 : -10e10;
+  }
+  double Rapidity() const { return 0.5 * TMath::Log((zE + zPz) / (zE - zPz)); }
+
+  // sum of four-vectors (b-tagging is not propagated)
+  constexpr ZPxPyPzE operator+(const ZPxPyPzE& v) const { return ZPxPyPzE(zPx + v.zPx, zPy + v.zPy, zPz + v.zPz, zE + v.zE); }
+  // invariant mass of the sum with v (the same as (*this + v).M(), without building the sum)
+  double MSum(const ZPxPyPzE& v) const
+  {
+    const double x = zPx + v.zPx;
+    const double y = zPy + v.zPy;
+    const double z = zPz + v.zPz;
+    const double e = zE + v.zE;
+    const double mm = e * e - (x * x + y * y + z * z);
+    return (mm < 0.0) ? (-TMath::Sqrt(-mm)) : TMath::Sqrt(mm);
+  }
+  // comparison of four-vectors (momentum components and energy)
+  constexpr bool operator==(const ZPxPyPzE& v) const { return zPx == v.zPx && zPy == v.zPy && zPz == v.zPz && zE == v.zE; }
+  constexpr bool operator!=(const ZPxPyPzE& v) const { return !(*this == v); }
+
+  // conversion to TLorentzVector
+  operator TLorentzVector() const { return TLorentzVector(zPx, zPy, zPz, zE); }
+
+  // momentum components and energy
+  double zPx, zPy, zPz, zE;
+  // b-tagging flag (for jets)
+  bool zBTag;
+};
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+
+#endif
@@ -12,15 +12,39 @@
 
 // C++ library or ROOT header files
 #include <TMath.h>
-#include <Math/Polynomial.h>
 #include <TLorentzVector.h>
 #include <TH1D.h>
 #include <vector>
 #include <complex>
+#include <cmath>
+// additional files from this analysis
+#include "fourVector.h"
+#include "profile.h"
+// ROOT polynomial solver (requires MathMore library) is used only if 
+// compiled with -DKINRECO_ROOT_POLYNOMIAL (for validation purpose), 
+// otherwise FindRealRootsQuartic() (see below) is used
+#ifdef KINRECO_ROOT_POLYNOMIAL
+#include <Math/Polynomial.h>
+#endif
 
 // debugging level (0 for silence, > 0 for some messages)
 int gDebug = 0;
 
+// if 1, pairs of jets in KinRecoDilepton() are tried in order of decreasing number of 
+// b-tagged jets, with early stop (faster, the result is identical, see there)
+int gKinRecoOrderedSearch = 1;
+
+// if 1, pairs of jets in KinRecoDilepton() are solved in batches (vectorised calculation 
+// of coefficients, the result is identical if compiled with -ffp-contract=off, see
+// CoefsKinRecoDilepton()), otherwise one by one
+int gKinRecoBatch = 1;
+// if 1, each batch solution is compared to the scalar one (for validation purpose, slow)
+int gKinRecoBatchCheck = 0;
+
+// number of solved quartic equations (SolveCoefsKinRecoDilepton() calls) in this thread,
+// for benchmarking (see ttbarBenchKinReco.cxx)
+thread_local long long gKinRecoNSolves = 0;
+
 // >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
 // >>>>>>>>>>>>>>>>>>> ZSolutionKinRecoDilepton >>>>>>>>>>>>>>>>>>>>>>>>
 // >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
@@ -31,7 +55,7 @@ struct ZSolutionKinRecoDilepton
   // (set weight to -1 by default)
   ZSolutionKinRecoDilepton(): zWeight(-1.0) {;}
   // top and antitop four momenta
-  TLorentzVector zT, zTbar;
+  ZPxPyPzE zT, zTbar;
   // mumber of b-tagged jets (can be 0, 1 or 2)
   int zBTag;
   // weight of this solution
@@ -41,83 +65,405 @@ struct ZSolutionKinRecoDilepton
 // >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
 
 // >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
-// >>>>>>>>>>>>>>>>> SolveKinRecoDilepton routine >>>>>>>>>>>>>>>>>>>>>>
+// >>>>>>>>>>>>>>>>> Polynomial real roots routines >>>>>>>>>>>>>>>>>>>>>
 // >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
-// Routine to solve the kinreco problem for given b, bbar jets
+// Real roots of x^2 + b*x + c = 0, stored in roots (should have size >= 2)
+// Returns the number of real roots (0 or 2)
+int FindRealRootsQuadratic(const double b, const double c, double* roots)
+{
+  double disc = b * b - 4 * c;
+  if(disc < 0.0)
+    return 0;
+  // numerically stable form (no cancellation)
+  double q = -0.5 * (b + ((b < 0.0) ? -1.0 : 1.0) * TMath::Sqrt(disc));
+  roots[0] = q;
+  roots[1] = (q != 0.0) ? (c / q) : 0.0;
+  return 2;
+}
+
+// Real roots of x^3 + a*x^2 + b*x + c = 0, stored in roots (should have size >= 3)
+// Returns the number of real roots (1 or 3)
+int FindRealRootsCubic(const double a, const double b, const double c, double* roots)
+{
+  double q = (a * a - 3 * b) / 9;
+  double r = (2 * a * a * a - 9 * a * b + 27 * c) / 54;
+  double q3 = q * q * q;
+  if(r * r < q3)
+  {
+    // three real roots (trigonometric solution)
+    double theta = TMath::ACos(r / TMath::Sqrt(q3));
+    double sq = -2 * TMath::Sqrt(q);
+    roots[0] = sq * TMath::Cos(theta / 3) - a / 3;
+    roots[1] = sq * TMath::Cos((theta + TMath::TwoPi()) / 3) - a / 3;
+    roots[2] = sq * TMath::Cos((theta - TMath::TwoPi()) / 3) - a / 3;
+    return 3;
+  }
+  // one real root (Cardano)
+  double u = -((r < 0.0) ? -1.0 : 1.0) * std::cbrt(TMath::Abs(r) + TMath::Sqrt(r * r - q3));
+  double v = (u != 0.0) ? (q / u) : 0.0;
+  roots[0] = u + v - a / 3;
+  return 1;
+}
+
+// Newton polishing of root x of polynomial pars[0] + pars[1]*x + ... + pars[n]*x^n
+// (an iteration is accepted only if it reduces the polynomial value)
+double PolishRoot(const double* pars, const int n, double x)
+{
+  double f = pars[n];
+  for(int p = n - 1; p >= 0; p--)
+    f = f * x + pars[p];
+  for(int it = 0; it < 2; it++)
+  {
+    double df = 0.0;
+    double fx = pars[n];
+    for(int p = n - 1; p >= 0; p--)
+    {
+      df = df * x + fx;
+      fx = fx * x + pars[p];
+    }
+    if(df == 0.0)
+      break;
+    double xNew = x - f / df;
+    double fNew = pars[n];
+    for(int p = n - 1; p >= 0; p--)
+      fNew = fNew * xNew + pars[p];
+    if(!(TMath::Abs(fNew) < TMath::Abs(f)))
+      break;
+    x = xNew;
+    f = fNew;
+  }
+  return x;
+}
+
+// Relative residual of root x of polynomial pars[0] + pars[1]*x + ... + pars[n]*x^n:
+// |value| / (sum of absolute values of the terms), a few rounding errors (~1e-16) for a root
+double ResidualRoot(const double* pars, const int n, const double x)
+{
+  double f = pars[n];
+  double fAbs = TMath::Abs(pars[n]);
+  for(int p = n - 1; p >= 0; p--)
+  {
+    f = f * x + pars[p];
+    fAbs = fAbs * TMath::Abs(x) + TMath::Abs(pars[p]);
+  }
+  return (fAbs > 0.0) ? (TMath::Abs(f) / fAbs) : 0.0;
+}
+
+// Real roots of x^4 + a*x^3 + b*x^2 + c*x + d = 0 (Ferrari's method), stored in roots (should have size >= 4)
+// Returns the number of real roots (0, 2 or 4)
+int FindRealRootsFerrari(const double a, const double b, const double c, const double d, double* roots)
+{
+  // depressed quartic y^4 + p*y^2 + q*y + r = 0 with x = y - a/4
+  double a2 = a * a;
+  double p = b - 3 * a2 / 8;
+  double q = a2 * a / 8 - a * b / 2 + c;
+  double r = -3 * a2 * a2 / 256 + a2 * b / 16 - a * c / 4 + d;
+  // resolvent cubic m^3 + p*m^2 + (p^2/4 - r)*m - q^2/8 = 0: its largest root is positive if q != 0,
+  // then the quartic splits into y^2 -+ s*y + p/2 + m +- q/(2s) = 0 with s = sqrt(2m)
+  double m[3];
+  int nm = FindRealRootsCubic(p, p * p / 4 - r, -q * q / 8, m);
+  double mMax = m[0];
+  for(int i = 1; i < nm; i++)
+    if(m[i] > mMax)
+      mMax = m[i];
+  double parsResolvent[4] = { -q * q / 8, p * p / 4 - r, p, 1.0 };
+  mMax = PolishRoot(parsResolvent, 3, mMax);
+  int nRoots = 0;
+  if(mMax <= 1e-12 * (TMath::Abs(p) + TMath::Sqrt(TMath::Abs(r))))
+  {
+    // q = 0 (within precision): biquadratic equation z^2 + p*z + r = 0 with z = y^2
+    double z[2];
+    int nz = FindRealRootsQuadratic(p, r, z);
+    for(int i = 0; i < nz; i++)
+    {
+      if(z[i] < 0.0)
+        continue;
+      roots[nRoots++] = TMath::Sqrt(z[i]);
+      roots[nRoots++] = -TMath::Sqrt(z[i]);
+    }
+  }
+  else
+  {
+    double s = TMath::Sqrt(2 * mMax);
+    double t = q / (2 * s);
+    nRoots += FindRealRootsQuadratic(-s, p / 2 + mMax + t, roots + nRoots);
+    nRoots += FindRealRootsQuadratic(s, p / 2 + mMax - t, roots + nRoots);
+  }
+  for(int i = 0; i < nRoots; i++)
+    roots[i] -= a / 4;
+  return nRoots;
+}
+
+// Real roots of polynomial pars[0] + pars[1]*x + pars[2]*x^2 + pars[3]*x^3 + pars[4]*x^4 = 0
+// (same parameters convention as in ROOT::Math::Polynomial), stored in roots (should have size >= 4).
+// If the leading parameter(s) are 0, the polynomial order is reduced (as in ROOT::Math::Polynomial).
+// The largest (in absolute value) real root is found in closed form (Ferrari's method for quartic, 
+// Cardano or trigonometric for cubic), polished by Newton iterations and deflated, this is repeated 
+// down to the quadratic: deflation keeps precision for small roots if the roots differ by orders of magnitude.
+// Closed form roots which are not roots after polishing (relative residual above 1e-8, see ResidualRoot(): 
+// they appear from rounding errors when complex roots differ by orders of magnitude) are dropped.
+// Returns the number of real roots (0 to 4)
+int FindRealRootsQuartic(const double* pars, double* roots)
+{
+  // reduce order, if needed
+  int n = 4;
+  while(n > 0 && pars[n] == 0.0)
+    n--;
+  if(n == 0)
+    return 0;
+  // normalised polynomial (leading coefficient 1), deflated after each found root
+  const int order = n;
+  double coef[5];
+  for(int p = 0; p <= n; p++)
+    coef[p] = pars[p] / pars[n];
+  int nRoots = 0;
+  while(n > 2)
+  {
+    double rootsClosed[4];
+    int nClosed = (n == 4) ? FindRealRootsFerrari(coef[3], coef[2], coef[1], coef[0], rootsClosed) : FindRealRootsCubic(coef[2], coef[1], coef[0], rootsClosed);
+    // the largest (in absolute value) closed form root which is a root after polishing
+    // (if there is none, there are no more real roots)
+    double x = 0.0;
+    bool found = false;
+    while(nClosed > 0 && !found)
+    {
+      int iMax = 0;
+      for(int i = 1; i < nClosed; i++)
+        if(TMath::Abs(rootsClosed[i]) > TMath::Abs(rootsClosed[iMax]))
+          iMax = i;
+      x = PolishRoot(coef, n, rootsClosed[iMax]);
+      found = (ResidualRoot(coef, n, x) < 1e-8);
+      rootsClosed[iMax] = rootsClosed[--nClosed];
+    }
+    if(!found)
+      break;
+    roots[nRoots++] = x;
+    // deflation: divide by (x - root), starting from the constant term 
+    // (stable when the largest root is divided out)
+    if(x != 0.0)
+    {
+      coef[0] = -coef[0] / x;
+      for(int p = 1; p < n - 1; p++)
+        coef[p] = (coef[p - 1] - coef[p]) / x;
+      coef[n - 1] = 1.0;
+    }
+    else
+    {
+      for(int p = 0; p < n; p++)
+        coef[p] = coef[p + 1];
+    }
+    n--;
+  }
+  // (n > 2 if no more real roots were found above)
+  if(n == 2)
+    nRoots += FindRealRootsQuadratic(coef[1], coef[0], roots + nRoots);
+  else if(n == 1)
+    roots[nRoots++] = -coef[0];
+  // polish all roots using original polynomial (and drop the ones which are not roots)
+  int nGood = 0;
+  for(int i = 0; i < nRoots; i++)
+  {
+    const double x = PolishRoot(pars, order, roots[i]);
+    if(ResidualRoot(pars, order, x) < 1e-8)
+      roots[nGood++] = x;
+  }
+  return nGood;
+}
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+// >>>>>>>>>>>>>>>>>>>>>> ZKinRecoParameters >>>>>>>>>>>>>>>>>>>>>>>>>>>
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+// structure to store parameters of the kinematic reconstruction
+// (default values are used in the analysis, other values e.g. for systematic 
+// variations, see ZEventRecoVariation in eventReco.h)
+struct ZKinRecoParameters
+{
+  // constructor (default values)
+  ZKinRecoParameters(): zMassW(80.4), zMassTop(172.5), zLandauMean(58.0), zLandauSigma(22.0) {;}
+  // W boson mass
+  double zMassW;
+  // top quark mass
+  double zMassTop;
+  // mean and sigma of Landau distribution for neutrino momentum spectrum (see DESY-THESIS-2012-037)
+  double zLandauMean, zLandauSigma;
+};
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+// >>>>>>>>>>>>>>>>>>> ZKinRecoDileptonLeptons >>>>>>>>>>>>>>>>>>>>>>>>>
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+// structure to store lepton context of the kinematic reconstruction:
+// all quantities which depend only on leptons and MET (not on jets),
+// calculated once per event and then used for all pairs of jets
+// (see SolveKinRecoDilepton() for meaning of variables), and the
+// kinreco parameters (see ZKinRecoParameters above)
+struct ZKinRecoDileptonLeptons
+{
+  // constructor
+  // Arguments:
+  //    const ZPxPyPzE& lm:   lepton- momentum
+  //    const ZPxPyPzE& lp:   lepton+ momentum
+  //    const double metX:          x-component of missing transverse energy (MET)
+  //    const double metY:          y-component of missing transverse energy
+  //    const ZKinRecoParameters& par: kinreco parameters (default values if omitted)
+  ZKinRecoDileptonLeptons(const ZPxPyPzE& lm, const ZPxPyPzE& lp, const double metX, const double metY,
+    const ZKinRecoParameters& par = ZKinRecoParameters())
+  {
+    // constants
+    zMassW = par.zMassW; // W boson mass
+    zMassTop = par.zMassTop; // top quark mass
+    zLandauMean = par.zLandauMean;
+    zLandauSigma = par.zLandauSigma;
+    // constraints
+    zMw2 = zMassW * zMassW;
+    zMt2 = zMassTop * zMassTop;
+    zMn2 = 0.0;
+    // leptons
+    zLm = lm;
+    zLp = lp;
+    SetLeptons();
+    // MET
+    zEx = metX;
+    zEx2 = zEx * zEx;
+    zEy = metY;
+    zEy2 = zEy * zEy;
+    zExy = zEx * zEy;
+  }
+
+  // change kinreco parameters (for the same leptons and MET): only the 
+  // lepton terms which depend on the W mass are recalculated, if it changes
+  void SetParameters(const ZKinRecoParameters& par)
+  {
+    zMassTop = par.zMassTop;
+    zMt2 = zMassTop * zMassTop;
+    zLandauMean = par.zLandauMean;
+    zLandauSigma = par.zLandauSigma;
+    if(par.zMassW == zMassW)
+      return;
+    zMassW = par.zMassW;
+    zMw2 = zMassW * zMassW;
+    SetLeptons();
+  }
+
+  // calculate terms for both leptons
+  void SetLeptons()
+  {
+    SetLepton(zLm, zXlm, zYlm, zZlm, zElm, zElm2, zMlm2, zWlm, zC22lm, zWlm4, zWzlm4, zEzlm4, zEzlm8, zC20lm, zC00lm, zXzlm8, zYzlm8, zXylm8);
+    SetLepton(zLp, zXlp, zYlp, zZlp, zElp, zElp2, zMlp2, zWlp, zC22lp, zWlp4, zWzlp4, zEzlp4, zEzlp8, zC20lp, zC00lp, zXzlp8, zYzlp8, zXylp8);
+  }
+
+  // calculate all lepton terms (the order of operations is exactly as in the
+  // original expressions in SolveKinRecoDilepton(), to have identical results)
+  void SetLepton(const ZPxPyPzE& l, double& x, double& y, double& z, double& e, double& e2, double& m2,
+    double& w, double& w2, double& w4, double& wz4, double& ez4, double& ez8,
+    double& ex4, double& ey4, double& xz8, double& yz8, double& xy8)
+  {
+    x = l.X();
+    y = l.Y();
+    z = l.Z();
+    double m = l.M();
+    m2 = m * m;
+    e = l.E();
+    e2 = e * e;
+    w = zMw2 - m2 - zMn2;
+    w2 = TMath::Power(w, 2.0);
+    w4 = 4 * w;
+    wz4 = 4 * w * z;
+    ez4 = 4 * (e2 - z * z);
+    ez8 = 8 * (e2 - z * z);
+    ex4 = -4 * (e2 - x * x);
+    ey4 = -4 * (e2 - y * y);
+    xz8 = 8 * x * z;
+    yz8 = 8 * y * z;
+    xy8 = 8 * x * y;
+  }
+
+  // constants and constraints
+  double zMassW, zMassTop;
+  double zLandauMean, zLandauSigma;
+  double zMw2, zMt2, zMn2;
+  // lepton momenta
+  ZPxPyPzE zLm, zLp;
+  // lepton- terms: momentum components, energy (squared), mass squared,
+  // mw2 - mlm2 - mn2 (and its square), 4 * (mw2 - mlm2 - mn2) (and times zlm),
+  // 4 * (elm2 - zlm2), 8 * (elm2 - zlm2), -4 * (elm2 - xlm2), -4 * (elm2 - ylm2),
+  // 8 * xlm * zlm, 8 * ylm * zlm, 8 * xlm * ylm
+  double zXlm, zYlm, zZlm, zElm, zElm2, zMlm2;
+  double zWlm, zC22lm, zWlm4, zWzlm4, zEzlm4, zEzlm8, zC20lm, zC00lm, zXzlm8, zYzlm8, zXylm8;
+  // lepton+ terms (same as above)
+  double zXlp, zYlp, zZlp, zElp, zElp2, zMlp2;
+  double zWlp, zC22lp, zWlp4, zWzlp4, zEzlp4, zEzlp8, zC20lp, zC00lp, zXzlp8, zYzlp8, zXylp8;
+  // MET terms
+  double zEx, zEx2, zEy, zEy2, zExy;
+};
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+// >>>>>>>>>>>>>>>>>>> ZCoefsKinRecoDilepton >>>>>>>>>>>>>>>>>>>>>>>>>>>
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+// structure to store coefficients of the kinreco problem for one pair of jets
+// (see SolveKinRecoDilepton() for their meaning): a, b coefs are needed to
+// restore the neutrino z components, c, d coefs for y components, h coefs
+// are the parameters of the quartic equation for the x component
+struct ZCoefsKinRecoDilepton
+{
+  double zA1, zA2, zA3, zA4, zB1, zB2, zB3, zB4;
+  double zC22, zC21, zC20, zC11, zC10, zC00;
+  double zD22, zD21, zD20, zD11, zD10, zD00;
+  double zH4, zH3, zH2, zH1, zH0;
+};
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+// >>>>>>>>>>>>>>>>>> CoefsKinRecoDilepton routine >>>>>>>>>>>>>>>>>>>>>>
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+// Routine to calculate coefficients of the kinreco problem for one pair of jets, used by
+// SolveKinRecoDilepton() and, for each pair in the batch, by CoefsBatchKinRecoDilepton()
+// (inlined there without branches and function calls, to be vectorised by the compiler;
+// inlining is forced, since the routine exceeds the inlining limits of GCC and the loop 
+// with a call is not vectorised: check with -fopt-info-vec that the loop in
+// CoefsBatchKinRecoDilepton() is reported as vectorised).
+// Both use these expressions, their results are identical if floating-point contraction
+// (fused multiply-add) is disabled, as done in compile.sh with -ffp-contract=off: otherwise
+// the compiler may contract them differently in the scalar and vectorised code.
 // Arguments:
-//    const TLorentzVector& lm:   lepton- momentum
-//    const TLorentzVector& lp:   lepton+ momentum
-//    const TLorentzVector& b:    b momentum
-//    const TLorentzVector& bbar: bbar momentum
-//    const double metX:          x-component of missing transverse energy (MET)
-//    const double metY:          y-component of missing transverse energy
-//    TH1D* hInacc = NULL:        histogram to be filled with the calculated inaccuracy (for debugging purpose, not filled by default)
-//    TH1D* ambiguity = NULL:     histogram to be filled with the number of ambiguities (for debugging purpose, not filled by default)
-// Returns the ZSolutionKinRecoDilepton pointer (see above)
+//    const ZKinRecoDileptonLeptons& lep: lepton context (leptons and MET, see above)
+//    const double xb, yb, zb, mb2, eb: b momentum components, mass squared and energy
+//    const double xbbar, ybbar, zbbar, mbbar2, ebbar: the same for bbar
+//    ZCoefsKinRecoDilepton& coefs: coefficients (output, see above)
 // For math, see Lars Sonnenschein's paper Phys.Rev. D73 (2006) 054015 [Erratum Phys.Rev. D73 (2006) 054015]
-ZSolutionKinRecoDilepton* SolveKinRecoDilepton(const TLorentzVector& lm, const TLorentzVector& lp, 
-  const TLorentzVector& b, const TLorentzVector& bbar, const double metX, const double metY, 
-  TH1D* hInacc = NULL, int* ambiguity = NULL)
+__attribute__((always_inline)) inline void CoefsKinRecoDilepton(const ZKinRecoDileptonLeptons& lep, const double xb, const double yb, const double zb,
+  const double mb2, const double eb, const double xbbar, const double ybbar, const double zbbar, const double mbbar2,
+  const double ebbar, ZCoefsKinRecoDilepton& coefs)
 {
-  // constants
-  const double massW = 80.4; // W boson mass
-  const double massTop = 172.5; // top quark mass
-  double landauMean = 58.0; // mean of Landau distribution for neutrino momentum spectrum (see DESY-THESIS-2012-037)
-  double landauSigma = 22.0; // sigma of Landau distribution for neutrino momentum spectrum (see DESY-THESIS-2012-037)
-  double epsForCheck = 1e+0; // threshold for numerical precison checks (for debugging purpose)
-  
-  // Transform input into double variables with short names
-  // jet1 (b)
-  double xb = b.X();
-  double yb = b.Y();
-  double zb = b.Z();
-  double mb = b.M();
-  double mb2 = mb * mb;
-  double eb = b.E();
-  double eb2 = eb * eb;
-  // jet2 (bbar)
-  double xbbar = bbar.X();
-  double ybbar = bbar.Y();
-  double zbbar = bbar.Z();
-  double mbbar = bbar.M();
-  double mbbar2 = mbbar * mbbar;
-  double ebbar = bbar.E();
-  double ebbar2 = ebbar * ebbar;
   // el (lm)
-  double xlm = lm.X();
-  double xlm2 = xlm * xlm;
-  double ylm = lm.Y();
-  double ylm2 = ylm * ylm;
-  double zlm = lm.Z();
-  double zlm2 = zlm * zlm;
-  double mlm = lm.M();
-  double mlm2 = mlm * mlm;
-  double elm = lm.E();
-  double elm2 = elm * elm;
+  const double xlm = lep.zXlm;
+  const double ylm = lep.zYlm;
+  const double zlm = lep.zZlm;
+  const double mlm2 = lep.zMlm2;
+  const double elm = lep.zElm;
+  const double elm2 = lep.zElm2;
   // mu (lp)
-  double xlp = lp.X();
-  double xlp2 = xlp * xlp;
-  double ylp = lp.Y();
-  double ylp2 = ylp * ylp;
-  double zlp = lp.Z();
-  double zlp2 = zlp * zlp;
-  double mlp = lp.M();
-  double mlp2 = mlp * mlp;
-  double elp = lp.E();
-  double elp2 = elp * elp;
+  const double xlp = lep.zXlp;
+  const double ylp = lep.zYlp;
+  const double zlp = lep.zZlp;
+  const double mlp2 = lep.zMlp2;
+  const double elp = lep.zElp;
+  const double elp2 = lep.zElp2;
   // MET
-  double ex = metX;
-  double ex2 = ex * ex;
-  double ey = metY;
-  double ey2 = ey * ey;
+  const double ex = lep.zEx;
+  const double ex2 = lep.zEx2;
+  const double ey = lep.zEy;
+  const double ey2 = lep.zEy2;
   // constraints
-  double mw2 = massW * massW;
-  double mt2 = massTop * massTop;
-  double mn2 = 0.0;
-  
+  const double mt2 = lep.zMt2;
+  const double mn2 = lep.zMn2;
+
   // Calculate coefficients from Lars' paper
+  // (terms which depend only on leptons and MET are taken from the lepton context)
   // a coefs
-  double a1 = (eb + elp) * (mw2 - mlp2 - mn2) - elp * (mt2 - mb2 - mlp2 - mn2) + 2 * eb * elp2 - 2 * elp * (xb * xlp + yb * ylp + zb * zlp);
+  double a1 = (eb + elp) * lep.zWlp - elp * (mt2 - mb2 - mlp2 - mn2) + 2 * eb * elp2 - 2 * elp * (xb * xlp + yb * ylp + zb * zlp);
   double a12 = a1 * a1;
   double a2 = 2 * (eb * xlp - elp * xb);
   double a22 = a2 * a2;
@@ -126,7 +472,7 @@ ZSolutionKinRecoDilepton* SolveKinRecoDilepton(const TLorentzVector& lm, const T
   double a4 = 2 * (eb * zlp - elp * zb);
   double a42 = a4 * a4;
   // b coefs
-  double b1 = (ebbar + elm) * (mw2 - mlm2 - mn2) - elm * (mt2 - mbbar2 - mlm2 - mn2) + 2 * ebbar * elm2 - 2 * elm * (xbbar * xlm + ybbar * ylm + zbbar * zlm);
+  double b1 = (ebbar + elm) * lep.zWlm - elm * (mt2 - mbbar2 - mlm2 - mn2) + 2 * ebbar * elm2 - 2 * elm * (xbbar * xlm + ybbar * ylm + zbbar * zlm);
   double b12 = b1 * b1;
   double b2 = 2 * (ebbar * xlm - elm * xbbar);
   double b22 = b2 * b2;
@@ -135,21 +481,21 @@ ZSolutionKinRecoDilepton* SolveKinRecoDilepton(const TLorentzVector& lm, const T
   double b4 = 2 * (ebbar * zlm - elm * zbbar);
   double b42 = b4 * b4;
   // c coefs
-  double c22 = TMath::Power(mw2 - mlp2 - mn2, 2.0) - 4 * (elp2 - zlp2) * a12 / a42 - 4 * (mw2 - mlp2 - mn2) * zlp * a1 / a4;
-  double c21 = 4 * (mw2 - mlp2 - mn2) * (xlp - zlp * a2 / a4) - 8 * (elp2 - zlp2) * a1 * a2 / a42 - 8 * xlp * zlp * a1 / a4;
-  double c20 = -4 * (elp2 - xlp2) - 4 * (elp2 - zlp2) * a22 / a42 - 8 * xlp * zlp * a2 / a4;
-  double c11 = 4 * (mw2 - mlp2 - mn2) * (ylp - zlp * a3 / a4) - 8 * (elp2 - zlp2) * a1 * a3 / a42 - 8 * ylp * zlp * a1 / a4;
-  double c10 = -8 * (elp2 - zlp2) * a2 * a3 / a42 + 8 * xlp * ylp - 8 * xlp * zlp * a3 / a4 - 8 * ylp * zlp * a2 / a4;
-  double c00 = -4 * (elp2 - ylp2) - 4 * (elp2 - zlp2) * a32 / a42 - 8 * ylp * zlp * a3 / a4;
+  double c22 = lep.zC22lp - lep.zEzlp4 * a12 / a42 - lep.zWzlp4 * a1 / a4;
+  double c21 = lep.zWlp4 * (xlp - zlp * a2 / a4) - lep.zEzlp8 * a1 * a2 / a42 - lep.zXzlp8 * a1 / a4;
+  double c20 = lep.zC20lp - lep.zEzlp4 * a22 / a42 - lep.zXzlp8 * a2 / a4;
+  double c11 = lep.zWlp4 * (ylp - zlp * a3 / a4) - lep.zEzlp8 * a1 * a3 / a42 - lep.zYzlp8 * a1 / a4;
+  double c10 = -lep.zEzlp8 * a2 * a3 / a42 + lep.zXylp8 - lep.zXzlp8 * a3 / a4 - lep.zYzlp8 * a2 / a4;
+  double c00 = lep.zC00lp - lep.zEzlp4 * a32 / a42 - lep.zYzlp8 * a3 / a4;
   // d' coefs
-  double d22p = TMath::Power(mw2 - mlm2 - mn2, 2.0) - 4 * (elm2 - zlm2) * b12 / b42 - 4 * (mw2 - mlm2 - mn2) * zlm * b1 / b4;
-  double d21p = 4 * (mw2 - mlm2 - mn2) * (xlm - zlm * b2 / b4) - 8 * (elm2 - zlm2) * b1 * b2 / b42 - 8 * xlm * zlm * b1 / b4;
-  double d20p = -4 * (elm2 - xlm2) - 4 * (elm2 - zlm2) * b22 / b42 - 8 * xlm* zlm * b2 / b4;
-  double d11p = 4 * (mw2 - mlm2 - mn2) * (ylm - zlm * b3 / b4) - 8 * (elm2 - zlm2) * b1 * b3 / b42 - 8 * ylm * zlm * b1 / b4;
-  double d10p = -8 * (elm2 - zlm2) * b2 * b3 / b42 + 8 * xlm * ylm - 8 * xlm * zlm * b3 / b4 - 8 * ylm * zlm * b2 / b4;
-  double d00p = -4 * (elm2 - ylm2) - 4 * (elm2 - zlm2) * b32 / b42 - 8 * ylm * zlm * b3 / b4;
+  double d22p = lep.zC22lm - lep.zEzlm4 * b12 / b42 - lep.zWzlm4 * b1 / b4;
+  double d21p = lep.zWlm4 * (xlm - zlm * b2 / b4) - lep.zEzlm8 * b1 * b2 / b42 - lep.zXzlm8 * b1 / b4;
+  double d20p = lep.zC20lm - lep.zEzlm4 * b22 / b42 - lep.zXzlm8 * b2 / b4;
+  double d11p = lep.zWlm4 * (ylm - zlm * b3 / b4) - lep.zEzlm8 * b1 * b3 / b42 - lep.zYzlm8 * b1 / b4;
+  double d10p = -lep.zEzlm8 * b2 * b3 / b42 + lep.zXylm8 - lep.zXzlm8 * b3 / b4 - lep.zYzlm8 * b2 / b4;
+  double d00p = lep.zC00lm - lep.zEzlm4 * b32 / b42 - lep.zYzlm8 * b3 / b4;
   // d coefs
-  double d22 = d22p + ex2 * d20p + ey2 * d00p + ex * ey * d10p + ex * d21p + ey * d11p;
+  double d22 = d22p + ex2 * d20p + ey2 * d00p + lep.zExy * d10p + ex * d21p + ey * d11p;
   double d21 = - d21p - 2 * ex * d20p - ey * d10p;
   double d20 = d20p;
   double d11 = - d11p - 2 * ey * d00p - ex * d10p;
@@ -175,32 +521,88 @@ ZSolutionKinRecoDilepton* SolveKinRecoDilepton(const TLorentzVector& lm, const T
             - d00 * d10 * (c11 * c20 + c10 * c21);
   double h0 = c00 * c00 * d20 * d20 + c10 * d20 * (c10 * d00 - c00 * d10)
             + c20 * d10 * (c00 * d10 - c10 * d00) + c20 * d00 * (c20 * d00 - 2 * c00 * d20);
-  
+  // store coefficients
+  coefs.zA1 = a1; coefs.zA2 = a2; coefs.zA3 = a3; coefs.zA4 = a4;
+  coefs.zB1 = b1; coefs.zB2 = b2; coefs.zB3 = b3; coefs.zB4 = b4;
+  coefs.zC22 = c22; coefs.zC21 = c21; coefs.zC20 = c20; coefs.zC11 = c11;
+  coefs.zC10 = c10; coefs.zC00 = c00; coefs.zD22 = d22; coefs.zD21 = d21;
+  coefs.zD20 = d20; coefs.zD11 = d11; coefs.zD10 = d10; coefs.zD00 = d00;
+  coefs.zH4 = h4; coefs.zH3 = h3; coefs.zH2 = h2; coefs.zH1 = h1;
+  coefs.zH0 = h0;
+}
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+// >>>>>>>>>>>>>>>> SolveCoefsKinRecoDilepton routine >>>>>>>>>>>>>>>>>>>
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+// Routine to solve the kinreco problem for given b, bbar jets with already calculated coefficients:
+// solves the quartic equation and restores the neutrino momenta (used by SolveKinRecoDilepton() and
+// SolveBatchKinRecoDilepton())
+// Arguments:
+//    const ZKinRecoDileptonLeptons& lep: lepton context (leptons and MET, see above)
+//    const ZPxPyPzE& b:    b momentum
+//    const ZPxPyPzE& bbar: bbar momentum
+//    const ZCoefsKinRecoDilepton& coefs: coefficients for this pair of jets (see above)
+//    ZSolutionKinRecoDilepton& solution: best solution (output, see above; zBTag is not set)
+//    TH1D* hInacc = NULL:        histogram to be filled with the calculated inaccuracy (for debugging purpose, not filled by default)
+//    int* ambiguity = NULL:      counter to be incremented with the number of ambiguities (for debugging purpose, not filled by default)
+// Returns 1 if there is a solution, 0 otherwise (then solution is not changed)
+int SolveCoefsKinRecoDilepton(const ZKinRecoDileptonLeptons& lep, const ZPxPyPzE& b, const ZPxPyPzE& bbar,
+  const ZCoefsKinRecoDilepton& coefs, ZSolutionKinRecoDilepton& solution, TH1D* hInacc = NULL, int* ambiguity = NULL)
+{
+  gKinRecoNSolves++;
+  // constants
+  const double massW = lep.zMassW; // W boson mass
+  const double massTop = lep.zMassTop; // top quark mass
+  const double landauMean = lep.zLandauMean; // mean of Landau distribution for neutrino momentum spectrum (see DESY-THESIS-2012-037)
+  const double landauSigma = lep.zLandauSigma; // sigma of Landau distribution for neutrino momentum spectrum (see DESY-THESIS-2012-037)
+  double epsForCheck = 1e+0; // threshold for numerical precison checks (for debugging purpose)
+
+  // leptons and MET
+  const ZPxPyPzE& lm = lep.zLm;
+  const ZPxPyPzE& lp = lep.zLp;
+  double ex = lep.zEx;
+  double ey = lep.zEy;
+  // coefficients
+  double a1 = coefs.zA1; double a2 = coefs.zA2; double a3 = coefs.zA3; double a4 = coefs.zA4;
+  double b1 = coefs.zB1; double b2 = coefs.zB2; double b3 = coefs.zB3; double b4 = coefs.zB4;
+  double c22 = coefs.zC22; double c21 = coefs.zC21; double c20 = coefs.zC20; double c11 = coefs.zC11;
+  double c10 = coefs.zC10; double c00 = coefs.zC00; double d22 = coefs.zD22; double d21 = coefs.zD21;
+  double d20 = coefs.zD20; double d11 = coefs.zD11; double d10 = coefs.zD10; double d00 = coefs.zD00;
+  double h4 = coefs.zH4; double h3 = coefs.zH3; double h2 = coefs.zH2; double h1 = coefs.zH1;
+  double h0 = coefs.zH0;
+
   // solve quartic equation
-  ROOT::Math::Polynomial eq(4);
   double pars[5] = { h4, h3, h2, h1, h0 };
   // apply globale scaling to avoid possible numerical precision problems
+  // (by the smallest non-zero parameter in absolute value)
   double minpar = 1e100;
   for(int p = 0; p < 5; p++)
-    if(TMath::Abs(pars[p]) < minpar)
-      minpar = pars[p];
+    if(pars[p] != 0.0 && TMath::Abs(pars[p]) < minpar)
+      minpar = TMath::Abs(pars[p]);
   for(int p = 0; p < 5; p++)
     pars[p] /= minpar;
   //printf("parameters: %e %e %e %e %e\n", pars[0], pars[1], pars[2], pars[3], pars[4]);
+  double roots[4];
+#ifdef KINRECO_ROOT_POLYNOMIAL
+  // ROOT polynomial solver (for validation purpose)
+  ROOT::Math::Polynomial eq(4);
   eq.SetParameters(pars);
-  std::vector<double> roots = eq.FindRealRoots();
+  std::vector<double> vecRoots = eq.FindRealRoots();
+  int nRoots = vecRoots.size();
+  for(int s = 0; s < nRoots; s++)
+    roots[s] = vecRoots[s];
+#else
+  int nRoots = FindRealRootsQuartic(pars, roots);
+#endif
   if(gDebug)
-    printf("N roots: %ld\n", roots.size());
+    printf("N roots: %d\n", nRoots);
   
   // restore all nu and nubar momenta components (see again Lars' paper)
-  TLorentzVector nu, nubar, nuBest, nubarBest;
+  ZPxPyPzE nu, nubar, nuBest, nubarBest;
   double weightBest = -1.0;
-  for(int s = 0; s < roots.size(); s++)
+  for(int s = 0; s < nRoots; s++)
   {
-    // check main equation
-    double sol = pars[0] + pars[1]*roots[s] + pars[2]*roots[s]*roots[s] + pars[3]*roots[s]*roots[s]*roots[s] + pars[4]*roots[s]*roots[s]*roots[s]*roots[s];
-    //printf("x: %e  solution: %e\n", roots[s], sol);
-
     // x components
     double xn = roots[s];
     double xnbar = ex - xn;
@@ -223,14 +625,14 @@ ZSolutionKinRecoDilepton* SolveKinRecoDilepton(const TLorentzVector& lm, const T
       //exit(1);
       continue;
     }
-    TLorentzVector nu, nubar;
+    ZPxPyPzE nu, nubar;
     nu.SetXYZM(xn, yn, zn, 0.0);
     nubar.SetXYZM(xnbar, ynbar, znbar, 0.0);
     // check solution
-    TLorentzVector wp = lp + nu;
-    TLorentzVector wm = lm + nubar;
-    TLorentzVector t = wp + b;
-    TLorentzVector tbar = wm + bbar;
+    ZPxPyPzE wp = lp + nu;
+    ZPxPyPzE wm = lm + nubar;
+    ZPxPyPzE t = wp + b;
+    ZPxPyPzE tbar = wm + bbar;
     if(gDebug)
       printf("%e %e %e %e %e %e\n", wp.M(), wm.M(), t.M(), tbar.M(), nu.X() + nubar.X() - ex, nu.Y() + nubar.Y() - ey);
     // below are some calculations done for debugging purpose
@@ -271,146 +673,470 @@ ZSolutionKinRecoDilepton* SolveKinRecoDilepton(const TLorentzVector& lm, const T
   
   // if the best weight is default negative, there is no solution
   if(weightBest < 0.0)
-    return NULL;
+    return 0;
   
-  // store and return best solution as ZSolutionKinRecoDilepton instance
-  ZSolutionKinRecoDilepton* solution = new ZSolutionKinRecoDilepton;
-  solution->zT = (nuBest + lp + b);
-  solution->zTbar = (nubarBest + lm + bbar);
-  solution->zWeight = weightBest;
-  return solution;
+  // store best solution in the provided ZSolutionKinRecoDilepton instance
+  solution.zT = (nuBest + lp + b);
+  solution.zTbar = (nubarBest + lm + bbar);
+  solution.zWeight = weightBest;
+  return 1;
 }
 // >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
 
 // >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
-// >>>>>>>>>>>>>>>>>>>> KinRecoDilepton routine >>>>>>>>>>>>>>>>>>>>>>>>
+// >>>>>>>>>>>>>>>>> SolveKinRecoDilepton routine >>>>>>>>>>>>>>>>>>>>>>
 // >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
-// Routine to solve the kinreco problem for the whole event (possibly with more than 2 jets)
+// Routine to solve the kinreco problem for given b, bbar jets
+// Arguments:
+//    const ZKinRecoDileptonLeptons& lep: lepton context (leptons and MET, see above)
+//    const ZPxPyPzE& b:    b momentum
+//    const ZPxPyPzE& bbar: bbar momentum
+//    ZSolutionKinRecoDilepton& solution: best solution (output, see above; zBTag is not set)
+//    TH1D* hInacc = NULL:        histogram to be filled with the calculated inaccuracy (for debugging purpose, not filled by default)
+//    int* ambiguity = NULL:      counter to be incremented with the number of ambiguities (for debugging purpose, not filled by default)
+// Returns 1 if there is a solution, 0 otherwise (then solution is not changed)
+// For math, see Lars Sonnenschein's paper Phys.Rev. D73 (2006) 054015 [Erratum Phys.Rev. D73 (2006) 054015]
+int SolveKinRecoDilepton(const ZKinRecoDileptonLeptons& lep, const ZPxPyPzE& b, const ZPxPyPzE& bbar,
+  ZSolutionKinRecoDilepton& solution, TH1D* hInacc = NULL, int* ambiguity = NULL)
+{
+  // Transform input into double variables with short names
+  // jet1 (b)
+  double xb = b.X();
+  double yb = b.Y();
+  double zb = b.Z();
+  double mb = b.M();
+  double mb2 = mb * mb;
+  double eb = b.E();
+  // jet2 (bbar)
+  double xbbar = bbar.X();
+  double ybbar = bbar.Y();
+  double zbbar = bbar.Z();
+  double mbbar = bbar.M();
+  double mbbar2 = mbbar * mbbar;
+  double ebbar = bbar.E();
+
+  // calculate coefficients and solve the quartic equation, restore neutrino momenta
+  ZCoefsKinRecoDilepton coefs;
+  CoefsKinRecoDilepton(lep, xb, yb, zb, mb2, eb, xbbar, ybbar, zbbar, mbbar2, ebbar, coefs);
+  return SolveCoefsKinRecoDilepton(lep, b, bbar, coefs, solution, hInacc, ambiguity);
+}
+
+// Routine to solve the kinreco problem for given leptons, b, bbar jets and MET
+// (lepton context is calculated for this pair of jets only: use the version
+// with ZKinRecoDileptonLeptons if kinreco is solved for several pairs of jets;
+// TLorentzVector input is converted to ZPxPyPzE, see fourVector.h)
 // Arguments:
 //    const TLorentzVector& lm:   lepton- momentum
 //    const TLorentzVector& lp:   lepton+ momentum
-//    const std::vector<TLorentzVector>& jets: container with jet momenta
+//    const TLorentzVector& b:    b momentum
+//    const TLorentzVector& bbar: bbar momentum
 //    const double metX:          x-component of missing transverse energy (MET)
 //    const double metY:          y-component of missing transverse energy
-//    const TLorentzVector& t:    top momentum (output)
-//    const TLorentzVector& tbar: top momentum (output)
+//    ZSolutionKinRecoDilepton& solution: best solution (output, see above; zBTag is not set)
+//    TH1D* hInacc = NULL:        histogram to be filled with the calculated inaccuracy (for debugging purpose, not filled by default)
+//    int* ambiguity = NULL:      counter to be incremented with the number of ambiguities (for debugging purpose, not filled by default)
+// Returns 1 if there is a solution, 0 otherwise (then solution is not changed)
+int SolveKinRecoDilepton(const TLorentzVector& lm, const TLorentzVector& lp, 
+  const TLorentzVector& b, const TLorentzVector& bbar, const double metX, const double metY, 
+  ZSolutionKinRecoDilepton& solution, TH1D* hInacc = NULL, int* ambiguity = NULL)
+{
+  ZKinRecoDileptonLeptons lep(ZPxPyPzE(lm), ZPxPyPzE(lp), metX, metY);
+  return SolveKinRecoDilepton(lep, ZPxPyPzE(b), ZPxPyPzE(bbar), solution, hInacc, ambiguity);
+}
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+// >>>>>>>>>>>>>>>>>>> ZBatchKinRecoDilepton >>>>>>>>>>>>>>>>>>>>>>>>>>>
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+// batch size (number of pairs of jets processed together, see below)
+#ifndef KINRECO_BATCH_SIZE
+#define KINRECO_BATCH_SIZE 8
+#endif
+// structure to store a batch of pairs of jets for the kinematic reconstruction, 
+// as structure of arrays (one element per pair of jets): this allows the compiler
+// to vectorise the calculation of coefficients in CoefsBatchKinRecoDilepton() 
+// (SSE2, or AVX2/AVX-512 if compiled e.g. with -march=native)
+struct ZBatchKinRecoDilepton
+{
+  // constructor (empty batch)
+  ZBatchKinRecoDilepton(): zN(0) {;}
+  
+  // add pair of jets (b, bbar), pair is arbitrary user index (not used here)
+  // (the number of pairs should not exceed KINRECO_BATCH_SIZE)
+  void Add(const ZPxPyPzE& b, const ZPxPyPzE& bbar, const int pair)
+  {
+    zB[zN] = &b;
+    zBbar[zN] = &bbar;
+    zPair[zN] = pair;
+    zXb[zN] = b.X();
+    zYb[zN] = b.Y();
+    zZb[zN] = b.Z();
+    double mb = b.M();
+    zMb2[zN] = mb * mb;
+    zEb[zN] = b.E();
+    zXbbar[zN] = bbar.X();
+    zYbbar[zN] = bbar.Y();
+    zZbbar[zN] = bbar.Z();
+    double mbbar = bbar.M();
+    zMbbar2[zN] = mbbar * mbbar;
+    zEbbar[zN] = bbar.E();
+    zN++;
+  }
+  
+  // number of pairs of jets in this batch
+  int zN;
+  // b and bbar momenta (not owned) and user index for each pair of jets
+  const ZPxPyPzE* zB[KINRECO_BATCH_SIZE];
+  const ZPxPyPzE* zBbar[KINRECO_BATCH_SIZE];
+  int zPair[KINRECO_BATCH_SIZE];
+  // input: b and bbar momentum components, masses squared and energies
+  double zXb[KINRECO_BATCH_SIZE], zYb[KINRECO_BATCH_SIZE], zZb[KINRECO_BATCH_SIZE], zMb2[KINRECO_BATCH_SIZE], zEb[KINRECO_BATCH_SIZE];
+  double zXbbar[KINRECO_BATCH_SIZE], zYbbar[KINRECO_BATCH_SIZE], zZbbar[KINRECO_BATCH_SIZE], zMbbar2[KINRECO_BATCH_SIZE], zEbbar[KINRECO_BATCH_SIZE];
+  // output: coefficients (see ZCoefsKinRecoDilepton)
+
+  double zA1[KINRECO_BATCH_SIZE], zA2[KINRECO_BATCH_SIZE], zA3[KINRECO_BATCH_SIZE], zA4[KINRECO_BATCH_SIZE], zB1[KINRECO_BATCH_SIZE], zB2[KINRECO_BATCH_SIZE], zB3[KINRECO_BATCH_SIZE], zB4[KINRECO_BATCH_SIZE];
+  double zC22[KINRECO_BATCH_SIZE], zC21[KINRECO_BATCH_SIZE], zC20[KINRECO_BATCH_SIZE], zC11[KINRECO_BATCH_SIZE], zC10[KINRECO_BATCH_SIZE], zC00[KINRECO_BATCH_SIZE];
+  double zD22[KINRECO_BATCH_SIZE], zD21[KINRECO_BATCH_SIZE], zD20[KINRECO_BATCH_SIZE], zD11[KINRECO_BATCH_SIZE], zD10[KINRECO_BATCH_SIZE], zD00[KINRECO_BATCH_SIZE];
+  double zH4[KINRECO_BATCH_SIZE], zH3[KINRECO_BATCH_SIZE], zH2[KINRECO_BATCH_SIZE], zH1[KINRECO_BATCH_SIZE], zH0[KINRECO_BATCH_SIZE];
+};
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+// >>>>>>>>>>>>>>>> CoefsBatchKinRecoDilepton routine >>>>>>>>>>>>>>>>>>>
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+// Routine to calculate coefficients of the kinreco problem for all pairs of jets in the batch
+// (CoefsKinRecoDilepton() inlined in a loop over the batch, to be vectorised by the compiler)
+// Arguments:
+//    const ZKinRecoDileptonLeptons& lepton: lepton context (leptons and MET, see above)
+//    ZBatchKinRecoDilepton& batch: batch of pairs of jets (coefficients are filled)
+void CoefsBatchKinRecoDilepton(const ZKinRecoDileptonLeptons& lepton, ZBatchKinRecoDilepton& batch)
+{
+  // local copy of the lepton context: it cannot alias with the batch arrays
+  const ZKinRecoDileptonLeptons lep(lepton);
+  const int n = batch.zN;
+  for(int l = 0; l < n; l++)
+  {
+    ZCoefsKinRecoDilepton coefs;
+    CoefsKinRecoDilepton(lep, batch.zXb[l], batch.zYb[l], batch.zZb[l], batch.zMb2[l], batch.zEb[l],
+      batch.zXbbar[l], batch.zYbbar[l], batch.zZbbar[l], batch.zMbbar2[l], batch.zEbbar[l], coefs);
+    // store coefficients
+    batch.zA1[l] = coefs.zA1; batch.zA2[l] = coefs.zA2; batch.zA3[l] = coefs.zA3; batch.zA4[l] = coefs.zA4;
+    batch.zB1[l] = coefs.zB1; batch.zB2[l] = coefs.zB2; batch.zB3[l] = coefs.zB3; batch.zB4[l] = coefs.zB4;
+    batch.zC22[l] = coefs.zC22; batch.zC21[l] = coefs.zC21; batch.zC20[l] = coefs.zC20; batch.zC11[l] = coefs.zC11;
+    batch.zC10[l] = coefs.zC10; batch.zC00[l] = coefs.zC00; batch.zD22[l] = coefs.zD22; batch.zD21[l] = coefs.zD21;
+    batch.zD20[l] = coefs.zD20; batch.zD11[l] = coefs.zD11; batch.zD10[l] = coefs.zD10; batch.zD00[l] = coefs.zD00;
+    batch.zH4[l] = coefs.zH4; batch.zH3[l] = coefs.zH3; batch.zH2[l] = coefs.zH2; batch.zH1[l] = coefs.zH1;
+    batch.zH0[l] = coefs.zH0;
+  }
+}
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+// >>>>>>>>>>>>>>>> SolveBatchKinRecoDilepton routine >>>>>>>>>>>>>>>>>>>
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+// Routine to solve the kinreco problem for all pairs of jets in the batch: coefficients are 
+// calculated with CoefsBatchKinRecoDilepton(), then the quartic equation is solved and  
+// the neutrino momenta are restored for each pair (SolveCoefsKinRecoDilepton()). 
+// The result is identical to SolveKinRecoDilepton() called for each pair (if compiled with
+// -ffp-contract=off, see CoefsKinRecoDilepton()).
+// Arguments:
+//    const ZKinRecoDileptonLeptons& lep: lepton context (leptons and MET, see above)
+//    ZBatchKinRecoDilepton& batch: batch of pairs of jets (coefficients are filled)
+//    ZSolutionKinRecoDilepton* solution: array of best solutions for each pair (output, see above; zBTag is not set)
+//    int* status:                array of statuses for each pair (output, 1 if there is a solution, 0 otherwise)
+//    TH1D* hInacc = NULL:        histogram to be filled with the calculated inaccuracy (for debugging purpose, not filled by default)
+//    int* ambiguity = NULL:      counter to be incremented with the number of ambiguities (for debugging purpose, not filled by default)
+void SolveBatchKinRecoDilepton(const ZKinRecoDileptonLeptons& lep, ZBatchKinRecoDilepton& batch, 
+  ZSolutionKinRecoDilepton* solution, int* status, TH1D* hInacc = NULL, int* ambiguity = NULL)
+{
+  CoefsBatchKinRecoDilepton(lep, batch);
+  ZCoefsKinRecoDilepton coefs;
+  for(int l = 0; l < batch.zN; l++)
+  {
+
+    coefs.zA1 = batch.zA1[l]; coefs.zA2 = batch.zA2[l]; coefs.zA3 = batch.zA3[l]; coefs.zA4 = batch.zA4[l];
+    coefs.zB1 = batch.zB1[l]; coefs.zB2 = batch.zB2[l]; coefs.zB3 = batch.zB3[l]; coefs.zB4 = batch.zB4[l];
+    coefs.zC22 = batch.zC22[l]; coefs.zC21 = batch.zC21[l]; coefs.zC20 = batch.zC20[l]; coefs.zC11 = batch.zC11[l];
+    coefs.zC10 = batch.zC10[l]; coefs.zC00 = batch.zC00[l]; coefs.zD22 = batch.zD22[l]; coefs.zD21 = batch.zD21[l];
+    coefs.zD20 = batch.zD20[l]; coefs.zD11 = batch.zD11[l]; coefs.zD10 = batch.zD10[l]; coefs.zD00 = batch.zD00[l];
+    coefs.zH4 = batch.zH4[l]; coefs.zH3 = batch.zH3[l]; coefs.zH2 = batch.zH2[l]; coefs.zH1 = batch.zH1[l];
+    coefs.zH0 = batch.zH0[l];
+    status[l] = SolveCoefsKinRecoDilepton(lep, *batch.zB[l], *batch.zBbar[l], coefs, solution[l], hInacc, ambiguity);
+  }
+}
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+// >>>>>>>>>>>>>>>>>>> SelectSolutionKinRecoDilepton >>>>>>>>>>>>>>>>>>>>
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+// Routine to check if the solution for the current pair of jets is the best one,
+// preference order:
+//   with 2 b-tagged jets, if no then
+//   with 1 b-tagged jet, if no then
+//   with 0 b-tagged jets.
+// If more than one solution with the same number of b-tagged jets
+// is available, take the solution with the largest weight
+// (calculated according to the neutrino momenta spectrum,
+// see DESY-THESIS-20120-037).
+// Note: weightBest is not reset when a solution with better b-tagging is found.
+// Arguments:
+//    const ZSolutionKinRecoDilepton& solution: solution for the current pair of jets
+//    int& bTagBest:              best number of b-tagged jets (updated)
+//    double& weightBest:         best (largest) solution weight (updated)
+//    int& solved:                solution status (set to 1 if this solution is the best one)
+//    ZPxPyPzE& t:          top momentum (updated if this solution is the best one)
+//    ZPxPyPzE& tbar:       antitop momentum (updated if this solution is the best one)
+void SelectSolutionKinRecoDilepton(const ZSolutionKinRecoDilepton& solution, int& bTagBest, double& weightBest,
+  int& solved, ZPxPyPzE& t, ZPxPyPzE& tbar)
+{
+  // worse b-tagging
+  if(solution.zBTag < bTagBest)
+    return;
+  // better b-tagging
+  else if(solution.zBTag > bTagBest)
+  {
+    bTagBest = solution.zBTag;
+    t = solution.zT;
+    tbar = solution.zTbar;
+    solved = 1;
+  }
+  // same b-tagging: check weight
+  else
+  {
+    if(solution.zWeight > weightBest)
+    {
+      weightBest = solution.zWeight;
+      t = solution.zT;
+      tbar = solution.zTbar;
+      solved = 1;
+    }
+  }
+}
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+// >>>>>>>>>>>>>>>>> ScanPairsKinRecoDilepton routine >>>>>>>>>>>>>>>>>>>
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+// Routine to solve the kinreco problem for a sequence of pairs of jets (used by KinRecoDilepton()):
+// the pairs are numbered p = j1 * nJets + j2, pairs with p < pLast, j1 != j2 and select(j1, j2) = true
+// are solved (in batches of KINRECO_BATCH_SIZE pairs if gKinRecoBatch is set, one by one otherwise),
+// then process(j1, j2, solution) is called for each pair with solution in the order of p.
+// If gKinRecoBatchCheck is set, each batch solution is compared to SolveKinRecoDilepton().
+// Arguments:
+//    const ZKinRecoDileptonLeptons& leptons: lepton context (leptons and MET, see above)
+//    const std::vector<ZPxPyPzE>& vecJet: jet momenta
+//    const int pLast:            pairs with p >= pLast are not considered
+//    Select select:              function (j1, j2) -> bool to select pairs
+//    Process process:            function (j1, j2, solution) called for each solution
+//    TH1D* hInacc:               histogram to be filled with the calculated inaccuracy (for debugging purpose, can be NULL)
+//    int* ambiguity:             counter to be incremented with the number of ambiguities (for debugging purpose, can be NULL)
+template<class Select, class Process>
+void ScanPairsKinRecoDilepton(const ZKinRecoDileptonLeptons& leptons, const std::vector<ZPxPyPzE>& vecJet,
+  const int pLast, Select select, Process process, TH1D* hInacc, int* ambiguity)
+{
+  const int nJets = vecJet.size();
+  // scalar version: one pair at a time
+  if(!gKinRecoBatch)
+  {
+    ZSolutionKinRecoDilepton solution;
+    for(int p = 0; p < pLast; p++)
+    {
+      int j1 = p / nJets;
+      int j2 = p % nJets;
+      if(j1 == j2 || !select(j1, j2)) continue;
+      if(!SolveKinRecoDilepton(leptons, vecJet[j1], vecJet[j2], solution, hInacc, ambiguity))
+        continue;
+      if(solution.zWeight < 0)
+        continue;
+      process(j1, j2, solution);
+    }
+    return;
+  }
+  // batch version
+  ZBatchKinRecoDilepton batch;
+  ZSolutionKinRecoDilepton solution[KINRECO_BATCH_SIZE];
+  int status[KINRECO_BATCH_SIZE];
+  for(int p = 0; p < pLast; p++)
+  {
+    int j1 = p / nJets;
+    int j2 = p % nJets;
+    if(j1 != j2 && select(j1, j2))
+      batch.Add(vecJet[j1], vecJet[j2], p);
+    // process the batch when it is full or all pairs are added
+    if(batch.zN == 0 || (batch.zN < KINRECO_BATCH_SIZE && p < pLast - 1))
+      continue;
+    SolveBatchKinRecoDilepton(leptons, batch, solution, status, hInacc, ambiguity);
+    for(int l = 0; l < batch.zN; l++)
+    {
+      if(gKinRecoBatchCheck)
+      {
+        ZSolutionKinRecoDilepton solutionCheck;
+        int statusCheck = SolveKinRecoDilepton(leptons, *batch.zB[l], *batch.zBbar[l], solutionCheck);
+        if(statusCheck != status[l] || (status[l] && (solutionCheck.zWeight != solution[l].zWeight
+          || solutionCheck.zT != solution[l].zT || solutionCheck.zTbar != solution[l].zTbar)))
+        {
+          printf("Error in ScanPairsKinRecoDilepton(): batch and scalar solutions differ\n");
+          exit(1);
+        }
+      }
+      if(!status[l] || solution[l].zWeight < 0)
+        continue;
+      process(batch.zPair[l] / nJets, batch.zPair[l] % nJets, solution[l]);
+    }
+    batch.zN = 0;
+  }
+}
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+// >>>>>>>>>>>>>>>>>>>> KinRecoDilepton routine >>>>>>>>>>>>>>>>>>>>>>>>
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+// Routine to solve the kinreco problem for the whole event (possibly with more than 2 jets)
+// Arguments:
+//    const ZPxPyPzE& lm:   lepton- momentum
+//    const ZPxPyPzE& lp:   lepton+ momentum
+//    const std::vector<ZPxPyPzE>& jets: container with jet momenta (with b-tagging flags)
+//    const double metX:          x-component of missing transverse energy (MET)
+//    const double metY:          y-component of missing transverse energy
+//    const ZPxPyPzE& t:    top momentum (output)
+//    const ZPxPyPzE& tbar: top momentum (output)
 //    TH1D* hInacc = NULL:        histogram to be filled with the calculated inaccuracy (for debugging purpose, not filled by default, see there usage in SolveKinRecoDilepton())
 //    TH1D* ambiguity = NULL:     histogram to be filled with the number of ambiguities (for debugging purpose, not filled by default, see there usage in SolveKinRecoDilepton())
 // Returns 1 for successfull kinreco, 0 otherwise
-// 
-int KinRecoDilepton(const TLorentzVector& lm, const TLorentzVector& mp, const std::vector<TLorentzVector>& jets, 
-  const double metX, const double metY, TLorentzVector& t, TLorentzVector& tbar, TH1D* hInacc = NULL, TH1D* hAmbig = NULL)
+//
+// If gKinRecoOrderedSearch is set, pairs of jets are tried in order of decreasing number of
+// b-tagged jets and the search is stopped after the first such group which has solution(s),
+// otherwise all pairs of jets are tried. The result is identical in both cases (but in the ordered
+// search hInacc and hAmbig are filled only for tried pairs).
+// If gKinRecoBatch is set, pairs of jets are solved in batches (see ScanPairsKinRecoDilepton()),
+// the result is identical (if compiled with -ffp-contract=off, see CoefsKinRecoDilepton()).
+//
+// This version uses already calculated lepton context (leptons, MET and kinreco parameters, see
+// ZKinRecoDileptonLeptons), e.g. to run kinreco for the same event with several sets of parameters
+// (see ZKinRecoDileptonLeptons::SetParameters()) or jets, instead of lm, mp, metX, metY above.
+int KinRecoDilepton(const ZKinRecoDileptonLeptons& leptons, const std::vector<ZPxPyPzE>& jets,
+  ZPxPyPzE& t, ZPxPyPzE& tbar, TH1D* hInacc = NULL, TH1D* hAmbig = NULL)
 {
+  PROFILE_TIMER(stageKinReco);
   // solution status (to be returned)
   int solved = 0;
   // best number of b-tagged jets (maximum 2)
   int bTagBest = 0;
   // best (largest) solution weight
   double weightBest = 0.0;
-  
-  // container with solutions
-  std::vector<ZSolutionKinRecoDilepton*> vSolutions;
-  // ambiguity and hAmbig pointers are for debugging purpose, not used normally
-  int* ambiguity = NULL;
-  if(hAmbig)
-    ambiguity = new int(0);
-    
+
+  // ambiguity and hAmbig are for debugging purpose, not used normally
+  int ambiguity = 0;
+  int* ptrAmbiguity = hAmbig ? &ambiguity : NULL;
+
   // print the number of jets if needed
   if(gDebug)
     printf("N jets: %ld\n", jets.size());
-  
-  // loop over 1st jet
-  for(std::vector<TLorentzVector>::const_iterator jet1 = jets.begin(); jet1 != jets.end(); jet1++)
+
+  // number of b-tagged jets in a pair is jets[j1].BTag() + jets[j2].BTag() (see SelectJets() in selection.h)
+  const int nJets = jets.size();
+
+  if(!gKinRecoOrderedSearch)
   {
-    // skip if already have solution(s) with two b-tagged jets
-    //if(jet1->pt() > 0 && bTagBest > 0)
-    //  continue;
-    // loop over 2nd jet
-    for(std::vector<TLorentzVector>::const_iterator jet2 = jets.begin(); jet2 != jets.end(); jet2++)
+    // loop over all pairs of jets (1st jet, then 2nd jet), the best solution is selected immediately
+    ScanPairsKinRecoDilepton(leptons, jets, nJets * nJets,
+      [](int, int) { return true; },
+      [&](int j1, int j2, ZSolutionKinRecoDilepton& solution)
+      {
+        // set b-tagging number
+        solution.zBTag = jets[j1].BTag() + jets[j2].BTag();
+        // check if this is the best solution
+        SelectSolutionKinRecoDilepton(solution, bTagBest, weightBest, solved, t, tbar);
+      },
+      hInacc, ptrAmbiguity);
+  }
+  else
+  {
+    // Ordered search: the pairs are tried in groups with 2, 1, 0 b-tagged jets
+    // (within each group in the same order as above). If the group with bTag
+    // b-tagged jets is the first one with solution(s), pairs with more b-tagged jets have
+    // no solutions and pairs with less b-tagged jets after the first solution (pair f) are
+    // rejected by SelectSolutionKinRecoDilepton(). Therefore only the pairs with less
+    // b-tagged jets before f can affect the result, via weightBest (it is not reset when
+    // bTagBest increases): they are solved only if needed.
+    for(int bTag = 2; bTag >= 0 && !solved; bTag--)
     {
-      // skip same jets
-      if(jet1 == jet2) continue;
-      // for this pair of jets, calculate number of b-tagged jets,
-      // b-tagged jets are provided with negative masses (see selection.h):
-      // account for this, then switch their masses to normal
-      int bTagThis = 0;
-      TLorentzVector jetB, jetBbar;
-      if(jet1->M() < 0)
+      // pair index (in the full loop order) of the first solution
+      int first = -1;
+      // solution of the first pair and the best (first with maximum weight) of the following pairs
+      ZPxPyPzE tFirst, tbarFirst, tLater, tbarLater;
+      double weightLater = -1.0;
+      ScanPairsKinRecoDilepton(leptons, jets, nJets * nJets,
+        [&](int j1, int j2) { return jets[j1].BTag() + jets[j2].BTag() == bTag; },
+        [&](int j1, int j2, ZSolutionKinRecoDilepton& solution)
+        {
+          solution.zBTag = bTag;
+          // without b-tagged jets, there are no other pairs which affect the result
+          if(bTag == 0)
+            SelectSolutionKinRecoDilepton(solution, bTagBest, weightBest, solved, t, tbar);
+          else if(first < 0)
+          {
+            first = j1 * nJets + j2;
+            tFirst = solution.zT;
+            tbarFirst = solution.zTbar;
+          }
+          else if(solution.zWeight > weightLater)
+          {
+            weightLater = solution.zWeight;
+            tLater = solution.zT;
+            tbarLater = solution.zTbar;
+          }
+        },
+        hInacc, ptrAmbiguity);
+      if(first < 0)
+        continue;
+      // the first solution is taken, unless one of the following has larger weight than
+      // weightBest from the pairs with less b-tagged jets before the first solution
+      double weightBefore = 0.0;
+      if(weightLater > weightBefore)
       {
-        TLorentzVector jet;
-        jet.SetPtEtaPhiM(jet1->Pt(), jet1->Eta(), jet1->Phi(), -1 * jet1->M());
-        jetB = jet;
-        bTagThis++;
+        int bTagBefore = 0;
+        int solvedBefore = 0;
+        ZPxPyPzE tBefore, tbarBefore;
+        ScanPairsKinRecoDilepton(leptons, jets, first,
+          [&](int j1, int j2) { return jets[j1].BTag() + jets[j2].BTag() < bTag; },
+          [&](int j1, int j2, ZSolutionKinRecoDilepton& solution)
+          {
+            solution.zBTag = jets[j1].BTag() + jets[j2].BTag();
+            SelectSolutionKinRecoDilepton(solution, bTagBefore, weightBefore, solvedBefore, tBefore, tbarBefore);
+          },
+          hInacc, ptrAmbiguity);
       }
-      else
-        jetB = *jet1;
-      if(jet2->M() < 0)
+      solved = 1;
+      if(weightLater > weightBefore)
       {
-        TLorentzVector jet;
-        jet.SetPtEtaPhiM(jet2->Pt(), jet2->Eta(), jet2->Phi(), -1 * jet2->M());
-        jetBbar = jet;
-        bTagThis++;
+        t = tLater;
+        tbar = tbarLater;
       }
       else
-        jetBbar = *jet2;
-      // get solution
-      TLorentzVector tThis, tbarThis;
-      ZSolutionKinRecoDilepton* solution = SolveKinRecoDilepton(lm, mp, jetB, jetBbar, metX, metY, hInacc, ambiguity);
-      if(!solution || solution->zWeight < 0)
-        continue;
-      // set b-tagging number
-      solution->zBTag = bTagThis;
-      // push to the container
-      vSolutions.push_back(solution);
-    }
-  }
-  
-  // find best solution, preference order:
-  //   with 2 b-tagged jets, if no then
-  //   with 1 b-tagged jet, if no then
-  //   with 0 b-tagged jets.
-  // If more than one solution with the same number of b-tagged jets 
-  // is available, take the solution with the largest weight 
-  // (calculated according to the neutrino momenta spectrum, 
-  // see DESY-THESIS-20120-037)
-  for(std::vector<ZSolutionKinRecoDilepton*>::iterator it = vSolutions.begin(); it != vSolutions.end(); it++)
-  {
-    ZSolutionKinRecoDilepton* sol = *it;
-    // worse b-tagging
-    if(sol->zBTag < bTagBest)
-      continue;
-    // better b-tagging
-    else if(sol->zBTag > bTagBest)
-    {
-      bTagBest = sol->zBTag;
-      t = sol->zT;
-      tbar = sol->zTbar;
-      solved = 1;
-    }
-    // same b-tagging: check weight
-    else
-    {
-      if(sol->zWeight > weightBest)
       {
-        weightBest = sol->zWeight;
-        t = sol->zT;
-        tbar = sol->zTbar;
-        solved = 1;
+        t = tFirst;
+        tbar = tbarFirst;
       }
     }
   }
+  // for debugging purpose, if needed
   if(solved && hAmbig)
-  {
-    // for debugging purpose, if needed
-    hAmbig->Fill(*ambiguity);
-    delete ambiguity;
-  }
-  
-  // all done, clear memory and return
-  for(std::vector<ZSolutionKinRecoDilepton*>::iterator it = vSolutions.begin(); it != vSolutions.end(); it++)
-    delete (*it);
+    hAmbig->Fill(ambiguity);
+
+  // all done, return
   return solved;
 }
+
+// This version calculates the lepton context (the same for all pairs of jets) with
+// kinreco parameters par (default values if omitted), see above for other arguments
+int KinRecoDilepton(const ZPxPyPzE& lm, const ZPxPyPzE& mp, const std::vector<ZPxPyPzE>& jets,
+  const double metX, const double metY, ZPxPyPzE& t, ZPxPyPzE& tbar, TH1D* hInacc = NULL, TH1D* hAmbig = NULL,
+  const ZKinRecoParameters& par = ZKinRecoParameters())
+{
+  ZKinRecoDileptonLeptons leptons(lm, mp, metX, metY, par);
+  return KinRecoDilepton(leptons, jets, t, tbar, hInacc, hAmbig);
+}
 // >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
 
 
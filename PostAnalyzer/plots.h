@@ -14,6 +14,103 @@
 #include <TGraphErrors.h>
 #include <TGraphAsymmErrors.h>
 #include <TMath.h>
+#include <TKey.h>
+#include <map>
+#include <vector>
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+// >>>>>>>>>>>>>>>>>>>> Histogram store >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+//
+// Input histograms for plotting (produced by ttbarMakeHist.cxx): each file 
+// is opened only once, when the first histogram from it is requested, then 
+// all its histograms are read (detached from the file) and the file is closed.
+// The store owns all histograms: Get() returns the cached histogram (it is 
+// shared, therefore it must not be modified), Copy() returns a new histogram 
+// which can be modified; all of them are deleted together with the store 
+// (i.e. the store should exist until the plots are saved).
+//
+class ZHistoStore
+{
+  private:
+    std::map<TString, std::map<TString, TH1D*> > zMapFile; // histograms of each file (by name)
+    std::vector<TH1D*> zVecOwned; // all histograms (cached and copies)
+
+    // histograms of the file (read if needed)
+    const std::map<TString, TH1D*>& File(const TString& fileName)
+    {
+      std::map<TString, std::map<TString, TH1D*> >::iterator it = zMapFile.find(fileName);
+      if(it != zMapFile.end())
+        return it->second;
+      TFile* f = TFile::Open(fileName);
+      if(!f)
+      {
+        printf("Error: cannot open %s\n", fileName.Data());
+        exit(1);
+      }
+      std::map<TString, TH1D*>& mapHisto = zMapFile[fileName];
+      TIter next(f->GetListOfKeys());
+      while(TKey* key = (TKey*)next())
+      {
+        if(TString(key->GetClassName()) != "TH1D" || mapHisto.count(key->GetName()))
+          continue;
+        TH1D* h = (TH1D*)key->ReadObj();
+        h->SetDirectory(0);
+        mapHisto[key->GetName()] = h;
+        zVecOwned.push_back(h);
+      }
+      f->Close();
+      delete f;
+      return mapHisto;
+    }
+
+  public:
+    ZHistoStore() {}
+    ZHistoStore(const ZHistoStore&) = delete;
+    ZHistoStore& operator=(const ZHistoStore&) = delete;
+
+    // destructor: delete all histograms
+    ~ZHistoStore()
+    {
+      for(int h = 0; h < zVecOwned.size(); h++)
+        delete zVecOwned[h];
+    }
+
+    // cached histogram name from the file fileName (must not be modified)
+    const TH1D* Get(const TString& fileName, const TString& name)
+    {
+      const std::map<TString, TH1D*>& mapHisto = File(fileName);
+      std::map<TString, TH1D*>::const_iterator it = mapHisto.find(name);
+      if(it == mapHisto.end())
+      {
+        printf("Error: no histogram %s in %s\n", name.Data(), fileName.Data());
+        exit(1);
+      }
+      return it->second;
+    }
+
+    // new copy of the histogram h (owned by the store)
+    TH1D* Copy(const TH1D* h)
+    {
+      TH1D* copy = new TH1D(*h);
+      copy->SetDirectory(0);
+      zVecOwned.push_back(copy);
+      return copy;
+    }
+
+    // new copy of the histogram name from the file fileName (owned by the store)
+    TH1D* Copy(const TString& fileName, const TString& name)
+    {
+      return Copy(Get(fileName, name));
+    }
+
+    // number of read files
+    int NFiles() const
+    {
+      return zMapFile.size();
+    }
+};
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
 
 // produce graph from histogram
 // Argumnets:
@@ -115,7 +212,8 @@ void GetPaperCS(const TString& var, TGraphAsymmErrors* gstat, TGraphAsymmErrors*
 //   const ZPlotCSInput& in: steering (see class ZPlotCSInput above)
 //          (not flexible: should contain variables in the needed 
 //           order, see ttbarMakePlots.cxx)
-void PlotCS(const ZPlotCSInput& in)
+//   ZHistoStore& store: input histograms (see class ZHistoStore above)
+void PlotCS(const ZPlotCSInput& in, ZHistoStore& store)
 {
   TCanvas* c_cs;
   c_cs = new TCanvas("ccs", "", 1200, 800);
@@ -128,6 +226,7 @@ void PlotCS(const ZPlotCSInput& in)
       gPad->SetLogy();
     in.VecHR[v]->Draw();
     TString var = in.VecVar[v];
+    TString name = TString::Format("h_%s_cs", var.Data());
     // histograms for combined dilepton channel (to be obtained)
     TH1D *hcombsig, *hcombreco, *hcombgen;
     double nsig = 0;
@@ -143,36 +242,32 @@ void PlotCS(const ZPlotCSInput& in)
       TH1D* hbackgr;
       for(int mc = 0; mc < in.VecMCBackgr.size(); mc++)
       {
-        TFile* f = TFile::Open(TString::Format("%s/mc%sReco-c%d.root", in.baseDir.Data(), in.VecMCBackgr[mc].Data(), ch));        
-        TH1D* h = (TH1D*)f->Get(TString::Format("h_%s_cs", var.Data()));
+        TString fileName = TString::Format("%s/mc%sReco-c%d.root", in.baseDir.Data(), in.VecMCBackgr[mc].Data(), ch);
         if(mc == 0)
-          hbackgr = new TH1D(*h);
+          hbackgr = store.Copy(fileName, name);
         else
-          hbackgr->Add(h);
+          hbackgr->Add(store.Get(fileName, name));
       }
       // data
-      TFile* f = TFile::Open(TString::Format("%s/data-c%d.root", in.baseDir.Data(), ch));
-      TH1D* hsig = new TH1D(*(TH1D*)f->Get(TString::Format("h_%s_cs", var.Data())));
+      TH1D* hsig = store.Copy(TString::Format("%s/data-c%d.root", in.baseDir.Data(), ch), name);
       hsig->Add(hbackgr, -1.0);
       nsig += hsig->Integral(0, hsig->GetNbinsX());
       if(ch == 1)
-        hcombsig = new TH1D(*hsig);
+        hcombsig = store.Copy(hsig);
       else
         hcombsig->Add(hsig);
       // MC reconstruction level
-      f = TFile::Open(TString::Format("%s/mcSigReco-c%d.root", in.baseDir.Data(), ch));
-      TH1D* hacc = new TH1D(*(TH1D*)f->Get(TString::Format("h_%s_cs", var.Data())));
+      TH1D* hacc = store.Copy(TString::Format("%s/mcSigReco-c%d.root", in.baseDir.Data(), ch), name);
       nreco += hacc->Integral(0, hacc->GetNbinsX());
       if(ch == 1)
-        hcombreco = new TH1D(*hacc);
+        hcombreco = store.Copy(hacc);
       else
         hcombreco->Add(hacc);
       // MC generatir level
-      f = TFile::Open(TString::Format("%s/mcSigGen-c%d.root", in.baseDir.Data(), ch));
-      TH1D* hgen = (TH1D*)f->Get(TString::Format("h_%s_cs", var.Data()));
+      const TH1D* hgen = store.Get(TString::Format("%s/mcSigGen-c%d.root", in.baseDir.Data(), ch), name);
       ngen += hgen->Integral(0, hgen->GetNbinsX());
       if(ch == 1)
-        hcombgen = new TH1D(*hgen);
+        hcombgen = store.Copy(hgen);
       else
         hcombgen->Add(hgen);
       // acceptance (also referred to as detector efficiency)
@@ -247,7 +342,7 @@ void PlotCS(const ZPlotCSInput& in)
     in.VecHR[v]->Draw("axis same");
   }
   // save plot
-  TString name = TString::Format("%s/cs%s", in.plotDir.Data(), (in.Norm) ? "_norm" : "");
-  c_cs->SaveAs(name + ".eps");
-  c_cs->SaveAs(name + ".pdf");
+  TString plotName = TString::Format("%s/cs%s", in.plotDir.Data(), (in.Norm) ? "_norm" : "");
+  c_cs->SaveAs(plotName + ".eps");
+  c_cs->SaveAs(plotName + ".pdf");
 }
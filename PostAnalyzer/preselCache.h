@@ -0,0 +1,446 @@
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+// >>>>>>>>>>>>>> Helper for preselected event cache >>>>>>>>>>>>>>>>>>>>
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+//
+// Only a few percent of the ntuple events pass the event selection,
+// therefore the selected events (for all three channels) are stored
+// once per sample in the cache file, which is read instead of the
+// ntuples in the next runs (see eventrecoPass() in eventReco.h):
+// changing kinematic reconstruction or histograms does not need to
+// process the ntuples again.
+//
+// The cache file name contains the key: hash of the selection cuts
+// (see ZSelectionCuts in selection.h), of the code stamp (see below),
+// of the input files (names, sizes and modification times) and of the
+// stored content, i.e.
+// a new cache file is produced automatically if any of them changes
+// (old cache files are not removed, they can be deleted by hand).
+//
+// The file is flat binary (header followed by arrays of plain
+// structures without padding, see ZPreselCache::Write()), written
+// and read on the same machine.
+
+#ifndef TTBAR_PRESELCACHE_H
+#define TTBAR_PRESELCACHE_H
+
+// additional files from this analysis
+#include "tree.h"
+#include "selection.h"
+// C++ library or ROOT header files
+#include <vector>
+#include <cstdio>
+#include <cstring>
+#include <glob.h>
+#include <sys/stat.h>
+#include <TString.h>
+
+// stamp of the code, part of the cache key (see ZPreselCache::MakeKey() below)
+// and of the fingerprint of the outputs (see ZEventRecoInput::Fingerprint() in
+// eventReco.h): checksum of the sources given by compile.sh
+// (-DTTBAR_CODE_STAMP=<number>), otherwise the compilation time (cache files
+// and outputs of another build are never reused then)
+#define TTBAR_STRINGIFY2(x) #x
+#define TTBAR_STRINGIFY(x) TTBAR_STRINGIFY2(x)
+#ifdef TTBAR_CODE_STAMP
+const char gEventRecoCodeStamp[] = TTBAR_STRINGIFY(TTBAR_CODE_STAMP);
+#else
+const char gEventRecoCodeStamp[] = __DATE__ " " __TIME__;
+#endif
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+// >>>>>>>>>>>>>>>>>>> Preselection of one event >>>>>>>>>>>>>>>>>>>>>>>
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+//
+// Generator level information and event selection results of one
+// event, either from the input tree (the selection is done once per
+// channel, when requested for the first time) or from the cache.
+//
+class ZEventPresel
+{
+  private:
+    const ZTree* zTree; // input tree (NULL for event from the cache)
+    bool zDone[4]; // selection done (index = channel)
+    bool zPass[4]; // event is selected (index = channel)
+    ZPreselEvent zEv[4]; // selected event (index = channel)
+
+  public:
+    int McEventType; // see tree.h
+    float McT[4], McTbar[4]; // generator level top and antitop (see tree.h)
+
+    // constructor (event from the cache: nothing is selected, see Select())
+    ZEventPresel()
+    {
+      zTree = NULL;
+      for(int ch = 0; ch < 4; ch++)
+      {
+        zDone[ch] = true;
+        zPass[ch] = false;
+      }
+      McEventType = 0;
+      memset(McT, 0, sizeof(McT));
+      memset(McTbar, 0, sizeof(McTbar));
+    }
+
+    // constructor (event from the tree, GetEntry() should be done already;
+    // if flagMC is true, generator level information is taken from the tree)
+    ZEventPresel(const ZTree* preselTree, bool flagMC)
+    {
+      zTree = preselTree;
+      for(int ch = 0; ch < 4; ch++)
+      {
+        zDone[ch] = false;
+        zPass[ch] = false;
+      }
+      McEventType = flagMC ? preselTree->mcEventType : 0;
+      if(flagMC)
+      {
+        memcpy(McT, preselTree->mcT, sizeof(McT));
+        memcpy(McTbar, preselTree->mcTbar, sizeof(McTbar));
+      }
+    }
+
+    // selected event in the channel (NULL if not selected),
+    // channel known at compile time (see SelectEvent() in selection.h)
+    template<int channel>
+    const ZPreselEvent* Get()
+    {
+      if(!zDone[channel])
+      {
+        PROFILE_TIMER(stagePresel);
+        zPass[channel] = SelectEvent<channel>(zTree, zEv[channel]);
+        zDone[channel] = true;
+      }
+      return zPass[channel] ? &zEv[channel] : NULL;
+    }
+
+    // the same for the channel given at run time
+    const ZPreselEvent* Get(const int channel)
+    {
+      if(!zDone[channel])
+      {
+        PROFILE_TIMER(stagePresel);
+        zPass[channel] = SelectEvent(zTree, channel, zEv[channel]);
+        zDone[channel] = true;
+      }
+      return zPass[channel] ? &zEv[channel] : NULL;
+    }
+
+    // mark event as selected in the channel and return it to be set (event from the cache)
+    ZPreselEvent& Select(const int channel)
+    {
+      zDone[channel] = true;
+      zPass[channel] = true;
+      PROFILE_CUT(zEv[channel], cutJets);
+      return zEv[channel];
+    }
+
+#ifdef TTBAR_PROFILE
+    // last passed cut in the channel (see ZCutFlow in profile.h), the selection should be done already
+    // (for events from the cache known only for selected events, see eventrecoPass() in eventReco.h)
+    int LastCut(const int channel) const
+    {
+      return zEv[channel].LastCut;
+    }
+#endif
+};
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+// >>>>>>>>>>>>>>>>>>> Structures in the cache file >>>>>>>>>>>>>>>>>>>>>
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+//
+// file header
+struct ZPreselCacheHeader
+{
+  char Magic[8]; // "ZPRESEL" (file type)
+  unsigned long long Key; // see ZPreselCache::MakeKey()
+  long long NEvents; // number of events in the input tree
+  long long NEventsType[4]; // number of events per mcEventType 1, 2, 3 (MC only)
+  long long NRecords, NSel, NJets; // array sizes
+};
+// one stored event: selected in at least one channel, or generator
+// level event in ee, mumu or emu (MC only)
+struct ZPreselCacheRecord
+{
+  long long Event; // event number in the input tree
+  long long FirstSel; // first ZPreselCacheSel of this event
+  int McEventType; // see tree.h
+  int Selected; // bit mask of channels in which the event is selected
+  float McT[4], McTbar[4]; // see tree.h
+};
+// four-vector (ZPxPyPzE has padding after the b-tagging flag, whose
+// content is undefined, therefore it is stored field by field)
+struct ZPreselCacheP4
+{
+  double Px, Py, Pz, E;
+  long long BTag;
+};
+// event selected in one channel (in increasing channel order for each record)
+struct ZPreselCacheSel
+{
+  ZPreselCacheP4 LepM, LepP; // selected leptons
+  double MetPx, MetPy; // missing transverse energy
+  long long FirstJet, NJets; // jets in the jet (and b-tagging discriminator) array
+};
+static_assert(sizeof(ZPreselCacheRecord) == 2 * sizeof(long long) + 2 * sizeof(int) + 8 * sizeof(float), "padding in ZPreselCacheRecord");
+static_assert(sizeof(ZPreselCacheP4) == 4 * sizeof(double) + sizeof(long long), "padding in ZPreselCacheP4");
+static_assert(sizeof(ZPreselCacheSel) == 2 * sizeof(ZPreselCacheP4) + 2 * sizeof(double) + 2 * sizeof(long long), "padding in ZPreselCacheSel");
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+// >>>>>>>>>>>>>>>>>>>>>>>> ZPreselCache >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+class ZPreselCache
+{
+  private:
+    ZPreselCacheHeader zHeader;
+    std::vector<ZPreselCacheRecord> zVecRecord;
+    std::vector<ZPreselCacheSel> zVecSel;
+    std::vector<ZPreselCacheP4> zVecJet;
+    std::vector<double> zVecJetDiscr;
+
+    // conversion of four-vectors to and from the cache file
+    static ZPreselCacheP4 ToCache(const ZPxPyPzE& v)
+    {
+      ZPreselCacheP4 p;
+      p.Px = v.X();
+      p.Py = v.Y();
+      p.Pz = v.Z();
+      p.E = v.E();
+      p.BTag = v.BTag();
+      return p;
+    }
+    static ZPxPyPzE FromCache(const ZPreselCacheP4& p)
+    {
+      return ZPxPyPzE(p.Px, p.Py, p.Pz, p.E, p.BTag);
+    }
+
+  public:
+    // FNV-1a hash of n bytes (also used for fingerprints of output
+    // histograms, see ZEventRecoInput::Fingerprint() in eventReco.h)
+    static void Hash(unsigned long long& h, const void* data, const size_t n)
+    {
+      const unsigned char* c = (const unsigned char*)data;
+      for(size_t i = 0; i < n; i++)
+      {
+        h ^= c[i];
+        h *= 1099511628211ULL;
+      }
+    }
+    static void HashString(unsigned long long& h, const TString& str)
+    {
+      Hash(h, str.Data(), str.Length() + 1);
+    }
+    // the same for one value (of a plain type without padding, structures
+    // are hashed field by field)
+    template<class T> static void HashValue(unsigned long long& h, const T& x)
+    {
+      Hash(h, &x, sizeof(x));
+    }
+
+    // selection cuts, field by field (add new fields of ZSelectionCuts here)
+    static void HashSelectionCuts(unsigned long long& h, const ZSelectionCuts& cuts)
+    {
+      const double values[] = {
+        cuts.ElPtMin, cuts.ElEtaMax, cuts.ElIso03Max, cuts.ElMissHitsMax,
+        cuts.MuPtMin, cuts.MuEtaMax, cuts.MuIso03Max, cuts.MuHitsValidMin, cuts.MuHitsPixelMin,
+        cuts.MuDistPV0Max, cuts.MuDistPVzMax, cuts.MuTrackChi2NDOFMax,
+        cuts.DiLepMassMin, cuts.DiLepZVetoMin, cuts.DiLepZVetoMax, cuts.MetMin,
+        cuts.PvNMin, cuts.PvNDOFMin, cuts.PvRhoMax, cuts.PvZMax,
+        cuts.JetEtaMax, cuts.JetPtMin, cuts.JetNMin, cuts.BTagDiscrMin
+      };
+      static_assert(sizeof(values) == sizeof(ZSelectionCuts), "ZSelectionCuts field missing in HashSelectionCuts()");
+      Hash(h, values, sizeof(values));
+    }
+
+    // constructor (empty cache with the key)
+    ZPreselCache(const unsigned long long key = 0)
+    {
+      memset(&zHeader, 0, sizeof(zHeader));
+      strcpy(zHeader.Magic, "ZPRESEL");
+      zHeader.Key = key;
+    }
+
+    // key for the input files (patterns as for TChain::Add()) and the content:
+    // flagMC (generator level stored), flagReco (selected events stored)
+    static unsigned long long MakeKey(const std::vector<TString>& vecInFile, bool flagMC, bool flagReco)
+    {
+      unsigned long long h = 14695981039346656037ULL;
+      HashValue(h, gSelectionVersion);
+      Hash(h, gEventRecoCodeStamp, sizeof(gEventRecoCodeStamp));
+      HashSelectionCuts(h, gSelectionCuts);
+      Hash(h, gTriggerMask, sizeof(gTriggerMask));
+      int layout[4] = { (int)sizeof(ZPreselCacheHeader), (int)sizeof(ZPreselCacheRecord), (int)sizeof(ZPreselCacheSel), (int)sizeof(ZPreselCacheP4) };
+      Hash(h, layout, sizeof(layout));
+      int content[2] = { flagMC, flagReco };
+      Hash(h, content, sizeof(content));
+      for(int f = 0; f < vecInFile.size(); f++)
+      {
+        HashString(h, vecInFile[f]);
+        // all matching files: name, size and modification time
+        glob_t g;
+        if(glob(vecInFile[f].Data(), 0, NULL, &g) == 0)
+        {
+          for(size_t i = 0; i < g.gl_pathc; i++)
+          {
+            struct stat st;
+            if(stat(g.gl_pathv[i], &st) != 0)
+              continue;
+            long long info[2] = { (long long)st.st_size, (long long)st.st_mtime };
+            HashString(h, g.gl_pathv[i]);
+            Hash(h, info, sizeof(info));
+          }
+        }
+        globfree(&g);
+      }
+      return h;
+    }
+
+    // number of events in the input tree, per mcEventType (MC only), number of stored records
+    long long NEvents() const { return zHeader.NEvents; }
+    long long NEventsType(const int type) const { return zHeader.NEventsType[type]; }
+    long long NRecords() const { return zVecRecord.size(); }
+
+    // add event e of the input tree; if flagMC is true, generator level information
+    // is stored, if flagReco is true, the selection is done for all channels
+    // (otherwise reco level branches are not read, see MakeTree() in eventReco.h)
+    void Add(const long long e, ZEventPresel& presel, bool flagMC, bool flagReco)
+    {
+      zHeader.NEvents++;
+      bool gen = flagMC && presel.McEventType >= 1 && presel.McEventType <= 3;
+      if(gen)
+        zHeader.NEventsType[presel.McEventType]++;
+      ZPreselCacheRecord record;
+      memset(&record, 0, sizeof(record));
+      record.Event = e;
+      record.FirstSel = zVecSel.size();
+      record.McEventType = presel.McEventType;
+      memcpy(record.McT, presel.McT, sizeof(record.McT));
+      memcpy(record.McTbar, presel.McTbar, sizeof(record.McTbar));
+      for(int ch = 1; ch <= 3 && flagReco; ch++)
+      {
+        const ZPreselEvent* ev = presel.Get(ch);
+        if(!ev)
+          continue;
+        record.Selected |= (1 << ch);
+        ZPreselCacheSel sel;
+        sel.LepM = ToCache(ev->LepM);
+        sel.LepP = ToCache(ev->LepP);
+        sel.MetPx = ev->MetPx;
+        sel.MetPy = ev->MetPy;
+        sel.FirstJet = zVecJet.size();
+        sel.NJets = ev->VecJets.size();
+        for(int j = 0; j < ev->VecJets.size(); j++)
+          zVecJet.push_back(ToCache(ev->VecJets[j]));
+        zVecJetDiscr.insert(zVecJetDiscr.end(), ev->VecBTagDiscr.begin(), ev->VecBTagDiscr.end());
+        zVecSel.push_back(sel);
+      }
+      if(gen || record.Selected)
+        zVecRecord.push_back(record);
+    }
+
+    // append cache of next events (multi-threaded mode: blocks are appended in the event order)
+    void Append(const ZPreselCache& other)
+    {
+      zHeader.NEvents += other.zHeader.NEvents;
+      for(int type = 0; type < 4; type++)
+        zHeader.NEventsType[type] += other.zHeader.NEventsType[type];
+      for(int r = 0; r < other.zVecRecord.size(); r++)
+      {
+        zVecRecord.push_back(other.zVecRecord[r]);
+        zVecRecord.back().FirstSel += zVecSel.size();
+      }
+      for(int s = 0; s < other.zVecSel.size(); s++)
+      {
+        zVecSel.push_back(other.zVecSel[s]);
+        zVecSel.back().FirstJet += zVecJet.size();
+      }
+      zVecJet.insert(zVecJet.end(), other.zVecJet.begin(), other.zVecJet.end());
+      zVecJetDiscr.insert(zVecJetDiscr.end(), other.zVecJetDiscr.begin(), other.zVecJetDiscr.end());
+    }
+
+    // set event from the record r
+    void Get(const long long r, ZEventPresel& presel) const
+    {
+      const ZPreselCacheRecord& record = zVecRecord[r];
+      presel.McEventType = record.McEventType;
+      memcpy(presel.McT, record.McT, sizeof(presel.McT));
+      memcpy(presel.McTbar, record.McTbar, sizeof(presel.McTbar));
+      long long s = record.FirstSel;
+      for(int ch = 1; ch <= 3; ch++)
+      {
+        if(!((record.Selected >> ch) & 1))
+          continue;
+        const ZPreselCacheSel& sel = zVecSel[s++];
+        ZPreselEvent& ev = presel.Select(ch);
+        ev.LepM = FromCache(sel.LepM);
+        ev.LepP = FromCache(sel.LepP);
+        ev.MetPx = sel.MetPx;
+        ev.MetPy = sel.MetPy;
+        ev.VecJets.resize(sel.NJets);
+        for(int j = 0; j < sel.NJets; j++)
+          ev.VecJets[j] = FromCache(zVecJet[sel.FirstJet + j]);
+        ev.VecBTagDiscr.assign(zVecJetDiscr.begin() + sel.FirstJet, zVecJetDiscr.begin() + sel.FirstJet + sel.NJets);
+      }
+    }
+
+    // write cache file (via temporary file, which is renamed when complete), returns true if successfull
+    bool Write(const TString& name)
+    {
+      zHeader.NRecords = zVecRecord.size();
+      zHeader.NSel = zVecSel.size();
+      zHeader.NJets = zVecJet.size();
+      TString tmpName = name + ".tmp";
+      FILE* f = fopen(tmpName.Data(), "wb");
+      if(!f)
+        return false;
+      bool ok = (fwrite(&zHeader, sizeof(zHeader), 1, f) == 1);
+      ok = ok && (fwrite(zVecRecord.data(), sizeof(ZPreselCacheRecord), zVecRecord.size(), f) == zVecRecord.size());
+      ok = ok && (fwrite(zVecSel.data(), sizeof(ZPreselCacheSel), zVecSel.size(), f) == zVecSel.size());
+      ok = ok && (fwrite(zVecJet.data(), sizeof(ZPreselCacheP4), zVecJet.size(), f) == zVecJet.size());
+      ok = ok && (fwrite(zVecJetDiscr.data(), sizeof(double), zVecJetDiscr.size(), f) == zVecJetDiscr.size());
+      ok = (fclose(f) == 0) && ok;
+      if(ok)
+        ok = (rename(tmpName.Data(), name.Data()) == 0);
+      if(!ok)
+        remove(tmpName.Data());
+      return ok;
+    }
+
+    // read cache file, returns false if it does not exist,
+    // it is not complete or it has another key (if checkKey is false, 
+    // any key is accepted, e.g. to read the file of an unknown sample)
+    bool Read(const TString& name, bool checkKey = true)
+    {
+      FILE* f = fopen(name.Data(), "rb");
+      if(!f)
+        return false;
+      ZPreselCacheHeader header;
+      bool ok = (fread(&header, sizeof(header), 1, f) == 1);
+      ok = ok && !strcmp(header.Magic, zHeader.Magic) && (!checkKey || header.Key == zHeader.Key);
+      if(ok)
+      {
+        zVecRecord.resize(header.NRecords);
+        zVecSel.resize(header.NSel);
+        zVecJet.resize(header.NJets);
+        zVecJetDiscr.resize(header.NJets);
+        ok = (fread(zVecRecord.data(), sizeof(ZPreselCacheRecord), zVecRecord.size(), f) == zVecRecord.size());
+        ok = ok && (fread(zVecSel.data(), sizeof(ZPreselCacheSel), zVecSel.size(), f) == zVecSel.size());
+        ok = ok && (fread(zVecJet.data(), sizeof(ZPreselCacheP4), zVecJet.size(), f) == zVecJet.size());
+        ok = ok && (fread(zVecJetDiscr.data(), sizeof(double), zVecJetDiscr.size(), f) == zVecJetDiscr.size());
+      }
+      fclose(f);
+      if(ok)
+        zHeader = header;
+      else
+      {
+        zVecRecord.clear();
+        zVecSel.clear();
+        zVecJet.clear();
+        zVecJetDiscr.clear();
+      }
+      return ok;
+    }
+};
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+
+#endif
@@ -0,0 +1,295 @@
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+// >>>>>>>>>>>>>> Helper for profiling and cut flow >>>>>>>>>>>>>>>>>>>>>
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+//
+// Instrumentation of the event reconstruction, compiled in only with
+// -DTTBAR_PROFILE (see compile.sh): otherwise all PROFILE_* macros below
+// are empty and the code is exactly the same as without instrumentation.
+//
+// Timing: scoped timers (PROFILE_TIMER(stage), the time from the macro to
+// the end of the scope is added to the stage) for reading of the input
+// tree, preselection, jet selection, kinematic reconstruction and histogram
+// filling. Each thread accumulates its own time and number of calls
+// (thread_local, no locking in the event loop), the threads are collected
+// at the end of their work (see ProfileCollect() below). Time is measured
+// with std::chrono::steady_clock, or with the time stamp counter of the
+// CPU (rdtsc, lower overhead) if also compiled with -DTTBAR_PROFILE_RDTSC.
+//
+// Cut flow: the last passed cut of each event is counted for each input
+// (see ZEventRecoCounters in eventReco.h), the preselection cuts are
+// recorded in SelectEvent() (see selection.h).
+//
+// Results are printed after each pass and stored as histograms "timing"
+// and "cutflow" in the output files (see eventrecoPass() in eventReco.h).
+
+#ifndef TTBAR_PROFILE_H
+#define TTBAR_PROFILE_H
+
+#ifdef TTBAR_PROFILE
+
+// C++ library or ROOT header files
+#include <chrono>
+#include <mutex>
+#include <cstdio>
+#include <TH1D.h>
+#ifdef TTBAR_PROFILE_RDTSC
+#include <x86intrin.h>
+#endif
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+// >>>>>>>>>>>>>>>>>>>>>>>> ZProfile >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+//
+// Accumulated time (in ticks, see ProfileTicks() below) and number of
+// calls for each stage
+//
+class ZProfile
+{
+  public:
+    // stages
+    static const int stageRead = 0; // GetEntry() of the input tree
+    static const int stagePresel = 1; // SelectEvent() (see selection.h)
+    static const int stageJets = 2; // SelectJets() (see selection.h)
+    static const int stageKinReco = 3; // KinRecoDilepton() (see kinReco.h)
+    static const int stageFill = 4; // FillHistos() (see eventReco.h)
+    static const int nStages = 5;
+
+    long long Ticks[nStages];
+    long long Calls[nStages];
+
+    // constructor
+    ZProfile()
+    {
+      Reset();
+    }
+
+    // stage name
+    static const char* StageName(const int stage)
+    {
+      static const char* names[nStages] = { "read", "presel", "jets", "kinreco", "fill" };
+      return names[stage];
+    }
+
+    // set all counters to 0
+    void Reset()
+    {
+      for(int s = 0; s < nStages; s++)
+      {
+        Ticks[s] = 0;
+        Calls[s] = 0;
+      }
+    }
+
+    // add counters from another object
+    void Add(const ZProfile& other)
+    {
+      for(int s = 0; s < nStages; s++)
+      {
+        Ticks[s] += other.Ticks[s];
+        Calls[s] += other.Calls[s];
+      }
+    }
+};
+
+// counters of this thread
+thread_local ZProfile gProfileThread;
+// counters collected from all threads (see ProfileCollect())
+ZProfile gProfile;
+std::mutex gProfileMutex;
+
+// current time in ticks
+inline long long ProfileTicks()
+{
+#ifdef TTBAR_PROFILE_RDTSC
+  return __rdtsc();
+#else
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+// duration of one tick in seconds (for rdtsc calibrated once against steady_clock)
+double ProfileSecondsPerTick()
+{
+#ifdef TTBAR_PROFILE_RDTSC
+  static double secondsPerTick = 0.0;
+  if(secondsPerTick == 0.0)
+  {
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    long long ticks = ProfileTicks();
+    while(std::chrono::steady_clock::now() - start < std::chrono::milliseconds(20));
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    secondsPerTick = seconds / (ProfileTicks() - ticks);
+  }
+  return secondsPerTick;
+#else
+  return 1e-9;
+#endif
+}
+
+// add counters of this thread to gProfile (to be called by each thread at the end of its work)
+void ProfileCollect()
+{
+  std::lock_guard<std::mutex> lock(gProfileMutex);
+  gProfile.Add(gProfileThread);
+  gProfileThread.Reset();
+}
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+// >>>>>>>>>>>>>>>>>>>>>>>> ZProfileTimer >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+//
+// Scoped timer: adds the time of its life to the stage (counters of this thread)
+//
+class ZProfileTimer
+{
+  private:
+    int zStage;
+    long long zStart;
+
+  public:
+    ZProfileTimer(const int stage)
+    {
+      zStage = stage;
+      zStart = ProfileTicks();
+    }
+
+    ~ZProfileTimer()
+    {
+      gProfileThread.Ticks[zStage] += ProfileTicks() - zStart;
+      gProfileThread.Calls[zStage]++;
+    }
+};
+
+// print collected counters (wall: wall-clock time of the pass in seconds)
+void ProfilePrint(const ZProfile& profile, const double wall)
+{
+  printf("****** timing ******\n");
+  printf("%-8s %12s %12s %14s %9s\n", "stage", "calls", "time [s]", "per call [us]", "of wall");
+  for(int s = 0; s < ZProfile::nStages; s++)
+  {
+    double time = profile.Ticks[s] * ProfileSecondsPerTick();
+    double perCall = profile.Calls[s] ? 1e6 * time / profile.Calls[s] : 0.0;
+    printf("%-8s %12lld %12.3f %14.3f %8.1f%%\n", ZProfile::StageName(s), profile.Calls[s], time, perCall, wall > 0.0 ? 100.0 * time / wall : 0.0);
+  }
+  printf("wall time of the pass: %.3f s (multi-threaded mode: times are summed over threads)\n", wall);
+}
+
+// histogram with time in seconds for each stage (bin 1 + stage) and the wall-clock time (last bin)
+TH1D* ProfileTimingHisto(const ZProfile& profile, const double wall)
+{
+  TH1D* h = new TH1D("timing", "time per stage [s]", ZProfile::nStages + 1, 0.0, ZProfile::nStages + 1.0);
+  h->SetDirectory(0);
+  for(int s = 0; s < ZProfile::nStages; s++)
+  {
+    h->SetBinContent(s + 1, profile.Ticks[s] * ProfileSecondsPerTick());
+    h->GetXaxis()->SetBinLabel(s + 1, ZProfile::StageName(s));
+  }
+  h->SetBinContent(ZProfile::nStages + 1, wall);
+  h->GetXaxis()->SetBinLabel(ZProfile::nStages + 1, "wall");
+  return h;
+}
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+// >>>>>>>>>>>>>>>>>>>>>>>> ZCutFlow >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+//
+// Cuts of the event selection, in the order of application: for each
+// event the last passed cut is counted (see ZEventRecoCounters in
+// eventReco.h), the number of events passing each cut is obtained from it
+// by summation. The last preselection cut is followed by the final jet
+// selection (b-tagging, counted as selected events) and the kinematic
+// reconstruction (counted as reconstructed events), which can differ for
+// systematic variations.
+//
+class ZCutFlow
+{
+  public:
+    static const int cutEvents = 0; // all events
+    static const int cutTruth = 1; // MC truth filter (MC signal and 'ttbar other')
+    static const int cutVertex = 2; // primary vertex
+    static const int cutTrigger = 3; // trigger
+    static const int cutMet = 4; // missing transverse energy (ee and mumu)
+    static const int cutDilepton = 5; // dilepton pair
+    static const int cutJets = 6; // at least two preselected jets
+    static const int nCuts = 7;
+
+    long long NLast[nCuts]; // number of events for which this is the last passed cut
+
+    // constructor
+    ZCutFlow()
+    {
+      for(int c = 0; c < nCuts; c++)
+        NLast[c] = 0;
+    }
+
+    // cut name
+    static const char* CutName(const int cut)
+    {
+      static const char* names[nCuts] = { "events", "MC truth", "vertex", "trigger", "MET", "dilepton", ">= 2 jets" };
+      return names[cut];
+    }
+
+    // number of events which passed the cut
+    long long NPassed(const int cut) const
+    {
+      long long n = 0;
+      for(int c = cut; c < nCuts; c++)
+        n += NLast[c];
+      return n;
+    }
+
+    // add counters from another object
+    void Add(const ZCutFlow& other)
+    {
+      for(int c = 0; c < nCuts; c++)
+        NLast[c] += other.NLast[c];
+    }
+
+    // print the cut flow (nSel, nReco: selected and reconstructed events)
+    void Print(const long nSel, const long nReco) const
+    {
+      for(int c = 0; c < nCuts; c++)
+        printf("  %-10s: %lld\n", CutName(c), NPassed(c));
+      printf("  %-10s: %ld\n", "b-tag", nSel);
+      printf("  %-10s: %ld\n", "kinreco", nReco);
+    }
+
+    // histogram with the number of events after each cut (nSel, nReco: selected and reconstructed events)
+    TH1D* Histo(const long nSel, const long nReco) const
+    {
+      TH1D* h = new TH1D("cutflow", "cut flow", nCuts + 2, 0.0, nCuts + 2.0);
+      h->SetDirectory(0);
+      for(int c = 0; c < nCuts; c++)
+      {
+        h->SetBinContent(c + 1, NPassed(c));
+        h->GetXaxis()->SetBinLabel(c + 1, CutName(c));
+      }
+      h->SetBinContent(nCuts + 1, nSel);
+      h->GetXaxis()->SetBinLabel(nCuts + 1, "b-tag");
+      h->SetBinContent(nCuts + 2, nReco);
+      h->GetXaxis()->SetBinLabel(nCuts + 2, "kinreco");
+      return h;
+    }
+};
+
+// scoped timer for the stage (ZProfile::stage<...>)
+#define PROFILE_CONCAT2(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT2(a, b)
+#define PROFILE_TIMER(stage) ZProfileTimer PROFILE_CONCAT(profileTimer, __LINE__)(ZProfile::stage)
+// record the passed preselection cut (ZCutFlow::cut<...>) in the event ev (ZPreselEvent, see selection.h)
+#define PROFILE_CUT(ev, cut) (ev).LastCut = ZCutFlow::cut
+// count the last passed cut (ZCutFlow::cut<...> or a variable) of the event in counters (ZEventRecoCounters)
+#define PROFILE_COUNT(counters, cut) (counters).CutFlow.NLast[cut]++
+// add counters of this thread to gProfile
+#define PROFILE_COLLECT() ProfileCollect()
+
+#else
+
+#define PROFILE_TIMER(stage)
+#define PROFILE_CUT(ev, cut)
+#define PROFILE_COUNT(counters, cut)
+#define PROFILE_COLLECT()
+
+#endif // #ifdef TTBAR_PROFILE
+
+#endif
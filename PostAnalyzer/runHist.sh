@@ -0,0 +1,45 @@
+#!/bin/bash
+#
+# Produce histograms with several parallel processes.
+# Usage:
+#   ./runHist.sh <nproc> [-s <name>[,<name>...]]
+#
+# The samples in the manifest (samples.txt, see samples.h), or only the
+# samples given with -s, are split into work units (ranges of input files,
+# see nFilesUnit in ttbarMakeHist.cxx), which are processed by <nproc>
+# parallel ttbarMakeHist processes, each writing partial histograms to
+# hist/parts/ (logs in hist/parts/log_u<unit>.txt). At the end, the partial
+# histograms are merged into hist/<name>-c<channel>.root, as produced by
+# ./ttbarMakeHist without arguments.
+# The work units can also be processed on batch nodes (with the same
+# manifest and input files): submit one job per unit with
+#   ./ttbarMakeHist [-s ...] -u <unit>
+# (list of units: ./ttbarMakeHist [-s ...] -l), copy hist/parts/ of all
+# jobs back and run ./ttbarMakeHist [-s ...] -m for the merge.
+# One sample can be rerun in this way without touching the others.
+#
+if [ $# -lt 1 ]
+then
+  echo "Usage: $0 <nproc> [-s <name>[,<name>...]]"
+  exit 1
+fi
+NP=$1
+shift
+OPT="$@"
+mkdir -p hist/parts
+
+nunits=`./ttbarMakeHist ${OPT} -l | grep -c "^unit "`
+if [ ${nunits} -eq 0 ]
+then
+  echo "No work units"
+  exit 1
+fi
+echo "Processing ${nunits} units with ${NP} processes"
+# each process: one unit, exit code is checked by xargs
+seq 0 $[${nunits}-1] | xargs -P ${NP} -I {} sh -c "./ttbarMakeHist ${OPT} -u {} > hist/parts/log_u{}.txt 2>&1 || { echo 'Unit {} failed, see hist/parts/log_u{}.txt'; exit 1; }"
+if [ $? -ne 0 ]
+then
+  echo "Error: not all units were processed, no merge"
+  exit 1
+fi
+./ttbarMakeHist ${OPT} -m
@@ -0,0 +1,318 @@
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+// >>>>>>>>>>>>>> Helper for sample manifest and work units >>>>>>>>>>>>>
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+//
+// The samples (inputs of the event reconstruction, see ZEventRecoInput
+// in eventReco.h) are read from the manifest file (samples.txt by
+// default, see settings.h): one line per sample
+//   <name> <type> <level> <channels> <weight> <files> [<files> ...]
+// with
+//   name: name pattern for output histograms
+//   type: 1 data, 2 MC signal, 3 MC 'ttbar other', 4 MC background
+//   level: reco (reconstruction level) or gen (generator level)
+//   channels: decay channels (1 ee, 2 mumu, 3 emu), e.g. 123 for all three
+//   weight: weight for histogram filling
+//   files: input ROOT ntuples (patterns as for TChain::Add()), ${DATA} and
+//          ${MC} are replaced by the data and MC directories
+// Empty lines and lines starting with '#' are ignored.
+//
+// For parallel processing, the samples are split into work units (see
+// MakeUnits() below): each unit is one range of input files of one group
+// of samples with the same input files (which are processed in one pass,
+// see eventrecoPass() in eventReco.h). Each unit can be processed
+// independently (in a separate process or on a batch node, see runHist.sh),
+// producing partial outputs <Name>-c<Channel>.part<N>.root in gHistDir/parts,
+// which are afterwards summed up (see MergeUnits() below) into the
+// usual output files <Name>-c<Channel>.root in gHistDir.
+
+#ifndef TTBAR_SAMPLES_H
+#define TTBAR_SAMPLES_H
+
+// additional files from this analysis
+#include "eventReco.h"
+#include "settings.h"
+// C++ library or ROOT header files
+#include <vector>
+#include <string>
+#include <fstream>
+#include <sstream>
+#include <glob.h>
+#include <TString.h>
+#include <TFile.h>
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+// >>>>>>>>>>>>>>>>>>>>>>>> Read manifest >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+//
+// Arguments:
+//   const TString& fileName: manifest file (see format above)
+//   const TString& dataDir, const TString& mcDir: replacements for ${DATA} and ${MC}
+//   const std::vector<ZVarHisto>& vecVH: histograms for reconstruction level (copied for each input)
+//   const std::vector<ZVarHisto>& vecVHGen: histograms for generator level (copied for each input)
+//   const std::vector<TString>& vecSelected: names of samples to be read (all if empty)
+//   std::vector<ZEventRecoInput>& vecIn: inputs for event reconstruction, one per sample
+//          and channel (output, appended)
+//
+void ReadSamples(const TString& fileName, const TString& dataDir, const TString& mcDir,
+  const std::vector<ZVarHisto>& vecVH, const std::vector<ZVarHisto>& vecVHGen,
+  const std::vector<TString>& vecSelected, std::vector<ZEventRecoInput>& vecIn)
+{
+  std::ifstream file(fileName.Data());
+  if(!file.is_open())
+  {
+    printf("Error: cannot open sample manifest %s\n", fileName.Data());
+    exit(1);
+  }
+  std::vector<bool> found(vecSelected.size(), false);
+  // samples and their channels, in the order of the manifest
+  std::vector<ZEventRecoInput> vecSample;
+  std::vector<std::string> vecChannels;
+  std::string line;
+  for(int l = 1; std::getline(file, line); l++)
+  {
+    std::istringstream words(line);
+    std::string name, level, channels;
+    int type = 0;
+    double weight = 0.0;
+    if(!(words >> name) || name[0] == '#')
+      continue;
+    if(!(words >> type >> level >> channels >> weight) || type < 1 || type > 4 || (level != "reco" && level != "gen"))
+    {
+      printf("Error: wrong sample definition in %s, line %d:\n%s\n", fileName.Data(), l, line.c_str());
+      exit(1);
+    }
+    if(channels.find_first_not_of("123") != std::string::npos)
+    {
+      printf("Error: wrong channels %s for sample %s in %s, line %d\n", channels.c_str(), name.c_str(), fileName.Data(), l);
+      exit(1);
+    }
+    // only the selected samples
+    bool selected = vecSelected.empty();
+    for(int s = 0; s < vecSelected.size(); s++)
+      if(vecSelected[s] == name.c_str())
+        selected = found[s] = true;
+    if(!selected)
+      continue;
+    ZEventRecoInput in;
+    in.Name = name;
+    in.Type = type;
+    in.Gen = (level == "gen");
+    in.Weight = weight;
+    in.VecVarHisto = in.Gen ? vecVHGen : vecVH;
+    std::string pattern;
+    while(words >> pattern)
+    {
+      TString str = pattern;
+      str.ReplaceAll("${DATA}", dataDir);
+      str.ReplaceAll("${MC}", mcDir);
+      in.AddToChain(str);
+    }
+    if(in.VecInFile.empty())
+    {
+      printf("Error: no input files for sample %s in %s, line %d\n", name.c_str(), fileName.Data(), l);
+      exit(1);
+    }
+    vecSample.push_back(std::move(in));
+    vecChannels.push_back(channels);
+  }
+  // one input per sample and channel, ordered by channel (ch = 1 ee, ch = 2 mumu, ch = 3 emu)
+  for(int ch = 1; ch <= 3; ch++)
+  {
+    for(int s = 0; s < vecSample.size(); s++)
+    {
+      if(vecChannels[s].find('0' + ch) == std::string::npos)
+        continue;
+      vecIn.push_back(vecSample[s]);
+      vecIn.back().Channel = ch;
+    }
+  }
+  for(int s = 0; s < vecSelected.size(); s++)
+  {
+    if(!found[s])
+    {
+      printf("Error: sample %s not found in %s\n", vecSelected[s].Data(), fileName.Data());
+      exit(1);
+    }
+  }
+}
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+// >>>>>>>>>>>>>>>>>>>>>>>> Work units >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+//
+// One range of input files for a group of inputs with the same input files
+//
+class ZRecoUnit
+{
+  public:
+    std::vector<int> VecInput; // inputs (indices in the input container)
+    std::vector<TString> VecInFile; // input files of this unit
+    int Part; // number of this file range in the group
+    int NParts; // number of file ranges in the group
+};
+
+// expand patterns of input files into file names (sorted for each pattern), patterns
+// which do not match local files (e.g. remote files) are kept as they are
+std::vector<TString> ExpandInputFiles(const std::vector<TString>& vecInFile)
+{
+  std::vector<TString> vecFile;
+  for(int f = 0; f < vecInFile.size(); f++)
+  {
+    glob_t g;
+    if(glob(vecInFile[f].Data(), 0, NULL, &g) == 0)
+    {
+      for(size_t i = 0; i < g.gl_pathc; i++)
+        vecFile.push_back(g.gl_pathv[i]);
+    }
+    else
+      vecFile.push_back(vecInFile[f]);
+    globfree(&g);
+  }
+  return vecFile;
+}
+
+// Split inputs into work units: inputs with the same input files are grouped
+// (as in eventrecoMulti() with flagSinglePass, see eventReco.h), the input files
+// of each group are split into ranges of nFilesUnit files.
+// The units depend only on the inputs and the input files, i.e. they are the same
+// in each process which reads the same manifest.
+void MakeUnits(const std::vector<ZEventRecoInput>& vecIn, const int nFilesUnit, std::vector<ZRecoUnit>& vecUnit)
+{
+  std::vector<bool> done(vecIn.size(), false);
+  for(int i = 0; i < vecIn.size(); i++)
+  {
+    if(done[i])
+      continue;
+    std::vector<int> vecGroup;
+    for(int j = i; j < vecIn.size(); j++)
+    {
+      if(done[j] || vecIn[j].VecInFile != vecIn[i].VecInFile)
+        continue;
+      vecGroup.push_back(j);
+      done[j] = true;
+    }
+    std::vector<TString> vecFile = ExpandInputFiles(vecIn[i].VecInFile);
+    const int nParts = (vecFile.size() + nFilesUnit - 1) / nFilesUnit;
+    for(int p = 0; p < nParts; p++)
+    {
+      ZRecoUnit unit;
+      unit.VecInput = vecGroup;
+      unit.Part = p;
+      unit.NParts = nParts;
+      for(int f = p * nFilesUnit; f < vecFile.size() && f < (p + 1) * nFilesUnit; f++)
+        unit.VecInFile.push_back(vecFile[f]);
+      vecUnit.push_back(unit);
+    }
+  }
+}
+
+// print the list of units
+void PrintUnits(const std::vector<ZEventRecoInput>& vecIn, const std::vector<ZRecoUnit>& vecUnit)
+{
+  for(int u = 0; u < vecUnit.size(); u++)
+  {
+    const ZRecoUnit& unit = vecUnit[u];
+    printf("unit %d: part %d/%d, %ld files:", u, unit.Part, unit.NParts, unit.VecInFile.size());
+    for(int i = 0; i < unit.VecInput.size(); i++)
+      printf(" %s-c%d", vecIn[unit.VecInput[i]].Name.Data(), vecIn[unit.VecInput[i]].Channel);
+    printf("\n");
+  }
+}
+
+// input for the partial output of the unit
+ZEventRecoInput UnitInput(const ZEventRecoInput& in, const ZRecoUnit& unit)
+{
+  ZEventRecoInput part = in;
+  part.VecInFile = unit.VecInFile;
+  part.OutDir = gHistDir + "/parts";
+  part.Part = unit.Part;
+  return part;
+}
+
+// Process one unit: partial outputs are stored in gHistDir/parts
+// (see eventrecoMulti() in eventReco.h for nThreads, flagCache and flagIncremental)
+void eventrecoUnit(const std::vector<ZEventRecoInput>& vecIn, const ZRecoUnit& unit, int nThreads = 1, bool flagCache = false, bool flagIncremental = false)
+{
+  std::vector<ZEventRecoInput> vecUnitIn;
+  for(int i = 0; i < unit.VecInput.size(); i++)
+    vecUnitIn.push_back(UnitInput(vecIn[unit.VecInput[i]], unit));
+  eventrecoMulti(vecUnitIn, true, nThreads, flagCache, flagIncremental);
+}
+
+// Merge partial outputs of all units (all of them should be processed already
+// with the same settings, see eventrecoUnit() above) into the output files of
+// the inputs: histograms of the inputs (which should be empty) are summed up
+// from the partial outputs and stored
+void MergeUnits(std::vector<ZEventRecoInput>& vecIn, const std::vector<ZRecoUnit>& vecUnit)
+{
+  for(int u = 0; u < vecUnit.size(); u++)
+  {
+    const ZRecoUnit& unit = vecUnit[u];
+    for(int i = 0; i < unit.VecInput.size(); i++)
+    {
+      ZEventRecoInput& in = vecIn[unit.VecInput[i]];
+      // partial output of this unit, it should be produced with the current 
+      // settings (see ZEventRecoInput::Fingerprint() in eventReco.h)
+      ZEventRecoInput part = UnitInput(in, unit);
+      const unsigned long long fingerprint = part.Fingerprint();
+      for(int v = -1; v < in.NVariations(); v++)
+      {
+        if(part.StoredFingerprint(v) != fingerprint)
+        {
+          printf("Error: %s is missing or outdated (process unit %d again)\n", part.OutFileName(v).Data(), u);
+          exit(1);
+        }
+        TFile* f = TFile::Open(part.OutFileName(v));
+        std::vector<ZVarHisto>& vecVarHisto = in.Histos(v);
+        for(int h = 0; h < vecVarHisto.size(); h++)
+        {
+          TH1* histo = (TH1*)f->Get(vecVarHisto[h].H().Name());
+          if(!histo)
+          {
+            printf("Error: no histogram %s in %s\n", vecVarHisto[h].H().Name().Data(), part.OutFileName(v).Data());
+            exit(1);
+          }
+          vecVarHisto[h].H().Add(histo);
+        }
+#ifdef TTBAR_PROFILE
+        // cut flow and timing (see profile.h) are summed over units, if stored
+        // (timing is the same in all files of a unit, taken from the nominal one)
+        TH1D* cutFlow = (TH1D*)f->Get("cutflow");
+        if(cutFlow)
+        {
+          if(in.VecCutFlow.size() == v + 1)
+          {
+            in.VecCutFlow.push_back(new TH1D(*cutFlow));
+            in.VecCutFlow.back()->SetDirectory(0);
+          }
+          else
+            in.VecCutFlow[v + 1]->Add(cutFlow);
+        }
+        TH1D* timing = (v < 0) ? (TH1D*)f->Get("timing") : NULL;
+        if(timing)
+        {
+          if(!in.Timing)
+          {
+            in.Timing = new TH1D(*timing);
+            in.Timing->SetDirectory(0);
+          }
+          else
+            in.Timing->Add(timing);
+        }
+#endif
+        f->Close();
+        delete f;
+      }
+    }
+  }
+  for(int i = 0; i < vecIn.size(); i++)
+  {
+    vecIn[i].WriteHistos();
+    vecIn[i].ReleaseHistos();
+    printf("merged: %s\n", vecIn[i].OutFileName(-1).Data());
+  }
+}
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+
+#endif
@@ -4,16 +4,80 @@
 // Consult analysis documentation (papers, description-ttbar.pdf) for 
 // better description of applied cuts etc.
 
+#ifndef TTBAR_SELECTION_H
+#define TTBAR_SELECTION_H
+
 // additional files from this analysis 
 #include "tree.h"
+#include "fourVector.h"
+#include "profile.h"
 // C++ library or ROOT header files
-#include <TLorentzVector.h>
+#include <vector>
+#include <TMath.h>
 
 // constants: electron and muon masses
 // (not the best practice to make them global variables, be aware)
 const double massEl = 0.000511;
 const double massMu = 0.105658;
 
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+// >>>>>>>>>>>>>>>>>>>>>>>>> Selection cuts >>>>>>>>>>>>>>>>>>>>>>>>>>>>
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+//
+// All cuts of the event selection below. The preselected event cache 
+// (see preselCache.h) is keyed by the content of this structure, so 
+// it is rebuilt automatically when any cut is changed here. If the 
+// selection code itself is changed, increase gSelectionVersion.
+//
+const int gSelectionVersion = 3;
+struct ZSelectionCuts
+{
+  // electrons
+  double ElPtMin = 20.0; // pT(e) > 20 GeV
+  double ElEtaMax = 2.4; // |eta(e)| < 2.4
+  double ElIso03Max = 0.17; // isolation (delta_R = 0.3) < 0.17
+  double ElMissHitsMax = 0.0; // no missing hits
+  // muons
+  double MuPtMin = 20.0; // pT(mu) > 20 GeV
+  double MuEtaMax = 2.4; // |eta(mu)| < 2.4
+  double MuIso03Max = 0.20; // isolation (delta_R = 0.3) < 0.20
+  double MuHitsValidMin = 12.0; // at least 12 valid hits
+  double MuHitsPixelMin = 2.0; // at least 2 pixel hits
+  double MuDistPV0Max = 0.02; // transverse impact parameter < 0.2 mm
+  double MuDistPVzMax = 0.5; // distance in z < 5 mm
+  double MuTrackChi2NDOFMax = 10.0; // global track chi2/dof < 10
+  // dileptons
+  double DiLepMassMin = 12.0; // dilepton mass > 12 GeV
+  double DiLepZVetoMin = 76.0; // ee and mumu: dilepton mass outside (76, 106) GeV
+  double DiLepZVetoMax = 106.0;
+  double MetMin = 30.0; // ee and mumu: missing transverse energy > 30 GeV
+  // primary vertex
+  double PvNMin = 1.0; // at least one primary vertex
+  double PvNDOFMin = 4.0; // its number of degrees of freedom >= 4
+  double PvRhoMax = 2.0; // transverse distance to the beam <= 2 cm
+  double PvZMax = 24.0; // |z| <= 24 cm
+  // jets (systematic variations can only increase JetPtMin, see ZEventRecoVariation in eventReco.h)
+  double JetEtaMax = 2.4; // |eta(jet)| < 2.4
+  double JetPtMin = 30.0; // corrected pT(jet) > 30 GeV
+  double JetNMin = 2.0; // at least two jets
+  // b-tagging discriminator for Combined Secondary Vertex Loose 
+  // (consult https://twiki.cern.ch/twiki/bin/view/CMSPublic/BtagRecommendation2011OpenData),
+  // at least one b-tagged jet is required (see SelectJets() below)
+  double BTagDiscrMin = 0.244; 
+  // triggers: see gTriggerMask below
+};
+const ZSelectionCuts gSelectionCuts;
+
+// trigger bit mask with bits first ... last - 1 set
+constexpr int TriggerMask(const int first, const int last)
+{
+  return (first >= last) ? 0 : ((1 << first) | TriggerMask(first + 1, last));
+}
+// triggers for ee, mumu and emu channels (index = channel), at least one of them 
+// should be fired: bits 6-10, 0-4 and 12-16 (see trigger bits in Analyzer/src/Analyzer.cc),
+// also in the preselected event cache key (see preselCache.h)
+constexpr int gTriggerMask[4] = { 0, TriggerMask(6, 11), TriggerMask(0, 5), TriggerMask(12, 17) };
+
 // Routine for electron selection
 // Arguments:
 //   const ZTree* preselTree: input tree (see tree.h), GetEntry() should be done already
@@ -23,16 +87,16 @@ const double massMu = 0.105658;
 bool SelectEl(const ZTree* preselTree, const int el)
 {
   // require pT(e) > 20 GeV
-  if(TMath::Abs(preselTree->elPt[el]) < 20.0)
+  if(TMath::Abs(preselTree->elPt[el]) < gSelectionCuts.ElPtMin)
     return false;
   // require |eta(e)| > 2.4
-  if(TMath::Abs(preselTree->elEta[el]) > 2.4)
+  if(TMath::Abs(preselTree->elEta[el]) > gSelectionCuts.ElEtaMax)
     return false;
   // require isolation (delta_R = 0.3) > 0.17
-  if(preselTree->elIso03[el] > 0.17)
+  if(preselTree->elIso03[el] > gSelectionCuts.ElIso03Max)
     return false;
   // require no missing hits
-  if(preselTree->elMissHits[el] > 0)
+  if(preselTree->elMissHits[el] > gSelectionCuts.ElMissHitsMax)
     return false;
   // cuts on conversiopn variables not applied: study them if you want
   //if(preselTree->elConvDist[el] < 0.02 && preselTree->elConvDcot[el] < 0.02 && preselTree->elConvDist[el] >= 0.0 && preselTree->elConvDcot[el] >=0.0)
@@ -50,167 +114,369 @@ bool SelectEl(const ZTree* preselTree, const int el)
 bool SelectMu(const ZTree* preselTree, const int mu)
 {
   // require pT(mu) > 20 GeV
-  if(TMath::Abs(preselTree->muPt[mu]) < 20.0)
+  if(TMath::Abs(preselTree->muPt[mu]) < gSelectionCuts.MuPtMin)
     return false;
   // require |eta(mu)| > 2.4
-  if(TMath::Abs(preselTree->muEta[mu]) > 2.4)
+  if(TMath::Abs(preselTree->muEta[mu]) > gSelectionCuts.MuEtaMax)
     return false;
   // require isolation (delta_R = 0.3) > 0.20
-  if(preselTree->muIso03[mu] > 0.20)
+  if(preselTree->muIso03[mu] > gSelectionCuts.MuIso03Max)
     return false;
   // require at least 11 tracker hits and at least 1 pixel hit
-  if(preselTree->muHitsValid[mu] < 12 || preselTree->muHitsPixel[mu] < 2)
+  if(preselTree->muHitsValid[mu] < gSelectionCuts.MuHitsValidMin || preselTree->muHitsPixel[mu] < gSelectionCuts.MuHitsPixelMin)
     return false;
   // the transverse impact parameter of the muon w.r.t the primary vertex should be smaller than 0.2 mm, 
   // the corresponding distance in z should be smaller than 5 mm and the global track should have chi2/dof > 10
-  if(preselTree->muDistPV0[mu] > 0.02 || preselTree->muDistPVz[mu] > 0.5 || preselTree->muTrackChi2NDOF[mu] > 10)
+  if(preselTree->muDistPV0[mu] > gSelectionCuts.MuDistPV0Max || preselTree->muDistPVz[mu] > gSelectionCuts.MuDistPVzMax || 
+     preselTree->muTrackChi2NDOF[mu] > gSelectionCuts.MuTrackChi2NDOFMax)
     return false;
   // all cuts passed: return true
   return true;
 }
 
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+// >>>>>>>>>>>>>>>>>>>>>> Lepton candidates >>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+//
+// The dilepton selection below first selects the lepton candidates of 
+// each collection in one sweep over the fixed size arrays of ZTree 
+// (the same cuts as SelectEl() and SelectMu() above, evaluated without 
+// branches for all maxNel or maxNmu entries, so that the loop can be 
+// vectorised, the result is a bit mask of selected leptons), then the 
+// four-vectors of selected leptons are built once and the pairs are 
+// formed from them.
+//
+// bit mask of selected electrons (bit el is set if SelectEl() is true)
+unsigned int SelectElMask(const ZTree* preselTree)
+{
+  // cuts for all entries (vectorised loop), then the bit mask
+  int pass[ZTree::maxNel];
+  for(int el = 0; el < ZTree::maxNel; el++)
+    pass[el] = !(TMath::Abs(preselTree->elPt[el]) < gSelectionCuts.ElPtMin) &
+               !(TMath::Abs(preselTree->elEta[el]) > gSelectionCuts.ElEtaMax) &
+               !(preselTree->elIso03[el] > gSelectionCuts.ElIso03Max) &
+               !(preselTree->elMissHits[el] > gSelectionCuts.ElMissHitsMax);
+  unsigned int mask = 0;
+  for(int el = 0; el < ZTree::maxNel; el++)
+    mask |= (unsigned int)pass[el] << el;
+  // only the filled entries
+  return mask & ((1u << TMath::Min(preselTree->Nel, ZTree::maxNel)) - 1);
+}
+
+// bit mask of selected muons (bit mu is set if SelectMu() is true)
+unsigned int SelectMuMask(const ZTree* preselTree)
+{
+  // cuts for all entries (vectorised loop), then the bit mask
+  int pass[ZTree::maxNmu];
+  for(int mu = 0; mu < ZTree::maxNmu; mu++)
+    pass[mu] = !(TMath::Abs(preselTree->muPt[mu]) < gSelectionCuts.MuPtMin) &
+               !(TMath::Abs(preselTree->muEta[mu]) > gSelectionCuts.MuEtaMax) &
+               !(preselTree->muIso03[mu] > gSelectionCuts.MuIso03Max) &
+               !(preselTree->muHitsValid[mu] < gSelectionCuts.MuHitsValidMin) &
+               !(preselTree->muHitsPixel[mu] < gSelectionCuts.MuHitsPixelMin) &
+               !(preselTree->muDistPV0[mu] > gSelectionCuts.MuDistPV0Max) &
+               !(preselTree->muDistPVz[mu] > gSelectionCuts.MuDistPVzMax) &
+               !(preselTree->muTrackChi2NDOF[mu] > gSelectionCuts.MuTrackChi2NDOFMax);
+  unsigned int mask = 0;
+  for(int mu = 0; mu < ZTree::maxNmu; mu++)
+    mask |= (unsigned int)pass[mu] << mu;
+  // only the filled entries
+  return mask & ((1u << TMath::Min(preselTree->Nmu, ZTree::maxNmu)) - 1);
+}
+
+// selected leptons of one collection (in the order of the input tree)
+struct ZLeptonCandidates
+{
+  static const int zMaxN = (ZTree::maxNel > ZTree::maxNmu) ? ZTree::maxNel : ZTree::maxNmu;
+  int zN; // number of selected leptons
+  float zPtSigned[zMaxN]; // pT with charge sign (as in the input tree)
+  ZPxPyPzE zP4[zMaxN]; // four-vectors
+  double zPt[zMaxN]; // pT of the four-vectors (calculated once, used for all pairs)
+
+  // constructor: leptons with bits set in mask, from the arrays of the input tree
+  ZLeptonCandidates(const unsigned int mask, const float* pt, const float* eta, const float* phi, const double mass)
+  {
+    zN = 0;
+    for(unsigned int m = mask; m; m &= m - 1)
+    {
+      const int l = __builtin_ctz(m);
+      zPtSigned[zN] = pt[l];
+      zP4[zN].SetPtEtaPhiM(TMath::Abs(pt[l]), eta[l], phi[l], mass);
+      zPt[zN] = zP4[zN].Pt();
+      zN++;
+    }
+  }
+};
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+
 // routine for electron-muon pair selection
 // (select best e-mu pair in the event, with highest pT)
 // Arguments:
 //   const ZTree* preselTree: input tree (see tree.h), GetEntry() should be done already
-//   TLorentzVector& vecLepM: selected lepton- (output)
-//   TLorentzVector& vecLepP: selected lepton+ (output)
+//   ZPxPyPzE& vecLepM: selected lepton- (output)
+//   ZPxPyPzE& vecLepP: selected lepton+ (output)
 //   double& maxPtDiLep: transverse momentum of the selected dilepton pair (output)
 // If no dilepton pair is selected, maxPtDiLep remains unchanged 
 // (not the best practice to make them global variables, be aware)
-void SelectDilepEMu(const ZTree* preselTree, TLorentzVector& vecLepM, TLorentzVector& vecLepP, double& maxPtDiLep)
+void SelectDilepEMu(const ZTree* preselTree, ZPxPyPzE& vecLepM, ZPxPyPzE& vecLepP, double& maxPtDiLep)
 {
+  // lepton candidates (see above)
+  const unsigned int maskEl = SelectElMask(preselTree);
+  if(!maskEl)
+    return;
+  const unsigned int maskMu = SelectMuMask(preselTree);
+  if(!maskMu)
+    return;
+  const ZLeptonCandidates els(maskEl, preselTree->elPt, preselTree->elEta, preselTree->elPhi, massEl);
+  const ZLeptonCandidates mus(maskMu, preselTree->muPt, preselTree->muEta, preselTree->muPhi, massMu);
   // loop over electrons
-  for(int el = 0; el < preselTree->Nel; el++)
+  for(int el = 0; el < els.zN; el++)
   {
-    // electron selection
-    if(!SelectEl(preselTree, el))
-      continue;
-    TLorentzVector thisEl;
-    thisEl.SetPtEtaPhiM(TMath::Abs(preselTree->elPt[el]), preselTree->elEta[el], preselTree->elPhi[el], massEl);
+    const ZPxPyPzE& thisEl = els.zP4[el];
     // loop over muons
-    for(int mu = 0; mu < preselTree->Nmu; mu++)
+    for(int mu = 0; mu < mus.zN; mu++)
     {
       // require opposite signs
-      if(preselTree->elPt[el] * preselTree->muPt[mu] > 0)
-        continue;
-      // muon selection
-      if(!SelectMu(preselTree, mu))
+      if(els.zPtSigned[el] * mus.zPtSigned[mu] > 0)
         continue;
-      TLorentzVector thisMu;
-      thisMu.SetPtEtaPhiM(TMath::Abs(preselTree->muPt[mu]), preselTree->muEta[mu], preselTree->muPhi[mu], massMu);
+      const ZPxPyPzE& thisMu = mus.zP4[mu];
       // require dilepton mass greater than 12 GeV
-      TLorentzVector vecDiLep = thisEl + thisMu;
-      if(vecDiLep.M() < 12.0)
+      if(thisEl.MSum(thisMu) < gSelectionCuts.DiLepMassMin)
         continue;
       // select pair with highest transverse momentum
-      double sumPt = thisMu.Pt() + thisEl.Pt();
+      double sumPt = mus.zPt[mu] + els.zPt[el];
       if(sumPt < maxPtDiLep)
         continue;
       maxPtDiLep = sumPt;
       // assign el and mu momenta to output l+ and l- vectors
-      vecLepM = (preselTree->elPt[el] < 0) ? thisEl : thisMu;
-      vecLepP = (preselTree->elPt[el] < 0) ? thisMu : thisEl;
+      vecLepM = (els.zPtSigned[el] < 0) ? thisEl : thisMu;
+      vecLepP = (els.zPtSigned[el] < 0) ? thisMu : thisEl;
     }
   }
 }
 
-// routine for electron-electron pair selection
-// (select best e-e pair in the event, with highest pT)
+// routine for same flavour pair selection (used for ee and mumu, see below)
+// (select best pair of the lepton candidates, with highest pT)
 // Arguments:
-//   const ZTree* preselTree: input tree (see tree.h), GetEntry() should be done already
-//   TLorentzVector& vecLepM: selected lepton- (output)
-//   TLorentzVector& vecLepP: selected lepton+ (output)
+//   const ZLeptonCandidates& leps: lepton candidates (see above)
+//   ZPxPyPzE& vecLepM: selected lepton- (output)
+//   ZPxPyPzE& vecLepP: selected lepton+ (output)
 //   double& maxPtDiLep: transverse momentum of the selected dilepton pair (output)
 // If no dilepton pair is selected, maxPtDiLep remains unchanged 
-// (not the best practice to make them global variables, be aware)
-void SelectDilepEE(const ZTree* preselTree, TLorentzVector& vecLepM, TLorentzVector& vecLepP, double& maxPtDiLep)
+void SelectDilepSameFlavour(const ZLeptonCandidates& leps, ZPxPyPzE& vecLepM, ZPxPyPzE& vecLepP, double& maxPtDiLep)
 {
-  // loop over 1st electron
-  for(int el1 = 0; el1 < preselTree->Nel; el1++)
+  // loop over 1st lepton
+  for(int l1 = 0; l1 < leps.zN; l1++)
   {
-    // electron selection
-    if(!SelectEl(preselTree, el1))
-      continue;
-    TLorentzVector thisEl1;
-    thisEl1.SetPtEtaPhiM(TMath::Abs(preselTree->elPt[el1]), preselTree->elEta[el1], preselTree->elPhi[el1], massEl);
-    // loop over 2nd electron
-    for(int el2 = el1 + 1; el2 < preselTree->Nel; el2++)
+    const ZPxPyPzE& thisLep1 = leps.zP4[l1];
+    // loop over 2nd lepton
+    for(int l2 = l1 + 1; l2 < leps.zN; l2++)
     {
       // require opposite signs
-      if(preselTree->elPt[el1] * preselTree->elPt[el2] > 0)
-        continue;
-      // electron selection
-      if(!SelectEl(preselTree, el2))
+      if(leps.zPtSigned[l1] * leps.zPtSigned[l2] > 0)
         continue;
-      TLorentzVector thisEl2;
-      thisEl2.SetPtEtaPhiM(TMath::Abs(preselTree->elPt[el2]), preselTree->elEta[el2], preselTree->elPhi[el2], massEl);
+      const ZPxPyPzE& thisLep2 = leps.zP4[l2];
       // require dilepton mass greater than 12 GeV
-      TLorentzVector vecDiLep = thisEl1 + thisEl2;
-      if(vecDiLep.M() < 12.0)
+      const double mass = thisLep1.MSum(thisLep2);
+      if(mass < gSelectionCuts.DiLepMassMin)
         continue;
       // this is additional invariant mass requirement for ee and mumu
       // (to supress Drell-Yan background)
-      if(vecDiLep.M() > 76.0 && vecDiLep.M() < 106.0)
+      if(mass > gSelectionCuts.DiLepZVetoMin && mass < gSelectionCuts.DiLepZVetoMax)
         continue;
       // select pair with highest transverse momenta
-      double sumPt = thisEl1.Pt() + thisEl2.Pt();
+      double sumPt = leps.zPt[l1] + leps.zPt[l2];
       if(sumPt < maxPtDiLep)
         continue;
       maxPtDiLep = sumPt;
-      // assign el and mu momenta to output l+ and l- vectors
-      vecLepM = (preselTree->elPt[el1] < 0) ? thisEl1 : thisEl2;
-      vecLepP = (preselTree->elPt[el1] < 0) ? thisEl2 : thisEl1;
+      // assign lepton momenta to output l+ and l- vectors
+      vecLepM = (leps.zPtSigned[l1] < 0) ? thisLep1 : thisLep2;
+      vecLepP = (leps.zPtSigned[l1] < 0) ? thisLep2 : thisLep1;
     }
   }
 }
 
+// routine for electron-electron pair selection
+// (select best e-e pair in the event, with highest pT)
+// Arguments:
+//   const ZTree* preselTree: input tree (see tree.h), GetEntry() should be done already
+//   ZPxPyPzE& vecLepM: selected lepton- (output)
+//   ZPxPyPzE& vecLepP: selected lepton+ (output)
+//   double& maxPtDiLep: transverse momentum of the selected dilepton pair (output)
+// If no dilepton pair is selected, maxPtDiLep remains unchanged 
+// (not the best practice to make them global variables, be aware)
+void SelectDilepEE(const ZTree* preselTree, ZPxPyPzE& vecLepM, ZPxPyPzE& vecLepP, double& maxPtDiLep)
+{
+  const unsigned int mask = SelectElMask(preselTree);
+  // at least two electrons are needed
+  if(!(mask & (mask - 1)))
+    return;
+  const ZLeptonCandidates els(mask, preselTree->elPt, preselTree->elEta, preselTree->elPhi, massEl);
+  SelectDilepSameFlavour(els, vecLepM, vecLepP, maxPtDiLep);
+}
+
 // routine for muon-muon pair selection
 // (select best mu-mu pair in the event, with highest pT)
 // Arguments:
 //   const ZTree* preselTree: input tree (see tree.h), GetEntry() should be done already
-//   TLorentzVector& vecLepM: selected lepton- (output)
-//   TLorentzVector& vecLepP: selected lepton+ (output)
+//   ZPxPyPzE& vecLepM: selected lepton- (output)
+//   ZPxPyPzE& vecLepP: selected lepton+ (output)
 //   double& maxPtDiLep: transverse momentum of the selected dilepton pair (output)
 // If no dilepton pair is selected, maxPtDiLep remains unchanged 
 // (not the best practice to make them global variables, be aware)
-void SelectDilepMuMu(const ZTree* preselTree, TLorentzVector& vecLepM, TLorentzVector& vecLepP, double& maxPtDiLep)
+void SelectDilepMuMu(const ZTree* preselTree, ZPxPyPzE& vecLepM, ZPxPyPzE& vecLepP, double& maxPtDiLep)
+{
+  const unsigned int mask = SelectMuMask(preselTree);
+  // at least two muons are needed
+  if(!(mask & (mask - 1)))
+    return;
+  const ZLeptonCandidates mus(mask, preselTree->muPt, preselTree->muEta, preselTree->muPhi, massMu);
+  SelectDilepSameFlavour(mus, vecLepM, vecLepP, maxPtDiLep);
+}
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+// >>>>>>>>>>>>>>>>>>>>>> Preselected event >>>>>>>>>>>>>>>>>>>>>>>>>>>>
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+//
+// Everything needed for the kinematic reconstruction of an event 
+// preselected in one channel (see SelectEvent() below)
+//
+class ZPreselEvent
+{
+  public:
+    ZPxPyPzE LepM, LepP; // selected lepton- and lepton+
+    std::vector<ZPxPyPzE> VecJets; // selected jets (b-tagging flags are set in SelectJets())
+    std::vector<double> VecBTagDiscr; // b-tagging discriminators of selected jets
+    double MetPx, MetPy; // missing transverse energy components
+#ifdef TTBAR_PROFILE
+    int LastCut; // last passed cut (see ZCutFlow in profile.h), also if the event is not selected
+#endif
+};
+
+// Routine for the event preselection in one channel: primary vertex, 
+// triggers, dilepton pair (and missing transverse energy for ee and mumu), 
+// at least two jets (b-tagging is required afterwards, see SelectJets() below)
+// Template argument:
+//   channel: 1 ee, 2 mumu, 3 emu (the trigger mask, MET cut and dilepton 
+//            selection are resolved at compile time)
+// Arguments:
+//   const ZTree* preselTree: input tree (see tree.h), GetEntry() should be done already
+//   ZPreselEvent& ev: selected leptons, jets and missing transverse energy (output)
+// Returns true for preselected event, false otherwise.
+template<int channel>
+bool SelectEvent(const ZTree* preselTree, ZPreselEvent& ev)
 {
-  // loop over 1st muon
-  for(int mu1 = 0; mu1 < preselTree->Nmu; mu1++)
+  static_assert(channel >= 1 && channel <= 3, "SelectEvent: channel should be 1, 2 or 3");
+  PROFILE_CUT(ev, cutTruth);
+  // primary vertex selection
+  if(preselTree->Npv < gSelectionCuts.PvNMin || preselTree->pvNDOF < gSelectionCuts.PvNDOFMin || 
+     preselTree->pvRho > gSelectionCuts.PvRhoMax || TMath::Abs(preselTree->pvZ) > gSelectionCuts.PvZMax)
+    return false;
+  PROFILE_CUT(ev, cutVertex);
+  // trigger: accept the event if at least one needed trigger bit is fired
+  constexpr int triggerMask = gTriggerMask[channel];
+  if(!(preselTree->Triggers & triggerMask))
+    return false;
+  PROFILE_CUT(ev, cutTrigger);
+  // select dilepton pair
+  double maxPtDiLep = -1.0; // initialise with a negative value to determine later on whether a dilepton pair is found in the event
+  if(channel == 3)
+  {
+    PROFILE_CUT(ev, cutMet); // no MET requirement for emu
+    SelectDilepEMu(preselTree, ev.LepM, ev.LepP, maxPtDiLep);
+  }
+  else
   {
-    // muon selection
-    if(!SelectMu(preselTree, mu1))
+    // ee and mumu: additional requirement on the missing transverse energy
+    double met = TMath::Sqrt(TMath::Power(preselTree->metPx, 2.0) + TMath::Power(preselTree->metPy, 2.0));
+    if(met <= gSelectionCuts.MetMin)
+      return false;
+    PROFILE_CUT(ev, cutMet);
+    if(channel == 1)
+      SelectDilepEE(preselTree, ev.LepM, ev.LepP, maxPtDiLep);
+    else
+      SelectDilepMuMu(preselTree, ev.LepM, ev.LepP, maxPtDiLep);
+  }
+  // check if there is a dilepton pair found, otherwise skip the event
+  if(maxPtDiLep < 0.0)
+    return false;
+  PROFILE_CUT(ev, cutDilepton);
+  // dilepton pair found, now select jets; 
+  // all jets are stored for kinematic reconstruction
+  ev.VecJets.clear();
+  ev.VecBTagDiscr.clear();
+  for(int j = 0; j < preselTree->Njet; j++)
+  {
+    if(TMath::Abs(preselTree->jetEta[j]) > gSelectionCuts.JetEtaMax)
       continue;
-    TLorentzVector thisMu1;
-    thisMu1.SetPtEtaPhiM(TMath::Abs(preselTree->muPt[mu1]), preselTree->muEta[mu1], preselTree->muPhi[mu1], massMu);
-    // loop over 2nd muon
-    for(int mu2 = mu1 + 1; mu2 < preselTree->Nmu; mu2++)
-    {
-      // require opposite signs
-      if(preselTree->muPt[mu1] * preselTree->muPt[mu2] > 0)
-        continue;
-      // muon selection
-      if(!SelectMu(preselTree, mu2))
-        continue;
-      TLorentzVector thisMu2;
-      thisMu2.SetPtEtaPhiM(TMath::Abs(preselTree->muPt[mu2]), preselTree->muEta[mu2], preselTree->muPhi[mu2], massMu);
-      // require dilepton mass greater than 12 GeV
-      TLorentzVector vecDiLep = thisMu1 + thisMu2;
-      if(vecDiLep.M() < 12.0)
-        continue;
-      // this is additional invariant mass requirement for ee and mumu
-      // (to supress Drell-Yan background)
-      if(vecDiLep.M() > 76.0 && vecDiLep.M() < 106.0)
-        continue;
-      // select pair with highest transverse momenta
-      double sumPt = thisMu1.Pt() + thisMu2.Pt();
-      if(sumPt < maxPtDiLep)
-        continue;
-      maxPtDiLep = sumPt;
-      // assign el and mu momenta to output l+ and l- vectors
-      vecLepM = (preselTree->muPt[mu1] < 0) ? thisMu1 : thisMu2;
-      vecLepP = (preselTree->muPt[mu1] < 0) ? thisMu2 : thisMu1;
-    }
+    // jet energy (as TLorentzVector::SetPtEtaPhiM(), also for negative jet mass)
+    double jetPt = preselTree->jetPt[j];
+    double jetE = ZPxPyPzE::PtEtaPhiM(jetPt, preselTree->jetEta[j], preselTree->jetPhi[j], preselTree->jetMass[j]).E();
+    // subtract muon and electron energy fractions
+    double corrE = jetE - preselTree->jetMuEn[j] - preselTree->jetElEn[j];
+    double corrPt = jetPt * corrE / jetE;
+    // require pT(jet) > 30 GeV
+    if(corrPt < gSelectionCuts.JetPtMin)
+      continue;
+    ev.VecJets.push_back(ZPxPyPzE::PtEtaPhiE(corrPt, preselTree->jetEta[j], preselTree->jetPhi[j], corrE));
+    ev.VecBTagDiscr.push_back(preselTree->jetBTagDiscr[j]);
   }
+  // if there are no two jets, skip the event
+  if(ev.VecJets.size() < gSelectionCuts.JetNMin)
+    return false;
+  PROFILE_CUT(ev, cutJets);
+  ev.MetPx = preselTree->metPx;
+  ev.MetPy = preselTree->metPy;
+  return true;
 }
+
+// The same for the channel given at run time (const int channel: 1 ee, 2 mumu, 3 emu)
+bool SelectEvent(const ZTree* preselTree, const int channel, ZPreselEvent& ev)
+{
+  switch(channel)
+  {
+    case 1: return SelectEvent<1>(preselTree, ev);
+    case 2: return SelectEvent<2>(preselTree, ev);
+    case 3: return SelectEvent<3>(preselTree, ev);
+  }
+  printf("Error: unknown channel %d\n", channel);
+  exit(1);
+}
+
+// Routine for the final jet selection of the preselected event: jets with pT > jetPtMin, 
+// at least two of them and at least one b-tagged jet (discriminator > bTagDiscrMin); 
+// the nominal thresholds are gSelectionCuts.JetPtMin and gSelectionCuts.BTagDiscrMin
+// (jetPtMin below gSelectionCuts.JetPtMin has no effect: such jets are not preselected)
+// Arguments:
+//   const ZPreselEvent& ev: preselected event (see SelectEvent() above)
+//   const double jetPtMin: jet pT threshold
+//   const double bTagDiscrMin: b-tagging discriminator threshold
+//   std::vector<ZPxPyPzE>& vecJets: selected jets with b-tagging flags (output)
+// Returns true for selected event, false otherwise.
+bool SelectJets(const ZPreselEvent& ev, const double jetPtMin, const double bTagDiscrMin, std::vector<ZPxPyPzE>& vecJets)
+{
+  vecJets.clear();
+  bool oneBTagJet = false;
+  for(int j = 0; j < ev.VecJets.size(); j++)
+  {
+    // the nominal threshold is already applied in the preselection (to the corrected pT 
+    // before the jet is built, which can differ from Pt() of the jet in the last bits),
+    // lower thresholds are rejected at setup (see eventrecoPass() in eventReco.h)
+    if(jetPtMin > gSelectionCuts.JetPtMin && ev.VecJets[j].Pt() < jetPtMin)
+      continue;
+    // b-tagging: check if there at least one b-tagged jet
+    // (b-tagging flag is stored in the jet for the kinematic reconstruction)
+    vecJets.push_back(ev.VecJets[j]);
+    vecJets.back().zBTag = (ev.VecBTagDiscr[j] > bTagDiscrMin);
+    if(vecJets.back().zBTag)
+      oneBTagJet = true;
+  }
+  // if there are no two jets, skip the event
+  if(vecJets.size() < gSelectionCuts.JetNMin)
+    return false;
+  // require at least one b-tagged jet
+  return oneBTagJet;
+}
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+
+#endif
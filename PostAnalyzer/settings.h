@@ -18,6 +18,8 @@ TString gDataDir  = gBaseDir + "./ntuples-data"; // directory with data ntuples
 TString gMcDir    = gBaseDir + "./ntuples-mc"; // directory with MC ntuples
 TString gHistDir  = gBaseDir + "./hist"; // directory with histograms
 TString gPlotsDir = gBaseDir + "./plots"; // directory with final plots
+TString gCacheDir = gBaseDir + "./cache"; // directory with preselected event cache (see preselCache.h)
+TString gSamplesFile = gBaseDir + "./samples.txt"; // manifest with samples for histograms (see samples.h)
 //
 // For exercises, you could use existing "reference" histograms 
 // (they are provided at git) to produce final plots, or even existing 
@@ -8,6 +8,7 @@
 
 #include <TROOT.h>
 #include <TChain.h>
+#include <vector>
 
 // Class which gives access to all information in each event stored in ntuples
 class ZTree {
@@ -22,6 +23,13 @@ public :
    // MC flag (true for MC, false for data)
    bool _flagMC;
 
+   // read-set flags (see SetReadSet())
+   static const int readGen = 1; // generator level (MC only): mcEventType, mcT, mcTbar
+   static const int readReco = 2; // reco level: event selection and kinematic reconstruction
+
+   // default size of the TTreeCache (bytes)
+   static const Long64_t cacheSize = 30000000;
+
    // variable array max sizes
    static const int maxNel = 10; // electrons
    static const int maxNmu = 10; // muons
@@ -133,6 +141,10 @@ public :
    
    // initialise with provided tree pointer
    virtual void    Init(TTree *tree);
+
+   // enable only branches needed for readSet (readGen and/or readReco), 
+   // set up TTreeCache with these branches and cluster prefetching
+   virtual void    SetReadSet(int readSet, Long64_t cache = cacheSize);
 };
 
 // initialise with provided tree pointer
@@ -142,6 +154,7 @@ void ZTree::Init(TTree *tree)
    if (!tree) return;
    fChain = tree;
    fChain->SetMakeClass(1);
+   // (branches not used in the analysis can be absent in "slim" ntuples, see Analyzer/analyzer_cfg.py)
 
    fChain->SetBranchAddress("evRunNumber", &evRunNumber, &b_evRunNumber);
    fChain->SetBranchAddress("evEventNumber", &evEventNumber, &b_evEventNumber);
@@ -150,7 +163,7 @@ void ZTree::Init(TTree *tree)
    fChain->SetBranchAddress("muEta", muEta, &b_muEta);
    fChain->SetBranchAddress("muPhi", muPhi, &b_muPhi);
    fChain->SetBranchAddress("muIso03", muIso03, &b_muIso03);
-   fChain->SetBranchAddress("muIso04", muIso04, &b_muIso04);
+   if(fChain->GetBranch("muIso04")) fChain->SetBranchAddress("muIso04", muIso04, &b_muIso04);
    fChain->SetBranchAddress("muHitsValid", muHitsValid, &b_muHitsValid);
    fChain->SetBranchAddress("muHitsPixel", muHitsPixel, &b_muHitsPixel);
    fChain->SetBranchAddress("muDistPV0", muDistPV0, &b_muDistPV0);
@@ -161,10 +174,10 @@ void ZTree::Init(TTree *tree)
    fChain->SetBranchAddress("elEta", elEta, &b_elEta);
    fChain->SetBranchAddress("elPhi", elPhi, &b_elPhi);
    fChain->SetBranchAddress("elIso03", elIso03, &b_elIso03);
-   fChain->SetBranchAddress("elIso04", elIso04, &b_elIso04);
-   fChain->SetBranchAddress("elConvFlag", elConvFlag, &b_elConvFlag);
-   fChain->SetBranchAddress("elConvDist", elConvDist, &b_elConvDist);
-   fChain->SetBranchAddress("elConvDcot", elConvDcot, &b_elConvDcot);
+   if(fChain->GetBranch("elIso04")) fChain->SetBranchAddress("elIso04", elIso04, &b_elIso04);
+   if(fChain->GetBranch("elConvFlag")) fChain->SetBranchAddress("elConvFlag", elConvFlag, &b_elConvFlag);
+   if(fChain->GetBranch("elConvDist")) fChain->SetBranchAddress("elConvDist", elConvDist, &b_elConvDist);
+   if(fChain->GetBranch("elConvDcot")) fChain->SetBranchAddress("elConvDcot", elConvDcot, &b_elConvDcot);
    fChain->SetBranchAddress("elMissHits", elMissHits, &b_elMissHits);
    fChain->SetBranchAddress("Njet", &Njet, &b_Njet);
    fChain->SetBranchAddress("jetPt", jetPt, &b_jetPt);
@@ -174,8 +187,8 @@ void ZTree::Init(TTree *tree)
    fChain->SetBranchAddress("jetMuEn", jetMuEn, &b_jetMuEn);
    fChain->SetBranchAddress("jetElEn", jetElEn, &b_jetElEn);
    fChain->SetBranchAddress("jetBTagDiscr", jetBTagDiscr, &b_jetBTagDiscr);
-   fChain->SetBranchAddress("jetBTagMatchDiff1", jetBTagMatchDiff1, &b_jetBTagMatchDiff1);
-   fChain->SetBranchAddress("jetBTagMatchDiff2", jetBTagMatchDiff2, &b_jetBTagMatchDiff2);
+   if(fChain->GetBranch("jetBTagMatchDiff1")) fChain->SetBranchAddress("jetBTagMatchDiff1", jetBTagMatchDiff1, &b_jetBTagMatchDiff1);
+   if(fChain->GetBranch("jetBTagMatchDiff2")) fChain->SetBranchAddress("jetBTagMatchDiff2", jetBTagMatchDiff2, &b_jetBTagMatchDiff2);
    fChain->SetBranchAddress("metPx", &metPx, &b_metPx);
    fChain->SetBranchAddress("metPy", &metPy, &b_metPy);
    fChain->SetBranchAddress("Npv", &Npv, &b_Npv);
@@ -189,4 +202,44 @@ void ZTree::Init(TTree *tree)
    if(_flagMC) fChain->SetBranchAddress("mcTbar", mcTbar, &b_mcTbar);
 }
 
+// enable only branches needed for readSet (readGen and/or readReco), 
+// set up TTreeCache with these branches and cluster prefetching
+// (all other branches are not read and not decompressed: 
+// if a new variable is used in the analysis, it should be added here)
+void ZTree::SetReadSet(int readSet, Long64_t cache)
+{
+   // branches for reco level: event selection (triggers, primary vertex), 
+   // lepton selection (selection.h), jets and MET (eventReco.h, kinReco.h)
+   static const char* branchesReco[] = {
+      "Triggers", "Npv", "pvNDOF", "pvZ", "pvRho",
+      "Nmu", "muPt", "muEta", "muPhi", "muIso03", "muHitsValid", "muHitsPixel", "muDistPV0", "muDistPVz", "muTrackChi2NDOF",
+      "Nel", "elPt", "elEta", "elPhi", "elIso03", "elMissHits",
+      "Njet", "jetPt", "jetEta", "jetPhi", "jetMass", "jetMuEn", "jetElEn", "jetBTagDiscr",
+      "metPx", "metPy"
+   };
+   // branches for generator level
+   static const char* branchesGen[] = {
+      "mcEventType", "mcT", "mcTbar"
+   };
+   std::vector<const char*> branches;
+   if(readSet & readReco)
+      branches.insert(branches.end(), branchesReco, branchesReco + sizeof(branchesReco) / sizeof(branchesReco[0]));
+   if((readSet & readGen) && _flagMC)
+      branches.insert(branches.end(), branchesGen, branchesGen + sizeof(branchesGen) / sizeof(branchesGen[0]));
+
+   // enable only needed branches
+   fChain->SetBranchStatus("*", 0);
+   for(unsigned int b = 0; b < branches.size(); b++)
+      fChain->SetBranchStatus(branches[b], 1);
+
+   // TTreeCache: needed branches are added explicitly, the learning phase 
+   // picks up any other branch which is read; clusters are prefetched 
+   // (useful for ntuples on network storage)
+   fChain->SetCacheSize(cache);
+   fChain->SetCacheLearnEntries(10);
+   for(unsigned int b = 0; b < branches.size(); b++)
+      fChain->AddBranchToCache(branches[b], true);
+   fChain->SetClusterPrefetch(true);
+}
+
 #endif // #ifdef ZTree_h
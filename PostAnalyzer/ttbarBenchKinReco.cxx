@@ -0,0 +1,500 @@
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+// This code is a benchmark and regression check of the kinematic
+// reconstruction (see kinReco.h): a frozen sample of selected events
+// (leptons, jets and MET) is replayed through KinRecoDilepton(), the
+// time per event and per pair of jets, the number of solved quartic
+// equations and of memory allocations per event are reported, and the
+// reconstructed top and antitop are compared to the reference stored
+// in the sample.
+// Run:
+//   ./ttbarBenchKinReco freeze cache/presel-*.bin
+// to produce the frozen sample (default name see below) from
+// preselected event cache files (see preselCache.h, produced by
+// ttbarMakeHist), with the reference solutions of the current code,
+// then after changes in the kinematic reconstruction:
+//   ./ttbarBenchKinReco
+// to run the benchmark and check the solutions (exit code 1 if they differ).
+//   ./ttbarBenchKinReco roots
+// checks the real roots of quartic equations (FindRealRootsQuartic(), or
+// ROOT polynomial solver if compiled with -DKINRECO_ROOT_POLYNOMIAL) for
+// polynomials with known roots, including roots which differ by up to 8 orders
+// of magnitude (exit code 1 if they are not found with the required precision).
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+//
+// additional files from this analysis (look there for description)
+#include "kinReco.h"
+#include "preselCache.h"
+#include "settings.h"
+// C++ library or ROOT header files
+#include <chrono>
+#include <cstdlib>
+#include <new>
+#include <random>
+#include <algorithm>
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+// >>>>>>>>>>>>>>>>>>>>> Allocation counter >>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+// global operator new is replaced to count memory allocations
+// (new[] calls it as well), the benchmark runs in one thread
+long long gBenchNAlloc = 0;
+void* operator new(std::size_t size)
+{
+  gBenchNAlloc++;
+  void* ptr = malloc(size ? size : 1);
+  if(!ptr)
+    throw std::bad_alloc();
+  return ptr;
+}
+void operator delete(void* ptr) noexcept
+{
+  free(ptr);
+}
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+// >>>>>>>>>>>>>>>>>>>>> Frozen sample >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+//
+// The file is flat binary (header, array of events, array of jets),
+// written and read on the same machine (as the preselected event cache).
+//
+// file header
+struct ZBenchHeader
+{
+  char Magic[8]; // "ZKRBENCH" without trailing 0 (file type)
+  int Layout[2]; // sizeof(ZBenchEvent), sizeof(ZPxPyPzE) (check of the format)
+  long long NEvents, NJets; // array sizes
+};
+// one event: input of the kinematic reconstruction and reference solution
+struct ZBenchEvent
+{
+  int Channel; // 1 ee, 2 mumu, 3 emu
+  int Solved; // reference: kinreco status
+  ZPxPyPzE LepM, LepP; // selected leptons
+  double MetPx, MetPy; // missing transverse energy
+  long long FirstJet, NJets; // selected jets (with b-tagging flags) in the jet array
+  ZPxPyPzE T, Tbar; // reference: top and antitop (if solved)
+};
+
+// frozen sample in memory
+struct ZBenchSample
+{
+  std::vector<ZBenchEvent> VecEvent;
+  std::vector<ZPxPyPzE> VecJet;
+
+  // write to file, returns true if successfull
+  bool Write(const TString& name) const
+  {
+    ZBenchHeader header;
+    memcpy(header.Magic, "ZKRBENCH", 8);
+    header.Layout[0] = sizeof(ZBenchEvent);
+    header.Layout[1] = sizeof(ZPxPyPzE);
+    header.NEvents = VecEvent.size();
+    header.NJets = VecJet.size();
+    FILE* f = fopen(name.Data(), "wb");
+    if(!f)
+      return false;
+    bool ok = (fwrite(&header, sizeof(header), 1, f) == 1);
+    ok = ok && (fwrite(VecEvent.data(), sizeof(ZBenchEvent), VecEvent.size(), f) == VecEvent.size());
+    ok = ok && (fwrite(VecJet.data(), sizeof(ZPxPyPzE), VecJet.size(), f) == VecJet.size());
+    ok = (fclose(f) == 0) && ok;
+    return ok;
+  }
+
+  // read from file, returns false if it does not exist, it is not complete or has another format
+  bool Read(const TString& name)
+  {
+    FILE* f = fopen(name.Data(), "rb");
+    if(!f)
+      return false;
+    ZBenchHeader header;
+    bool ok = (fread(&header, sizeof(header), 1, f) == 1);
+    ok = ok && !memcmp(header.Magic, "ZKRBENCH", 8) && header.Layout[0] == sizeof(ZBenchEvent) && header.Layout[1] == sizeof(ZPxPyPzE);
+    if(ok)
+    {
+      VecEvent.resize(header.NEvents);
+      VecJet.resize(header.NJets);
+      ok = (fread(VecEvent.data(), sizeof(ZBenchEvent), VecEvent.size(), f) == VecEvent.size());
+      ok = ok && (fread(VecJet.data(), sizeof(ZPxPyPzE), VecJet.size(), f) == VecJet.size());
+    }
+    fclose(f);
+    return ok;
+  }
+};
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+// >>>>>>>>>>>>>>>>>>>>> Freeze the sample >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+// Events selected in any channel (with the nominal jet selection, see
+// SelectJets() in selection.h) are taken from the preselected event cache
+// files (at most maxNEvents events in total), the reference solutions are
+// calculated with the current kinematic reconstruction.
+void FreezeSample(const std::vector<TString>& vecCacheName, const long long maxNEvents, ZBenchSample& sample)
+{
+  std::vector<ZPxPyPzE> vecJets;
+  for(int c = 0; c < vecCacheName.size(); c++)
+  {
+    ZPreselCache cache;
+    if(!cache.Read(vecCacheName[c], false))
+    {
+      printf("Error: cannot read preselection cache %s\n", vecCacheName[c].Data());
+      exit(1);
+    }
+    long long nEventsBefore = sample.VecEvent.size();
+    for(long long r = 0; r < cache.NRecords() && sample.VecEvent.size() < maxNEvents; r++)
+    {
+      ZEventPresel presel;
+      cache.Get(r, presel);
+      for(int ch = 1; ch <= 3 && sample.VecEvent.size() < maxNEvents; ch++)
+      {
+        const ZPreselEvent* ev = presel.Get(ch);
+        if(!ev || !SelectJets(*ev, gSelectionCuts.JetPtMin, gSelectionCuts.BTagDiscrMin, vecJets))
+          continue;
+        ZBenchEvent event = ZBenchEvent();
+        event.Channel = ch;
+        event.LepM = ev->LepM;
+        event.LepP = ev->LepP;
+        event.MetPx = ev->MetPx;
+        event.MetPy = ev->MetPy;
+        event.FirstJet = sample.VecJet.size();
+        event.NJets = vecJets.size();
+        event.Solved = KinRecoDilepton(event.LepM, event.LepP, vecJets, event.MetPx, event.MetPy, event.T, event.Tbar);
+        sample.VecJet.insert(sample.VecJet.end(), vecJets.begin(), vecJets.end());
+        sample.VecEvent.push_back(event);
+      }
+    }
+    printf("%s: %lld events\n", vecCacheName[c].Data(), (long long)sample.VecEvent.size() - nEventsBefore);
+  }
+}
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+// >>>>>>>>>>>>>>>>>>>>> Check the solution >>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+// returns the largest deviation of four-vector components (relative,
+// absolute for components below 1 GeV)
+double Deviation(const ZPxPyPzE& v, const ZPxPyPzE& ref)
+{
+  const double comp[4] = { v.X(), v.Y(), v.Z(), v.E() };
+  const double compRef[4] = { ref.X(), ref.Y(), ref.Z(), ref.E() };
+  double dev = 0.0;
+  for(int i = 0; i < 4; i++)
+    dev = TMath::Max(dev, TMath::Abs(comp[i] - compRef[i]) / TMath::Max(1.0, TMath::Abs(compRef[i])));
+  return dev;
+}
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+// >>>>>>>>>>>>>>>>>>>>> Benchmark >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+// Replays the sample through KinRecoDilepton() with the current settings
+// (gKinRecoOrderedSearch, gKinRecoBatch): one pass to check the solutions
+// (warm-up), then nRepeat timed passes. Prints the results, returns the number
+// of events for which the solution differs from the reference by more than tolerance.
+long long BenchSample(const ZBenchSample& sample, const int nRepeat, const double tolerance)
+{
+  const long long nEvents = sample.VecEvent.size();
+  std::vector<std::vector<ZPxPyPzE> > vecVecJets(nEvents);
+  long long nPairs = 0;
+  for(long long e = 0; e < nEvents; e++)
+  {
+    const ZBenchEvent& event = sample.VecEvent[e];
+    vecVecJets[e].assign(sample.VecJet.begin() + event.FirstJet, sample.VecJet.begin() + event.FirstJet + event.NJets);
+    nPairs += event.NJets * (event.NJets - 1);
+  }
+  // check pass
+  long long nDiff = 0;
+  long long nSolved = 0;
+  double maxDev = 0.0;
+  for(long long e = 0; e < nEvents; e++)
+  {
+    const ZBenchEvent& event = sample.VecEvent[e];
+    ZPxPyPzE t, tbar;
+    int solved = KinRecoDilepton(event.LepM, event.LepP, vecVecJets[e], event.MetPx, event.MetPy, t, tbar);
+    nSolved += solved;
+    double dev = solved ? TMath::Max(Deviation(t, event.T), Deviation(tbar, event.Tbar)) : 0.0;
+    if(solved != event.Solved || dev > tolerance)
+    {
+      if(nDiff < 10)
+        printf("  event %lld (channel %d): solved %d (reference %d), deviation %e\n", e, event.Channel, solved, event.Solved, dev);
+      nDiff++;
+    }
+    if(solved == event.Solved)
+      maxDev = TMath::Max(maxDev, dev);
+  }
+  // timed passes
+  const long long nSolvesBefore = gKinRecoNSolves;
+  const long long nAllocBefore = gBenchNAlloc;
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  for(int rep = 0; rep < nRepeat; rep++)
+  {
+    for(long long e = 0; e < nEvents; e++)
+    {
+      const ZBenchEvent& event = sample.VecEvent[e];
+      ZPxPyPzE t, tbar;
+      KinRecoDilepton(event.LepM, event.LepP, vecVecJets[e], event.MetPx, event.MetPy, t, tbar);
+    }
+  }
+  const double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+  const double nReplayed = (double)nEvents * nRepeat;
+  printf("  ns/event    : %.1f\n", ns / nReplayed);
+  printf("  ns/pair     : %.1f\n", ns / ((double)nPairs * nRepeat));
+  printf("  solves/event: %.3f\n", (gKinRecoNSolves - nSolvesBefore) / nReplayed);
+  printf("  allocs/event: %.3f\n", (gBenchNAlloc - nAllocBefore) / nReplayed);
+  printf("  solved      : %lld / %lld\n", nSolved, nEvents);
+  printf("  deviation   : %e (max, tolerance %e)\n", maxDev, tolerance);
+  printf("  differ      : %lld\n", nDiff);
+  return nDiff;
+}
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+// >>>>>>>>>>>>>>>>>>>>> Check of the quartic solver >>>>>>>>>>>>>>>>>>>>
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+// uniform random number in [0, 1) (from the 53 high bits: the sequence of 
+// std::mt19937_64 is the same everywhere, unlike std distributions)
+double BenchUniform(std::mt19937_64& gen)
+{
+  return (gen() >> 11) * (1.0 / 9007199254740992.0);
+}
+
+// real roots of polynomial pars[0] + ... + pars[4]*x^4 with the solver used in 
+// SolveCoefsKinRecoDilepton() (see kinReco.h), returns the number of roots
+int BenchFindRoots(const double* pars, double* roots)
+{
+#ifdef KINRECO_ROOT_POLYNOMIAL
+  ROOT::Math::Polynomial eq(4);
+  eq.SetParameters(pars);
+  std::vector<double> vecRoots = eq.FindRealRoots();
+  int nRoots = TMath::Min((int)vecRoots.size(), 4);
+  for(int r = 0; r < nRoots; r++)
+    roots[r] = vecRoots[r];
+  return nRoots;
+#else
+  return FindRealRootsQuartic(pars, roots);
+#endif
+}
+
+// Quartic polynomials are built from known roots: 4 real roots, 2 real roots and 
+// a complex pair, or 2 complex pairs, with magnitudes (1 ... 2) * 10^(logRatio * k / 3), 
+// k = 0 ... 3 (logRatio = 0 ... 8 in turn), random signs, and multiplied by a random factor 
+// 10^-20 ... 10^20 (the parameters of the kinreco quartic equation are of this size 
+// before scaling, see SolveCoefsKinRecoDilepton()). The polynomial is rounded to 
+// double, the reference roots are the known roots refined by Newton iterations 
+// in long double on the rounded polynomial. A polynomial fails if the number of 
+// real roots differs or a root deviates by more than tolerance (relative).
+// Prints the results per logRatio, returns the number of failed polynomials.
+long long CheckRoots(const long long nPolynomials, const double tolerance)
+{
+  const int nLogRatio = 9;
+  long long nPoly[nLogRatio] = { 0 };
+  long long nFail[nLogRatio] = { 0 };
+  double maxDev[nLogRatio] = { 0.0 };
+  std::mt19937_64 gen(20111);
+  for(long long i = 0; i < nPolynomials; i++)
+  {
+    const int logRatio = i % nLogRatio;
+    const int nReal = 4 - 2 * ((i / nLogRatio) % 3);
+    // magnitudes of the 4 roots (a pair takes two of them), in random order, 
+    // at least 1e-3 apart (relative): closer roots are badly conditioned
+    double mag[4];
+    bool separated = false;
+    while(!separated)
+    {
+      for(int r = 0; r < 4; r++)
+        mag[r] = (1.0 + BenchUniform(gen)) * TMath::Power(10.0, logRatio * r / 3.0);
+      std::shuffle(mag, mag + 4, gen);
+      separated = true;
+      for(int r1 = 0; r1 < 4; r1++)
+        for(int r2 = r1 + 1; r2 < 4; r2++)
+          if(TMath::Abs(mag[r1] - mag[r2]) < 1e-3 * TMath::Max(mag[r1], mag[r2]))
+            separated = false;
+    }
+    // polynomial coefficients c[0] + c[1]*x + ... (long double), multiplied by 
+    // factors (x - root) and (x^2 + p*x + q) for complex pairs
+    long double coef[5] = { 1.0, 0.0, 0.0, 0.0, 0.0 };
+    int order = 0;
+    double realRoots[4];
+    for(int r = 0; r < 4; r++)
+    {
+      long double factor[3];
+      int n;
+      if(r < nReal)
+      {
+        realRoots[r] = (BenchUniform(gen) < 0.5) ? -mag[r] : mag[r];
+        factor[0] = -(long double)realRoots[r];
+        factor[1] = 1.0;
+        n = 1;
+      }
+      else
+      {
+        // complex pair with modulus mag[r] (discriminant clearly negative)
+        const double cosPhi = 1.8 * BenchUniform(gen) - 0.9;
+        factor[0] = (long double)mag[r] * mag[r];
+        factor[1] = -2.0L * mag[r] * cosPhi;
+        factor[2] = 1.0;
+        n = 2;
+        r++;
+      }
+      long double prod[5] = { 0.0, 0.0, 0.0, 0.0, 0.0 };
+      for(int p = 0; p <= order; p++)
+        for(int f = 0; f <= n; f++)
+          prod[p + f] += coef[p] * factor[f];
+      order += n;
+      for(int p = 0; p <= order; p++)
+        coef[p] = prod[p];
+    }
+    const long double scale = ((BenchUniform(gen) < 0.5) ? -1.0 : 1.0) * TMath::Power(10.0, 40.0 * BenchUniform(gen) - 20.0);
+    double pars[5];
+    for(int p = 0; p < 5; p++)
+      pars[p] = (double)(coef[p] * scale);
+    // reference roots: Newton iterations in long double on the rounded polynomial
+    double refRoots[4];
+    for(int r = 0; r < nReal; r++)
+    {
+      long double x = realRoots[r];
+      for(int it = 0; it < 5; it++)
+      {
+        long double f = pars[4];
+        long double df = 0.0;
+        for(int p = 3; p >= 0; p--)
+        {
+          df = df * x + f;
+          f = f * x + pars[p];
+        }
+        if(df == 0.0)
+          break;
+        x -= f / df;
+      }
+      refRoots[r] = (double)x;
+    }
+    // roots from the solver, each reference root is compared to the closest one
+    double roots[4];
+    const int nRoots = BenchFindRoots(pars, roots);
+    double dev = 0.0;
+    for(int r = 0; r < nReal && nRoots > 0; r++)
+    {
+      double devRoot = 1e100;
+      for(int s = 0; s < nRoots; s++)
+        devRoot = TMath::Min(devRoot, TMath::Abs(roots[s] - refRoots[r]) / TMath::Abs(refRoots[r]));
+      dev = TMath::Max(dev, devRoot);
+    }
+    nPoly[logRatio]++;
+    if(nRoots != nReal || dev > tolerance)
+    {
+      if(nFail[logRatio] < 3)
+        printf("  polynomial %lld (ratio 1e%d, %d real roots): %d roots found, deviation %e\n", i, logRatio, nReal, nRoots, dev);
+      nFail[logRatio]++;
+    }
+    else
+      maxDev[logRatio] = TMath::Max(maxDev[logRatio], dev);
+  }
+  long long nFailTotal = 0;
+  printf("  ratio  polynomials  failed  deviation (max, tolerance %e)\n", tolerance);
+  for(int l = 0; l < nLogRatio; l++)
+  {
+    printf("  1e%d   %11lld  %6lld  %e\n", l, nPoly[l], nFail[l], maxDev[l]);
+    nFailTotal += nFail[l];
+  }
+  return nFailTotal;
+}
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+// >>>>>>>>>>>>>>>>>>>>> Main function >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+int main(int argc, char** argv)
+{
+  //
+  // >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+  // >>>>>>>>>>>>>>>>>>>>> Settings >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+  // >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+  //
+  // frozen sample
+  TString sampleName = gCacheDir + "/kinreco-bench.bin";
+  // maximum number of events in the frozen sample
+  long long maxNEvents = 20000;
+  // number of timed passes over the sample
+  int nRepeat = 10;
+  // allowed deviation of the solutions from the reference (see Deviation()):
+  // the results are expected to be identical on the same machine, small
+  // deviations are possible e.g. with other compiler options
+  double tolerance = 1e-6;
+  // number of polynomials and allowed deviation of their roots (relative) in the
+  // check of the quartic solver (see CheckRoots()): roots differing by orders of 
+  // magnitude are expected within a few rounding errors (~1e-15), the closest 
+  // roots (1e-3 apart) within ~1e-10 (the rounding of the polynomial parameters 
+  // is amplified by their condition number); the roots are the neutrino px in GeV, 
+  // so 1e-9 is still far below any effect on the reconstructed tops
+  long long nPolynomials = 90000;
+  double toleranceRoots = 1e-9;
+  //
+  // >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+  //
+  if(argc == 2 && TString(argv[1]) == "roots")
+  {
+#ifdef KINRECO_ROOT_POLYNOMIAL
+    printf("****** real roots of quartic equations (ROOT polynomial solver) ******\n");
+#else
+    printf("****** real roots of quartic equations (FindRealRootsQuartic) ******\n");
+#endif
+    if(CheckRoots(nPolynomials, toleranceRoots))
+    {
+      printf("Error: roots are not found with the required precision\n");
+      exit(1);
+    }
+    return 0;
+  }
+  ZBenchSample sample;
+  if(argc > 1 && TString(argv[1]) == "freeze")
+  {
+    std::vector<TString> vecCacheName;
+    for(int a = 2; a < argc; a++)
+      vecCacheName.push_back(argv[a]);
+    if(vecCacheName.empty())
+    {
+      printf("Usage: %s freeze <preselection cache files>\n", argv[0]);
+      exit(1);
+    }
+    FreezeSample(vecCacheName, maxNEvents, sample);
+    if(!sample.Write(sampleName))
+    {
+      printf("Error: cannot write %s\n", sampleName.Data());
+      exit(1);
+    }
+    printf("frozen sample written: %s (%ld events)\n", sampleName.Data(), sample.VecEvent.size());
+    return 0;
+  }
+  if(argc > 1)
+  {
+    printf("Usage: %s [freeze <preselection cache files> | roots]\n", argv[0]);
+    exit(1);
+  }
+  if(!sample.Read(sampleName) || sample.VecEvent.empty())
+  {
+    printf("Error: cannot read %s or it is empty (produce it with '%s freeze cache/presel-*.bin')\n", sampleName.Data(), argv[0]);
+    exit(1);
+  }
+  printf("frozen sample: %s (%ld events, %ld jets)\n", sampleName.Data(), sample.VecEvent.size(), sample.VecJet.size());
+
+  // all settings of the pair search in KinRecoDilepton() (they give identical results)
+  long long nDiff = 0;
+  for(int ordered = 1; ordered >= 0; ordered--)
+  {
+    for(int batch = 1; batch >= 0; batch--)
+    {
+      gKinRecoOrderedSearch = ordered;
+      gKinRecoBatch = batch;
+      printf("****** gKinRecoOrderedSearch = %d, gKinRecoBatch = %d ******\n", ordered, batch);
+      nDiff += BenchSample(sample, nRepeat, tolerance);
+    }
+  }
+  if(nDiff)
+  {
+    printf("Error: solutions differ from the reference\n");
+    exit(1);
+  }
+  return 0;
+}
@@ -114,6 +114,9 @@ int main(int argc, char** argv)
   vecMCColor.push_back(kRed);
   vecMCtitle.push_back("t#bar{t} Signal");
 
+  // input histograms: each file is read once (see ZHistoStore in plots.h)
+  ZHistoStore store;
+
   // *** make control plots ***
   // container of 2D histograms used to set the plotted range, axis etc.
   std::vector<TH2F*> cpHR;
@@ -160,6 +163,7 @@ int main(int argc, char** argv)
   for(int v = 0; v < 4; v++)
   {
     TString var = cpVar[v];
+    TString name = TString::Format("h_%s", var.Data());
     std::vector<TH1D*> hcp;
     hcp.resize(vecMCName.size() + 1);
     // create legend
@@ -176,29 +180,24 @@ int main(int argc, char** argv)
       std::vector<TH1D*> vecHMC; // vector of cumulative histograms which are actually to be drawn
       for(int s = 0; s < vecMCName.size(); s++)
       {
-        if(s > 0)
-          vecHMC.push_back(new TH1D(*vecHMC[s - 1]));
-        // open ROOT file, read needed histogram
-        TFile* f = TFile::Open(TString::Format("%s/mc%sReco-c%d.root", baseDir.Data(), vecMCName[s][0].Data(), ch));        
-        TH1D* h = (TH1D*)f->Get(TString::Format("h_%s", var.Data()));
+        // read needed histogram (copy, because it is modified)
+        TH1D* h = store.Copy(TString::Format("%s/mc%sReco-c%d.root", baseDir.Data(), vecMCName[s][0].Data(), ch), name);
         // loop over subsamples
         for(int ss = 1; ss < vecMCName[s].size(); ss++)
-        {
-          TFile* f = TFile::Open(TString::Format("%s/mc%sReco-c%d.root", baseDir.Data(), vecMCName[s][ss].Data(), ch));        
-          TH1D* hh = (TH1D*)f->Get(TString::Format("h_%s", var.Data()));
-          // plotted histograms are cumulative: each next one = previous one + current one
-          h->Add(hh);
-        }
+          h->Add(store.Get(TString::Format("%s/mc%sReco-c%d.root", baseDir.Data(), vecMCName[s][ss].Data(), ch), name));
+        // plotted histograms are cumulative: each next one = previous one + current one
         // if this is the first sample, push the current histogram
         if(s == 0)
           vecHMC.push_back(h);
-        // otherwise add to the existing histogram
+        // otherwise add to the copy of the previous histogram
         else
+        {
+          vecHMC.push_back(store.Copy(vecHMC[s - 1]));
           vecHMC[s]->Add(h);
+        }
       }
       // data
-      TFile* fData = TFile::Open(TString::Format("%s/data-c%d.root", baseDir.Data(), ch));
-      TH1D* hData = (TH1D*)fData->Get(TString::Format("h_%s", var.Data()));
+      TH1D* hData = store.Copy(TString::Format("%s/data-c%d.root", baseDir.Data(), ch), name);
       hData->SetMarkerStyle(20);
       hData->SetMarkerSize(1);
       hData->SetLineColor(1);
@@ -216,7 +215,7 @@ int main(int argc, char** argv)
         // prepare dilepton combined histograms:
         // for the first channel copy to create a new one
         if(ch == 1)
-          hcp[mc] = new TH1D(*vecHMC[mc]);
+          hcp[mc] = store.Copy(vecHMC[mc]);
         // for the rest add to the existing histogram
         else
           hcp[mc]->Add(vecHMC[mc]);
@@ -226,7 +225,7 @@ int main(int argc, char** argv)
       leg->Draw();
       cpHR[v]->Draw("axis same");
       if(ch == 1)
-        hcp[hcp.size() - 1] = new TH1D(*hData);
+        hcp[hcp.size() - 1] = store.Copy(hData);
       else
         hcp[hcp.size() - 1]->Add(hData);
     } // end of loop over channels
@@ -250,7 +249,8 @@ int main(int argc, char** argv)
   c_cp[0]->SaveAs(TString::Format("%s/cp.pdf", plotDir.Data()));
   //
   // be aware: there are certainly memory leaks (not removing 
-  // dynamically allocated objects), although it does not matter here, 
+  // dynamically allocated canvases, legends and graphs; histograms are 
+  // owned by the store), although it does not matter here, 
   // all memory is free when execution finished
   //
   
@@ -325,7 +325,7 @@ int main(int argc, char** argv)
 
   // *** TOP-11-013, Fig. 10, and the total x-section from TOP-13-004 ***
   // (see plots.h for description)
-  PlotCS(csIn);
+  PlotCS(csIn, store);
 
   return 0;
 }